@@ -1,4 +1,14 @@
 #include "ButCom.h"
+#include "ButComFec.h"
+
+#if defined(ESP_PLATFORM)
+#include <esp_system.h>
+#if __has_include(<esp_random.h>)
+#include <esp_random.h>
+#endif
+#elif defined(__AVR__) && BUTCOM_BOOT_NONCE_EEPROM >= 0
+#include <avr/eeprom.h>
+#endif
 
 /* ============================================================
    Physical Layer (ButComPhy)
@@ -9,31 +19,164 @@ ButComPhy::ButComPhy(uint8_t pin, bool useInternalPullup)
       _usePullup(useInternalPullup),
       _bitUs(500),             // default 0.5ms per bit
       _halfBitUs(250),
-      _idleMinUs(1500)         // 3 bit times
-{}
+      _idleMinUs(1500),        // 3 bit times
+      _lastTxStartUs(0),
+      _lastRxStartUs(0),
+      _driveLowUs(0),
+      _releaseUs(0),
+      _rxGlitchLeadUs(0),
+      _rxFirstLeadUs(0),
+      _slot(SLOT_NONE)
+{
+#if BUTCOM_TIMING_DIAG
+    memset(&_cal, 0, sizeof(_cal));
+    _diag        = false;
+    _diagLevel   = LOW;
+    _diagWorstUs = 0;
+    _stats.reset(_bitUs);
+#endif
+#if BUTCOM_ASYNC_RX
+    _rxHead     = 0;
+    _rxTail     = 0;
+    _rxOverruns = 0;
+    _rxActivity = 0;
+    _txActive   = false;
+    _asyncSlot  = -1;
+    _rxNotify   = nullptr;
+    _slotActivity = 0;
+    _readLeadUs      = 0;
+    _isrGlitchLeadUs = 0;
+    updateTiming();
+#endif
+}
 
 void ButComPhy::setBitTimeUs(uint16_t us) {
     // clamp values for safety
-    if (us < 300)  us = 300;
+    if (us < BUTCOM_MIN_BIT_US) us = BUTCOM_MIN_BIT_US;
     if (us > 2000) us = 2000;
 
     _bitUs     = us;
     _halfBitUs = us / 2;
     _idleMinUs = 3 * (uint32_t)us;
+#if BUTCOM_ASYNC_RX
+    updateTiming();
+#endif
+
+#if BUTCOM_TIMING_DIAG
+    _stats.reset(us);     // numbers only hold for one bit time
+#endif
 }
 
-void ButComPhy::begin() {
-    if (_usePullup)
-        pinMode(_pin, INPUT_PULLUP);
-    else
-        pinMode(_pin, INPUT);
+ButComCalibration ButComPhy::begin() {
+    releaseLine();
+    return calibrate();
+}
+
+/* ============================================================
+   Calibration
+   ------------------------------------------------------------
+   32 calls each of micros(), millis(), digitalRead() and
+   releaseLine() are timed with micros(). Where inside its run
+   time a call samples or switches the pin is not known, so
+   the middle is assumed:
+   - RX: the start-bit edge is seen half a polling pass late,
+     and the sampling loop overshoots sampleTime by about one
+     micros() call; bit 0 is scheduled that much earlier
+   - ISR: each bit costs a digitalRead() on top of its
+     delayMicroseconds(), which now makes up for it
+   - TX: releaseLine() starts early by its cost from the first
+     byte on (sendByte() keeps measuring)
+   ============================================================ */
+
+#define BUTCOM_CAL_CALLS 32
+
+// (t1 - t0) covers n calls plus one micros()
+static uint16_t callNs(uint32_t t0, uint32_t t1, uint16_t microsNs, uint8_t n) {
+    int32_t ns = (int32_t)(t1 - t0) * 1000L - microsNs;
+    return (ns > 0) ? (uint16_t)(ns / n) : 0;
+}
+
+static uint8_t nsToUs(uint32_t ns) {
+    ns = (ns + 500) / 1000;
+    return (ns > 255) ? 255 : (uint8_t)ns;
+}
+
+static uint16_t lessUs(uint32_t us, uint32_t lead) {
+    return (us > lead) ? (uint16_t)(us - lead) : 0;
+}
+
+ButComCalibration ButComPhy::calibrate() {
+    ButComCalibration cal;
+    uint8_t  i;
+    uint32_t t0 = micros();
+    for (i = 0; i < BUTCOM_CAL_CALLS; i++) (void)micros();
+    cal.microsNs = (uint16_t)((micros() - t0) * 1000UL / (BUTCOM_CAL_CALLS + 1));
+
+    t0 = micros();
+    for (i = 0; i < BUTCOM_CAL_CALLS; i++) (void)millis();
+    cal.millisNs = callNs(t0, micros(), cal.microsNs, BUTCOM_CAL_CALLS);
+
+    t0 = micros();
+    for (i = 0; i < BUTCOM_CAL_CALLS; i++) (void)digitalRead(_pin);
+    cal.digitalReadNs = callNs(t0, micros(), cal.microsNs, BUTCOM_CAL_CALLS);
+
+    t0 = micros();
+    for (i = 0; i < BUTCOM_CAL_CALLS; i++) releaseLine();
+    cal.pinModeNs = callNs(t0, micros(), cal.microsNs, BUTCOM_CAL_CALLS);
+
+    _releaseUs = nsToUs(cal.pinModeNs + cal.microsNs);
+
+    uint32_t r = cal.digitalReadNs;
+    uint32_t u = cal.microsNs;
+
+    // Polling: a pass is millis() + digitalRead(); the edge is seen half
+    // a pass plus half a read late, stamped half a micros() later
+    uint32_t edgeLagNs   = (cal.millisNs + 2 * r + u) / 2;
+    uint32_t sampleLagNs = u + r / 2;              // loop overshoot + read
+    _rxGlitchLeadUs = nsToUs(edgeLagNs + (u + r) / 2);
+    _rxFirstLeadUs  = nsToUs(edgeLagNs + sampleLagNs);
+
+#if BUTCOM_ASYNC_RX
+    // ISR: read + micros() before the glitch delay, one read per bit
+    _readLeadUs      = nsToUs(r);
+    _isrGlitchLeadUs = nsToUs(r + r / 2 + u);
+    updateTiming();
+#endif
+#if BUTCOM_TIMING_DIAG
+    _cal = cal;
+#endif
+    return cal;
+}
+
+#if BUTCOM_ASYNC_RX
+void ButComPhy::updateTiming() {
+    uint32_t q = _halfBitUs / 2;                       // glitch check
+
+    _isrGlitchUs = lessUs(q, _isrGlitchLeadUs);
+    _isrFirstUs  = lessUs((uint32_t)_bitUs + _halfBitUs - q, _readLeadUs);
+    _isrBitUs    = lessUs(_bitUs, _readLeadUs);
 }
+#endif
 
 void ButComPhy::driveLow() {
     pinMode(_pin, OUTPUT);
     digitalWrite(_pin, LOW);
 }
 
+// delayMicroseconds() for most of the wait, then micros() polling for
+// the exact edge (8 µs covers a micros() step on AVR)
+void ButComPhy::waitUntil(uint32_t us) {
+    int32_t left = (int32_t)(us - micros());
+    if (left > 16) delayMicroseconds((unsigned int)(left - 8));
+    while ((int32_t)(micros() - us) < 0) {}
+}
+
+// What a pin call took, as a lead for the next one of its kind
+static uint8_t callUs(uint32_t t0, uint32_t t1) {
+    uint32_t us = t1 - t0;
+    return (us > 255) ? 255 : (uint8_t)us;
+}
+
 void ButComPhy::releaseLine() {
     if (_usePullup)
         pinMode(_pin, INPUT_PULLUP);
@@ -41,86 +184,386 @@ void ButComPhy::releaseLine() {
         pinMode(_pin, INPUT);
 }
 
+/* ============================================================
+   Idle guard and turnaround slot
+   ------------------------------------------------------------
+   A byte normally starts after 3 idle bits. The first byte of
+   an ACK inside its slot starts one idle bit after the frame
+   it answers. While the slot of our own last frame is open we
+   wait for it to pass unused; once the peer's ACK has started
+   we wait for 5 idle bits, because the gaps between its bytes
+   (stop bit + 3 idle bits) look like 4 from here.
+   ============================================================ */
+
+void ButComPhy::reserveReplySlot() {
+    _slot = SLOT_OPEN;                     // sendByte() ended with our stop bit
+#if BUTCOM_ASYNC_RX
+    _slotActivity = _rxActivity;
+#endif
+}
+
+bool ButComPhy::replyInSlot() {
+    uint32_t frameEnd = _lastRxStartUs + 10 * (uint32_t)_bitUs;
+    int32_t  left     = (int32_t)(frameEnd + slotUs() - micros());
+
+    // The peer's frame ended ours
+    _slot = (left >= 2 * (int32_t)_bitUs) ? SLOT_REPLY : SLOT_NONE;
+    return _slot == SLOT_REPLY;
+}
+
+uint32_t ButComPhy::replyWaitUs() {
+    if (_slot == SLOT_OPEN && peerStartedInSlot()) _slot = SLOT_USED;
+
+    // Open: the ACK starts before the slot ends. Used: its next byte
+    // starts within 5 idle bits after the last one.
+    uint32_t end;
+    if      (_slot == SLOT_OPEN) end = slotStartUs() + slotUs();
+    else if (_slot == SLOT_USED) end = _lastRxStartUs + 15 * (uint32_t)_bitUs;
+    else                         return 0;
+
+    int32_t left = (int32_t)(end - micros());
+    return (left > 0) ? (uint32_t)left : 0;
+}
+
+bool ButComPhy::peerStartedInSlot() const {
+#if BUTCOM_ASYNC_RX
+    if (_rxActivity != _slotActivity) return true;
+#endif
+    return (int32_t)(_lastRxStartUs - slotStartUs()) > 0;
+}
+
 void ButComPhy::waitIdle() {
+    // The ACK starts one bit after the frame it answers
+    bool     reply   = _slot == SLOT_REPLY;
+    uint32_t replyAt = _lastRxStartUs + 11 * (uint32_t)_bitUs;
+    if (reply) _slot = SLOT_NONE;
+
+    uint32_t usedGuard = _idleMinUs + 2 * (uint32_t)_bitUs;
+    if (!reply && _slot == SLOT_OPEN && peerStartedInSlot()) _slot = SLOT_USED;
+
+    uint32_t guard = reply              ? _bitUs :
+                     _slot == SLOT_USED ? usedGuard :
+                                          _idleMinUs;
+
     uint32_t highStart = micros();
+#if BUTCOM_ASYNC_RX
+    uint8_t seen = _rxActivity;
+#endif
 
     while (true) {
-        if (digitalRead(_pin) == HIGH) {
-            if ((uint32_t)(micros() - highStart) >= _idleMinUs)
-                return;
-        } else {
-            highStart = micros(); // reset timer
+        bool busy = digitalRead(_pin) == LOW;
+#if BUTCOM_ASYNC_RX
+        // The edge ISR hides a whole byte from this loop
+        if (seen != _rxActivity) {
+            seen = _rxActivity;
+            busy = true;
+        }
+#endif
+        uint32_t now = micros();
+        if (busy) {
+            highStart = now;                // reset timer
+            if (!reply && _slot == SLOT_OPEN) {
+                _slot = SLOT_USED;          // the peer's ACK started
+                guard = usedGuard;
+            }
+            continue;
         }
+
+        if ((uint32_t)(now - highStart) < guard) continue;
+        if (reply) {
+            if ((int32_t)(now - replyAt) < 0) continue;
+        } else if (_slot == SLOT_OPEN) {
+            if ((uint32_t)(now - slotStartUs()) < slotUs()) continue;
+        }
+
+        _slot = SLOT_NONE;
+        return;
     }
 }
 
 void ButComPhy::sendByte(uint8_t value) {
     waitIdle();
+#if BUTCOM_ASYNC_RX
+    _txActive = true;
+#endif
 
-    // Start bit
+    // Start bit: every later edge is due a whole number of bit times
+    // after it, so pin I/O time cannot add up over the byte
+    uint32_t t = micros();
     driveLow();
-    delayMicroseconds(_bitUs);
-
-    // 8 data bits (LSB first)
-    for (uint8_t i = 0; i < 8; i++) {
-        bool bit = (value >> i) & 1;
-        if (bit) releaseLine();
-        else     driveLow();
-        delayMicroseconds(_bitUs);
+    _lastTxStartUs = micros();
+    _driveLowUs    = callUs(t, _lastTxStartUs);
+
+    // 8 data bits (LSB first), then the stop bit. Only level changes
+    // touch the pin, each started early by what the last call of its
+    // kind took to switch the line.
+    bool high = false;
+    for (uint8_t i = 1; i <= 9; i++) {
+        bool bit = (i == 9) || ((value >> (i - 1)) & 1);
+        if (bit == high) continue;
+
+        uint32_t due = _lastTxStartUs + i * (uint32_t)_bitUs;
+        if (bit) {
+            waitUntil(due - _releaseUs);
+            t = micros();
+            releaseLine();
+            _releaseUs = callUs(t, micros());
+        } else {
+            waitUntil(due - _driveLowUs);
+            t = micros();
+            driveLow();
+            _driveLowUs = callUs(t, micros());
+        }
+        high = bit;
     }
 
-    // Stop bit
-    releaseLine();
-    delayMicroseconds(_bitUs);
+    // End of the stop bit
+    waitUntil(_lastTxStartUs + 10 * (uint32_t)_bitUs);
+#if BUTCOM_ASYNC_RX
+    _txActive = false;
+#endif
 }
 
-bool ButComPhy::receiveByte(uint8_t& out, uint32_t timeoutMs) {
-    uint32_t startMs = millis();
+bool ButComPhy::receiveByte(uint8_t& out, uint32_t timeoutUs) {
+    uint32_t startUs  = micros();
+    uint16_t glitchUs = lessUs(_halfBitUs / 2, _rxGlitchLeadUs);
+    uint16_t firstUs  = lessUs((uint32_t)_bitUs + _halfBitUs, _rxFirstLeadUs);
 
     // Wait until line is HIGH
     while (digitalRead(_pin) == LOW) {
-        if (millis() - startMs > timeoutMs) return false;
+        if (micros() - startUs > timeoutUs) return false;
     }
 
     // Wait for falling edge (start bit)
     while (true) {
-        if (millis() - startMs > timeoutMs) return false;
+        if (micros() - startUs > timeoutUs) return false;
 
         if (digitalRead(_pin) == LOW) {
             uint32_t edgeTime = micros();
 
-            // Glitch filter
-            delayMicroseconds(_halfBitUs / 2);
+            // Glitch filter, a quarter bit after the edge
+            delayMicroseconds(glitchUs);
             if (digitalRead(_pin) == LOW) {
-                // Real start bit detected
-                uint32_t sampleTime = edgeTime + _bitUs + _halfBitUs;
+                // Real start bit detected. Middle of bit 0, less the
+                // call latencies measured by calibrate()
+                _lastRxStartUs = edgeTime;
+                uint32_t sampleTime = edgeTime + firstUs;
                 uint8_t value = 0;
 
+                // timeoutUs only bounds the wait for a start bit; a byte
+                // that has started is always sampled to the end (at 800 µs
+                // and more per bit, 8 samples do not fit the 10 ms loop() window)
+#if BUTCOM_TIMING_DIAG
+                _diagLevel   = LOW;
+                _diagWorstUs = 0;
+#endif
                 for (uint8_t i = 0; i < 8; i++) {
                     while ((int32_t)(micros() - sampleTime) < 0) {
-                        if (millis() - startMs > timeoutMs) return false;
+#if BUTCOM_TIMING_DIAG
+                        if (_diag) diagPoll(edgeTime);
+#endif
                     }
                     if (digitalRead(_pin) == HIGH)
                         value |= (1 << i);
                     sampleTime += _bitUs;
                 }
 
+#if BUTCOM_TIMING_DIAG
+                if (_diag) diagByteDone(edgeTime);
+#endif
                 out = value;
                 return true;
             } else {
                 // False start bit – wait until HIGH again
                 while (digitalRead(_pin) == LOW) {
-                    if (millis() - startMs > timeoutMs) return false;
+                    if (micros() - startUs > timeoutUs) return false;
                 }
             }
         }
     }
 }
 
+#if BUTCOM_ASYNC_RX
+/* ============================================================
+   Interrupt RX
+   ------------------------------------------------------------
+   attachInterrupt() takes a plain function, so each instance
+   gets one of BUTCOM_ASYNC_SLOTS trampolines. The ISR samples
+   the whole byte with the receiveByte() rules and returns in
+   the middle of the stop bit: edges latched meanwhile (the
+   data bits) then find the line HIGH and are ignored.
+   ============================================================ */
+
+ButComPhy* ButComPhy::_asyncOwner[BUTCOM_ASYNC_SLOTS];
+
+template <uint8_t Slot>
+void BUTCOM_ISR_ATTR ButComPhy::edgeIsr() {
+    _asyncOwner[Slot]->onEdge();
+}
+
+bool ButComPhy::beginAsync(void (*notify)()) {
+    static void (* const isr[BUTCOM_ASYNC_SLOTS])() = {
+        edgeIsr<0>, edgeIsr<1>, edgeIsr<2>, edgeIsr<3>
+    };
+
+#ifdef NOT_AN_INTERRUPT
+    if (digitalPinToInterrupt(_pin) == NOT_AN_INTERRUPT) return false;
+#endif
+    _rxNotify = notify;
+    if (_asyncSlot >= 0) return true;
+
+    for (uint8_t i = 0; i < BUTCOM_ASYNC_SLOTS; i++) {
+        if (_asyncOwner[i]) continue;
+        _asyncOwner[i] = this;
+        _asyncSlot     = (int8_t)i;
+        _rxHead = 0;
+        _rxTail = 0;
+        attachInterrupt(digitalPinToInterrupt(_pin), isr[i], FALLING);
+        return true;
+    }
+    return false;
+}
+
+void ButComPhy::endAsync() {
+    if (_asyncSlot < 0) return;
+
+    detachInterrupt(digitalPinToInterrupt(_pin));
+    _asyncOwner[_asyncSlot] = nullptr;
+    _asyncSlot = -1;
+}
+
+void BUTCOM_ISR_ATTR ButComPhy::onEdge() {
+    // Our own start bit, or an edge latched while the last byte was sampled
+    if (_txActive || digitalRead(_pin) != LOW) return;
+    uint32_t edgeTime = micros();
+    _rxActivity = (uint8_t)(_rxActivity + 1);           // restarts waitIdle()
+
+    // Timed with delayMicroseconds(): micros() stops advancing inside a
+    // long ISR on AVR. The delays leave out the digitalRead() time
+    // measured by calibrate(), so it does not add up over the byte.
+    delayMicroseconds(_isrGlitchUs);
+    if (digitalRead(_pin) != LOW) return;                 // glitch
+
+    delayMicroseconds(_isrFirstUs);
+    uint8_t value = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+        if (digitalRead(_pin) == HIGH)
+            value |= (1 << i);
+        delayMicroseconds(_isrBitUs);                     // ends in the stop bit
+    }
+
+    uint8_t next = (uint8_t)((_rxHead + 1) & (BUTCOM_RX_QUEUE - 1));
+    if (next == _rxTail) {
+        if (_rxOverruns != 0xFFFF) _rxOverruns = (uint16_t)(_rxOverruns + 1);
+        return;
+    }
+    _rxQueue[_rxHead]   = value;
+    _rxQueueUs[_rxHead] = edgeTime;
+    _rxHead = next;
+
+    if (_rxNotify) _rxNotify();
+}
+
+bool ButComPhy::readQueued(uint8_t& out) {
+    uint8_t tail = _rxTail;
+    if (tail == _rxHead) return false;
+
+    out            = _rxQueue[tail];
+    _lastRxStartUs = _rxQueueUs[tail];
+    _rxTail = (uint8_t)((tail + 1) & (BUTCOM_RX_QUEUE - 1));
+    return true;
+}
+#endif
+
+#if BUTCOM_TIMING_DIAG
+/* ============================================================
+   Timing diagnostics
+   ------------------------------------------------------------
+   Boundary k (1..9) lies k bit times after the start-bit edge:
+   start→b0 ... b6→b7, b7→stop. An edge's deviation is its
+   distance to the nearest boundary; the sample points sit half a
+   bit away from both neighbours, so a byte's margin is
+   halfBit - its largest |deviation|.
+   ============================================================ */
+
+void ButComTimingStats::reset(uint16_t us) {
+    memset(this, 0, sizeof(*this));
+    bitUs       = us;
+    marginMinUs = (int16_t)(us / 2);
+}
+
+int16_t ButComTimingStats::driftUs() const {
+    if (!countEarly || !countLate) return 0;
+
+    // Mean of k=1..3 sits at k=2, mean of k=7..9 at k=8 → scale 6 → 9 bits
+    int32_t early = devSumEarly / (int32_t)countEarly;
+    int32_t late  = devSumLate  / (int32_t)countLate;
+    return (int16_t)((late - early) * 9 / 6);
+}
+
+uint16_t ButComTimingStats::safeBitUs() const {
+    if (bytes < 64) return 0;
+
+    // The worst deviation is treated as fixed: polling latency and the
+    // sender's per-bit call overhead do not shrink with the bit time.
+    // The clock-mismatch part does, so a value measured on a slow link
+    // is conservative; measure again at the recommended speed.
+    int32_t peak = (-devMinUs > devMaxUs) ? -devMinUs : devMaxUs;
+
+    // Keep half of the half-bit margin as headroom for the tails a
+    // short measurement does not see: peak <= bit / 4
+    uint32_t b = 4UL * (uint32_t)peak;
+    b = (b + 9) / 10 * 10;
+    if (b < 10) b = 10;
+    return (b > 0xFFFF) ? 0xFFFF : (uint16_t)b;
+}
+
+void ButComPhy::diagPoll(uint32_t edgeTime) {
+    uint8_t level = digitalRead(_pin);
+    if (level == _diagLevel) return;
+    _diagLevel = level;
+
+    int32_t pos = (int32_t)(micros() - edgeTime);
+    int32_t k   = (pos + _halfBitUs) / (int32_t)_bitUs;
+    if (k < 1 || k > 9) return;
+
+    int32_t dev = pos - k * (int32_t)_bitUs;
+    if (dev < _stats.devMinUs) _stats.devMinUs = (int16_t)dev;
+    if (dev > _stats.devMaxUs) _stats.devMaxUs = (int16_t)dev;
+    if (k <= 3) { _stats.devSumEarly += dev; _stats.countEarly++; }
+    if (k >= 7) { _stats.devSumLate  += dev; _stats.countLate++;  }
+
+    uint16_t absDev = (uint16_t)(dev < 0 ? -dev : dev);
+    if (absDev > _diagWorstUs) _diagWorstUs = absDev;
+
+    int32_t bin = (dev + _halfBitUs) * BUTCOM_DIAG_BINS / (int32_t)_bitUs;
+    if (bin < 0) bin = 0;
+    if (bin >= BUTCOM_DIAG_BINS) bin = BUTCOM_DIAG_BINS - 1;
+    if (_stats.jitter[bin] != 0xFFFF) _stats.jitter[bin]++;
+    _stats.edges++;
+}
+
+void ButComPhy::diagByteDone(uint32_t edgeTime) {
+    // Keep watching until the middle of the stop bit for the b7→stop
+    // edge (the sender idles at least 3 bits after it anyway)
+    uint32_t stopSample = edgeTime + 9 * (uint32_t)_bitUs + _halfBitUs;
+    while ((int32_t)(micros() - stopSample) < 0) diagPoll(edgeTime);
+    if (digitalRead(_pin) == LOW) _stats.framingErrors++;
+
+    int16_t m = (int16_t)_halfBitUs - (int16_t)_diagWorstUs;
+    if (m < _stats.marginMinUs) _stats.marginMinUs = m;
+
+    int32_t bin = (m <= 0) ? 0 : (int32_t)m * 2 * BUTCOM_DIAG_BINS / (int32_t)_bitUs;
+    if (bin >= BUTCOM_DIAG_BINS) bin = BUTCOM_DIAG_BINS - 1;
+    if (_stats.margin[bin] != 0xFFFF) _stats.margin[bin]++;
+    _stats.bytes++;
+}
+#endif
+
 /* ============================================================
    CRC-8 (ATM polynomial 0x07)
    ============================================================ */
-uint8_t ButCom::crc8_update(uint8_t crc, uint8_t data) {
+uint8_t ButComCore::crc8_update(uint8_t crc, uint8_t data) {
     crc ^= data;
     for (uint8_t i = 0; i < 8; i++) {
         crc = (crc & 0x80)
@@ -134,185 +577,767 @@ uint8_t ButCom::crc8_update(uint8_t crc, uint8_t data) {
    Logical Layer (ButCom)
    ============================================================ */
 
-ButCom::ButCom(uint8_t pin, bool internalPullup, uint8_t deviceId)
+ButComCore::ButComCore(uint8_t pin, bool internalPullup, uint8_t deviceId,
+                       ButComFramePool& pool)
     : _phy(pin, internalPullup),
       _id(deviceId),
       _remoteId(0),
       _hasRemoteId(false),
+      _remoteMaxPayload(0),
+#if BUTCOM_PEER_REBOOT
+      _bootNonce(0),
+      _remoteBootNonce(0),
+      _onPeerReboot(nullptr),
+      _rebootPolicy(BUTCOM_REBOOT_RESEND),
+#endif
       _callback(nullptr),
+      _pool(pool),
+      _maxPayload((uint8_t)(pool.slotSize() - 3)),
       _rxState(RX_WAIT_START),
       _rxExpectedLength(0),
+      _rxBuffer(nullptr),
+      _inCallback(false),
+      _rxKept(false),
       _rxIndex(0),
-      _lastDataMsgId(0xFF),
+      _rxLastByteMs(0),
+      _rxByteTimeoutMs(20),      // ~3 byte times at 500 µs
+      _rxFrameStartUs(0),
+      _txFrameStartUs(0),
+      _deferredLength(0),
+      _lastDataMsgId(0),
+      _lastDataValid(false),
+      _fec(false),
+      _fecHaveLow(false),
+      _fecLow(0),
+      _fecCorrections(0),
+      _reserved(nullptr),
+      _linkDown(false),
       _ackTimeoutMs(40),
       _maxRetries(2),
       _lastHelloMs(0),
       _helloIntervalMs(5000),    // send HELLO every 5s
+      _discoverTries(0),
+      _helloReplyDue(false),
       _nextMsgId(1)
 {
     _pending.active      = false;
     _pending.requiresAck = false;
     _pending.retries     = 0;
-    _pending.length      = 0;
+    _pending.frame       = nullptr;
+    _pending.bodyLength  = 0;
+
+#if BUTCOM_ISR_TX_QUEUE
+    _isrTxHead    = 0;
+    _isrTxTail    = 0;
+    _isrTxDropped = 0;
+#endif
 }
 
-void ButCom::setSpeedQuality(uint8_t level) {
+static uint16_t qualityBitUs(uint8_t level) {
+    return (level == 1) ? 300 :
+           (level == 2) ? 500 :
+           (level == 3) ? 800 :
+                          1200;
+}
+
+void ButComCore::setSpeedQuality(uint8_t level) {
     if (level < 1) level = 1;
     if (level > 4) level = 4;
 
-    uint16_t us =
-        (level == 1) ? 300 :
-        (level == 2) ? 500 :
-        (level == 3) ? 800 :
-                       1200;
+    setBitTimeUs(qualityBitUs(level));
+}
 
+void ButComCore::setBitTimeUs(uint16_t us) {
     _phy.setBitTimeUs(us);
+    us = _phy.bitTimeUs();                // clamped
 
     // Adjust ack timeout proportionally
     _ackTimeoutMs =
         (us <= 500) ? 40 :
         (us <= 800) ? 60 :
                       80;
+
+    // A byte incl. the idle gap takes ~13 bit times; allow 3 of them
+    _rxByteTimeoutMs = (uint16_t)((39UL * us) / 1000 + 1);
 }
 
-void ButCom::begin(bool sendHelloOnStart) {
-    _phy.begin();
+#if BUTCOM_TIMING_DIAG
+uint8_t ButComCore::recommendedQuality() const {
+    uint16_t safe = _phy.timingStats().safeBitUs();
+    if (safe == 0) return 0;
+
+    for (uint8_t level = 1; level <= 4; level++)
+        if (qualityBitUs(level) >= safe) return level;
+    return 0;
+}
+#endif
+
+#if BUTCOM_PEER_REBOOT
+#if !defined(ESP_PLATFORM)
+// Not cleared by the C runtime on AVR: keeps counting over warm resets
+// (watchdog, reset pin) and starts from the SRAM's power-up content
+#if defined(__AVR__)
+static uint16_t bootCount __attribute__((section(".noinit")));
+#else
+static uint16_t bootCount;
+#endif
+#endif
+
+// Default boot nonce. Without an RNG a counter moves by 1..256 per boot
+// (the boot time in µs and the measured call timings pick the step), so
+// two boots in a row never share a nonce.
+static uint16_t defaultBootNonce(const ButComCalibration& cal) {
+#if defined(ESP_PLATFORM)
+    (void)cal;
+    return (uint16_t)esp_random();
+#else
+    uint32_t t    = micros();
+    uint8_t  step = ButComCore::crc8_update(ButComCore::crc8_update((uint8_t)t, (uint8_t)(t >> 8)),
+                                            (uint8_t)(cal.digitalReadNs ^ cal.pinModeNs));
+#if defined(__AVR__) && BUTCOM_BOOT_NONCE_EEPROM >= 0
+    uint16_t* addr = (uint16_t*)BUTCOM_BOOT_NONCE_EEPROM;
+    bootCount = eeprom_read_word(addr);
+#endif
+    bootCount = (uint16_t)(bootCount + 1 + step);
+    if (!bootCount) bootCount = 1;
+#if defined(__AVR__) && BUTCOM_BOOT_NONCE_EEPROM >= 0
+    eeprom_update_word(addr, bootCount);
+#endif
+    return bootCount;
+#endif
+}
+#endif
+
+void ButComCore::begin(bool sendHelloOnStart) {
+    ButComCalibration cal = _phy.begin();
     _lastHelloMs = millis();
-    if (sendHelloOnStart) sendHello();
+
+#if BUTCOM_PEER_REBOOT
+    if (!_bootNonce) _bootNonce = defaultBootNonce(cal);
+    if (!_bootNonce) _bootNonce = 1;
+#else
+    (void)cal;
+#endif
+    if (sendHelloOnStart) discover();
+}
+
+void ButComCore::discover() {
+    _discoverTries = BUTCOM_DISCOVER_TRIES - 1;
+    sendHello(BUTCOM_HELLO_REQUEST);
 }
 
-void ButCom::sendHello() {
-    uint8_t payload[1] = { _id };
+void ButComCore::sendHello(uint8_t flags) {
+    receiveReply();
+
+    uint16_t nonce = bootNonce();
+    uint8_t payload[BUTCOM_HELLO_LENGTH] = { _id, flags, _maxPayload,
+                                             (uint8_t)nonce, (uint8_t)(nonce >> 8) };
     uint8_t msgId = _nextMsgId++;
-    sendRawFrame(BUTCOM_MSG_HELLO, msgId, payload, 1);
+    sendRawFrame(BUTCOM_MSG_HELLO, msgId, payload, BUTCOM_HELLO_LENGTH);
     _lastHelloMs = millis();
 }
 
-void ButCom::loop() {
+// The peer's msgIds start over after a reboot: forget the last one,
+// or its first frames may be dropped as duplicates. Our frame in the
+// retry slot may have been lost in the reboot. The first nonce seen
+// is no reboot (we may be the one that just booted).
+bool ButComCore::peerRebooted(const uint8_t* hello, uint8_t length) {
+#if BUTCOM_PEER_REBOOT
+    if (length < 5) return false;
+
+    uint16_t nonce = (uint16_t)hello[3] | ((uint16_t)hello[4] << 8);
+    bool changed = _remoteBootNonce && nonce != _remoteBootNonce;
+    _remoteBootNonce = nonce;
+    if (!changed) return false;
+
+    _lastDataValid = false;
+    if (_pending.active && _pending.requiresAck)
+        _pending.retries = 0;
+    return true;
+#else
+    (void)hello;
+    (void)length;
+    return false;
+#endif
+}
 
-    // ---- Receive one byte per iteration ----
-    uint8_t b;
-    if (_phy.receiveByte(b, 10)) {
+// Request, its ACK and the peer's HELLO; both nodes may ask at once
+// after a common power-up, the id spreads their retries apart
+uint32_t ButComCore::discoverRetryMs() const {
+    uint32_t ms = 4UL * _ackTimeoutMs;
+    if (_fec) ms *= 2;
+    return ms + (_id & 7) * 3;
+}
+
+// Time left of a loop(budgetUs) call that started at startUs; no limit
+// for budget 0 (loop() without budget, send())
+static uint32_t budgetLeftUs(uint32_t startUs, uint32_t budgetUs) {
+    if (!budgetUs) return 0xFFFFFFFFUL;
+    uint32_t used = micros() - startUs;
+    return (used < budgetUs) ? budgetUs - used : 0;
+}
+
+// Polling receiver: the ACK of our last frame may be on its way in the
+// turnaround slot. Take it in before the next frame instead of waiting
+// it out in sendByte(), which would lose it and cause a retry. loop()
+// may already have read its first bytes. Not from the callback: the
+// frame being handled still owns the RX buffer.
+void ButComCore::receiveReply(uint32_t startUs, uint32_t budgetUs) {
+#if BUTCOM_ASYNC_RX
+    if (_phy.asyncRx()) return;             // the ISR receives it
+#endif
+    if (_inCallback) return;
+
+    // One wait per byte: polling in short steps would miss start bits.
+    // 1 ms over the window, for a peer whose clock runs slow
+    uint8_t  b;
+    uint32_t waitUs;
+    while ((waitUs = _phy.replyWaitUs()) != 0) {
+        waitUs += 1000;
+        uint32_t left = budgetLeftUs(startUs, budgetUs);
+        if (!left) break;
+        if (!_phy.receiveByte(b, waitUs < left ? waitUs : left)) break;
         handleReceivedByte(b);
+        _rxLastByteMs = millis();
+    }
+}
+
+#if BUTCOM_ASYNC_RX
+bool ButComCore::setAsyncRx(bool enabled, void (*notify)()) {
+    if (!enabled) {
+        _phy.endAsync();
+        return true;
+    }
+    return _phy.beginAsync(notify);
+}
+#endif
+
+uint32_t ButComCore::msUntil(uint32_t since, uint32_t period, uint32_t now) {
+    uint32_t elapsed = now - since;
+    return (elapsed > period) ? 0 : period + 1 - elapsed;
+}
+
+uint32_t ButComCore::nextDeadlineMs() const {
+#if BUTCOM_ASYNC_RX
+    if (!_phy.asyncRx() || _phy.rxQueued()) return 0;
+#else
+    return 0;
+#endif
+#if BUTCOM_ISR_TX_QUEUE
+    if (isrTxReady()) return 0;
+#endif
+
+    uint32_t now  = millis();
+    uint32_t next = BUTCOM_NO_DEADLINE;
+    uint32_t t;
+
+    if (_rxState != RX_WAIT_START) {
+        t = msUntil(_rxLastByteMs, _fec ? 2 * _rxByteTimeoutMs : _rxByteTimeoutMs, now);
+        if (t < next) next = t;
+    }
+    if (_pending.active && _pending.requiresAck) {
+        t = msUntil(_pending.lastSendMs, _fec ? 2 * _ackTimeoutMs : _ackTimeoutMs, now);
+        if (t < next) next = t;
+    }
+    if (_helloReplyDue) return 0;
+    if (_discoverTries) {
+        t = msUntil(_lastHelloMs, discoverRetryMs(), now);
+        if (t < next) next = t;
+    }
+    if (_helloIntervalMs) {
+        t = msUntil(_lastHelloMs, _helloIntervalMs, now);
+        if (t < next) next = t;
+    }
+    return next;
+}
+
+/* ============================================================
+   Time budget of loop(budgetUs)
+   ============================================================ */
+
+uint32_t ButComCore::frameUs(uint8_t payloadLength) const {
+    uint32_t bytes = 1UL + 3 + payloadLength;       // LEN + TYPE, MSGID, payload, CRC
+    if (_fec) bytes *= 2;
+    return (bytes + 1) * _phy.byteUs();             // + START; byteUs() has the idle gap
+}
+
+// A TX frame started by loop() must end inside the budget. The ACK of
+// the frame before it is taken in first, within the budget as well, so
+// the send itself finds the turnaround slot closed and does not wait.
+bool ButComCore::fitsBudget(uint8_t payloadLength, uint32_t startUs, uint32_t budgetUs) {
+    if (!budgetUs) return true;
+
+    receiveReply(startUs, budgetUs);
+    if (frameUs(payloadLength) <= budgetLeftUs(startUs, budgetUs)) return true;
+    if (payloadLength + 1U > _deferredLength) _deferredLength = payloadLength + 1U;
+    return false;
+}
+
+uint32_t ButComCore::loop(uint32_t budgetUs) {
+    uint32_t startUs = micros();
+    _deferredLength  = 0;
+
+    uint8_t b;
+#if BUTCOM_ASYNC_RX
+    // ---- Interrupt RX: handle what the ISR queued (and the budget allows) ----
+    if (_phy.asyncRx()) {
+        while (budgetLeftUs(startUs, budgetUs) && _phy.readQueued(b)) {
+            handleReceivedByte(b);
+            _rxLastByteMs = millis();
+        }
+    } else
+#endif
+    if (!budgetUs) {
+        // ---- Receive one byte per iteration ----
+        if (_phy.receiveByte(b, 10000)) {
+            handleReceivedByte(b);
+            _rxLastByteMs = millis();
+        }
+    } else {
+        // ---- Bytes as long as the budget lasts ----
+        uint32_t left;
+        while ((left = budgetLeftUs(startUs, budgetUs)) != 0 && _phy.receiveByte(b, left)) {
+            handleReceivedByte(b);
+            _rxLastByteMs = millis();
+        }
     }
 
     uint32_t now = millis();
 
+    // ---- Drop a frame whose bytes stopped coming (noise START, lost bytes) ----
+    // Otherwise a garbage LEN swallows the START of the next real frame.
+    if (_rxState != RX_WAIT_START &&
+        (now - _rxLastByteMs) > (_fec ? 2 * _rxByteTimeoutMs : _rxByteTimeoutMs))
+    {
+        rxReset();
+    }
+
+    // ---- ACK of our last frame still arriving (polling receiver) ----
+    receiveReply(startUs, budgetUs);
+
     // ---- Automatic retry if waiting for ACK ----
     if (_pending.active && _pending.requiresAck) {
-        if ((now - _pending.lastSendMs) > _ackTimeoutMs) {
+        // FEC frames are twice as long → twice the ACK wait
+        uint16_t ackTimeout = _fec ? 2 * _ackTimeoutMs : _ackTimeoutMs;
+
+        if ((now - _pending.lastSendMs) > ackTimeout) {
 
             if (_pending.retries < _maxRetries) {
-                _pending.retries++;
-                _pending.lastSendMs = now;
+                if (fitsBudget(_pending.bodyLength - 3, startUs, budgetUs)) {
+                    _pending.retries++;
+                    _pending.lastSendMs = now;
 
-                sendRawFrame(_pending.type,
-                             _pending.msgId,
-                             _pending.payload,
-                             _pending.length);
+                    sendBody(_pending.frame, _pending.bodyLength);
+                }
             } else {
                 // Give up after max retries
                 _pending.active = false;
+                _pool.release(_pending.frame);
+                _pending.frame  = nullptr;
+                _linkDown       = true;
             }
         }
     }
 
-    // ---- Periodic HELLO for resync ----
-    if (_helloIntervalMs &&
-        (now - _lastHelloMs) > _helloIntervalMs) {
-        sendHello();
+#if BUTCOM_ISR_TX_QUEUE
+    // ---- One frame queued by an interrupt handler ----
+    if (isrTxReady() && fitsBudget(_isrTxLength[_isrTxTail] & 0x7F, startUs, budgetUs)) sendIsrQueued();
+#endif
+
+    // ---- HELLO the peer asked for, our request again, or the ----
+    // ---- periodic one for resync (one per call: `now` is stale). ----
+    // ---- Not inside a frame: its ACK would be late             ----
+    bool request  = _discoverTries && (now - _lastHelloMs) > discoverRetryMs();
+    bool periodic = _helloIntervalMs && (now - _lastHelloMs) > _helloIntervalMs;
+    if ((_helloReplyDue || request || periodic) && _rxState == RX_WAIT_START &&
+        fitsBudget(BUTCOM_HELLO_LENGTH, startUs, budgetUs)) {
+        if (_helloReplyDue) {
+            _helloReplyDue = false;
+            sendHello(0);
+        } else if (request) {
+            _discoverTries--;
+            sendHello(BUTCOM_HELLO_REQUEST);
+        } else {
+            sendHello(0);
+        }
     }
+
+    return _deferredLength ? 0 : nextDeadlineMs();
 }
 
-uint8_t ButCom::send(const uint8_t* payload,
-                     uint8_t length,
-                     bool requestAck)
+uint8_t ButComCore::send(const uint8_t* payload,
+                         uint8_t length,
+                         bool requestAck)
 {
-    if (length > BUTCOM_MAX_PAYLOAD)
-        length = BUTCOM_MAX_PAYLOAD;
+    return sendMessage(BUTCOM_MSG_DATA, payload, length, requestAck);
+}
 
-    uint8_t msgId = _nextMsgId++;
+uint8_t ButComCore::sendMessage(uint8_t type,
+                                const uint8_t* payload,
+                                uint8_t length,
+                                bool requestAck)
+{
+    if (length > _maxPayload)
+        length = _maxPayload;
+    if (type & BUTCOM_TYPE_NO_ACK)
+        requestAck = false;                 // nothing will answer it
+
+    // Before the ID and the retry slot are taken: the callback of that
+    // ACK may send itself
+    receiveReply();
+
+    // Start pending retry if no other TX is pending: the frame is built
+    // once in a pool slot (CRC included) and resent from there
+    uint8_t* slot = (requestAck && !_pending.active && !_reserved) ? _pool.acquire() : nullptr;
+
+    if (!slot) {
+        // No retry (one already pending, or the pool is exhausted)
+        uint8_t msgId = _nextMsgId++;
+        sendRawFrame(type, msgId, payload, length);
+        return msgId;
+    }
 
-    sendRawFrame(BUTCOM_MSG_DATA, msgId, payload, length);
+    for (uint8_t i = 0; i < length; i++)
+        slot[2 + i] = payload ? payload[i] : 0;
+    return sendPending(slot, type, length);
+}
+
+// Slot with the payload at [2]: header and CRC around it, sent and
+// kept for the retries
+uint8_t ButComCore::sendPending(uint8_t* slot, uint8_t type, uint8_t length) {
+    uint8_t msgId   = _nextMsgId++;
+    uint8_t bodyLen = 2 + length + 1;
+    uint8_t crc = crc8_update(0, bodyLen);
+    slot[0] = type;
+    slot[1] = msgId;
+    for (uint8_t i = 0; i < bodyLen - 1; i++)
+        crc = crc8_update(crc, slot[i]);
+    slot[bodyLen - 1] = crc;
+
+    sendBody(slot, bodyLen);
+
+    _pending.active      = true;
+    _pending.requiresAck = true;
+    _pending.frame       = slot;
+    _pending.bodyLength  = bodyLen;
+    _pending.retries     = 0;
+    _pending.lastSendMs  = millis();
+
+    return msgId;
+}
+
+/* ============================================================
+   Checked send
+   ------------------------------------------------------------
+   Same frames as sendMessage(), but a send that would be
+   truncated or lose its retry is refused instead, so producers
+   can hold back or merge data while the link is busy.
+   ============================================================ */
+
+ButComSendStatus ButComCore::sendCheck(uint8_t type, uint8_t length, bool requestAck) const {
+    // HELLO and ACK are the core's own; a NO_ACK frame never waits
+    uint8_t base = type & ~BUTCOM_TYPE_NO_ACK;
+    if (base == BUTCOM_MSG_HELLO || base == BUTCOM_MSG_ACK) return BUTCOM_SEND_BAD_TYPE;
+    if (type & BUTCOM_TYPE_NO_ACK) requestAck = false;
+
+    if (length > _maxPayload) return BUTCOM_SEND_TOO_LONG;
+    if (_linkDown)            return BUTCOM_SEND_LINK_DOWN;
+    if (requestAck && (_pending.active || _reserved || _pool.inUse() >= _pool.slots()))
+        return BUTCOM_SEND_FULL;
+    return BUTCOM_SEND_QUEUED;
+}
+
+ButComSendStatus ButComCore::trySend(const uint8_t* payload, uint8_t length,
+                                     bool requestAck, uint8_t* msgId)
+{
+    return trySendMessage(BUTCOM_MSG_DATA, payload, length, requestAck, msgId);
+}
+
+ButComSendStatus ButComCore::trySendMessage(uint8_t type, const uint8_t* payload,
+                                            uint8_t length, bool requestAck,
+                                            uint8_t* msgId)
+{
+    // An ACK on its way in may free the retry slot
+    receiveReply();
 
-    // Start pending retry if no other TX is pending
-    if (requestAck && !_pending.active) {
-        _pending.active      = true;
-        _pending.requiresAck = true;
-        _pending.type        = BUTCOM_MSG_DATA;
-        _pending.msgId       = msgId;
-        _pending.length      = length;
-        _pending.retries     = 0;
-        _pending.lastSendMs  = millis();
+    ButComSendStatus status = sendCheck(type, length, requestAck);
+    if (status != BUTCOM_SEND_QUEUED) return status;
 
-        for (uint8_t i = 0; i < length; i++)
-            _pending.payload[i] = payload[i];
+    uint8_t id = sendMessage(type, payload, length, requestAck);
+    if (msgId) *msgId = id;
+    return BUTCOM_SEND_QUEUED;
+}
+
+// No receiveReply() here: it may wait for a byte
+uint8_t* ButComCore::tryReserve(ButComSendStatus* status) {
+    ButComSendStatus s = sendCheck(BUTCOM_MSG_DATA, 0, true);
+    uint8_t* slot = (s == BUTCOM_SEND_QUEUED) ? _pool.acquire() : nullptr;
+    if (s == BUTCOM_SEND_QUEUED && !slot) s = BUTCOM_SEND_FULL;
+    if (status) *status = s;
+    if (!slot) return nullptr;
+
+    _reserved = slot;
+    return &slot[2];
+}
+
+ButComSendStatus ButComCore::commitReserved(uint8_t length, uint8_t type, uint8_t* msgId) {
+    if (!_reserved)            return BUTCOM_SEND_FULL;
+    if (length > _maxPayload)  return BUTCOM_SEND_TOO_LONG;
+    // The slot becomes the retry frame, which needs an ACK
+    if ((type & BUTCOM_TYPE_NO_ACK) || type == BUTCOM_MSG_HELLO || type == BUTCOM_MSG_ACK)
+        return BUTCOM_SEND_BAD_TYPE;
+
+    // Still reserved while a callback may run in there
+    receiveReply();
+    uint8_t* slot = _reserved;
+    _reserved = nullptr;
+
+    uint8_t id = sendPending(slot, type, length);
+    if (msgId) *msgId = id;
+    return BUTCOM_SEND_QUEUED;
+}
+
+void ButComCore::cancelReserved() {
+    _pool.release(_reserved);
+    _reserved = nullptr;
+}
+
+#if BUTCOM_ISR_TX_QUEUE
+/* ============================================================
+   ISR send queue
+   ------------------------------------------------------------
+   The interrupt handler copies the frame into the next free
+   slot and publishes it by moving _isrTxHead; loop() copies it
+   out and frees the slot before the (long) transmission. Each
+   side only writes its own index, so neither has to lock.
+   ============================================================ */
+
+bool BUTCOM_ISR_ATTR ButComCore::sendFromIsr(const uint8_t* payload, uint8_t length, bool requestAck) {
+    return sendMessageFromIsr(BUTCOM_MSG_DATA, payload, length, requestAck);
+}
+
+bool BUTCOM_ISR_ATTR ButComCore::sendMessageFromIsr(uint8_t type,
+                                                    const uint8_t* payload,
+                                                    uint8_t length,
+                                                    bool requestAck)
+{
+    if (length > BUTCOM_ISR_TX_PAYLOAD) length = BUTCOM_ISR_TX_PAYLOAD;
+
+    uint8_t head = _isrTxHead;
+    uint8_t next = (uint8_t)((head + 1) & (BUTCOM_ISR_TX_QUEUE - 1));
+    if (next == _isrTxTail) {
+        _isrTxDropped = (uint16_t)(_isrTxDropped + 1);
+        return false;
     }
 
-    return msgId;
+    _isrTxType[head]   = type;
+    _isrTxLength[head] = (uint8_t)(length | (requestAck ? 0x80 : 0));
+    for (uint8_t i = 0; i < length; i++)
+        _isrTxPayload[head][i] = payload ? payload[i] : 0;
+
+    _isrTxHead = next;                  // publish after the copy
+    return true;
+}
+
+uint8_t ButComCore::isrTxQueued() const {
+    return (uint8_t)((_isrTxHead - _isrTxTail) & (BUTCOM_ISR_TX_QUEUE - 1));
+}
+
+// Not while a frame comes in (the bytes would interleave), and a frame
+// with ACK waits until it can get the retry slot
+bool ButComCore::isrTxReady() const {
+    uint8_t tail = _isrTxTail;
+    if (tail == _isrTxHead || _rxState != RX_WAIT_START) return false;
+    return !(_isrTxLength[tail] & 0x80) || !_pending.active;
 }
 
-void ButCom::sendRawFrame(uint8_t type,
-                          uint8_t msgId,
-                          const uint8_t* payload,
-                          uint8_t length)
+void ButComCore::sendIsrQueued() {
+    uint8_t tail = _isrTxTail;
+    uint8_t type = _isrTxType[tail];
+    uint8_t len  = _isrTxLength[tail];
+
+    uint8_t payload[BUTCOM_ISR_TX_PAYLOAD];
+    for (uint8_t i = 0; i < (len & 0x7F); i++)
+        payload[i] = _isrTxPayload[tail][i];
+
+    _isrTxTail = (uint8_t)((tail + 1) & (BUTCOM_ISR_TX_QUEUE - 1));
+    sendMessage(type, payload, len & 0x7F, (len & 0x80) != 0);
+}
+#endif
+
+void ButComCore::sendRawFrame(uint8_t type,
+                              uint8_t msgId,
+                              const uint8_t* payload,
+                              uint8_t length)
 {
     uint8_t bodyLen = 2 + length + 1; // type + msgId + payload + crc
 
-    uint8_t crc = 0;
-    crc = crc8_update(crc, bodyLen);
+    // Single pass: the CRC is the last byte, so it is built while sending
+    _phy.sendByte(0xA5);       // START (never FEC encoded)
+    _txFrameStartUs = _phy.lastTxStartUs();
+
+    uint8_t crc = crc8_update(0, bodyLen);
+    sendFrameByte(bodyLen);
     crc = crc8_update(crc, type);
+    sendFrameByte(type);
     crc = crc8_update(crc, msgId);
+    sendFrameByte(msgId);
 
-    for (uint8_t i = 0; i < length; i++)
-        crc = crc8_update(crc, payload ? payload[i] : 0);
+    for (uint8_t i = 0; i < length; i++) {
+        uint8_t b = payload ? payload[i] : 0;
+        crc = crc8_update(crc, b);
+        sendFrameByte(b);
+    }
 
-    _phy.sendByte(0xA5);       // START
-    _phy.sendByte(bodyLen);
-    _phy.sendByte(type);
-    _phy.sendByte(msgId);
+    sendFrameByte(crc);
 
-    for (uint8_t i = 0; i < length; i++)
-        _phy.sendByte(payload ? payload[i] : 0);
+    // Every frame but an ACK (or a NO_ACK one) is answered by one
+    if (type != BUTCOM_MSG_ACK && !(type & BUTCOM_TYPE_NO_ACK))
+        _phy.reserveReplySlot();
+}
+
+void ButComCore::sendBody(const uint8_t* body, uint8_t bodyLength) {
+    _phy.sendByte(0xA5);
+    _txFrameStartUs = _phy.lastTxStartUs();
+    sendFrameByte(bodyLength);
+    for (uint8_t i = 0; i < bodyLength; i++)
+        sendFrameByte(body[i]);
+    _phy.reserveReplySlot();           // retry frames are never ACKs
+}
 
-    _phy.sendByte(crc);
+void ButComCore::sendFrameByte(uint8_t b) {
+    if (_fec) {
+        _phy.sendByte(butcom_fec_encode(b));        // low nibble first
+        _phy.sendByte(butcom_fec_encode(b >> 4));
+    } else {
+        _phy.sendByte(b);
+    }
 }
 
 /* ============================================================
    RX State Machine
    ============================================================ */
 
-void ButCom::handleReceivedByte(uint8_t b) {
+void ButComCore::handleReceivedByte(uint8_t b) {
+    if (!_fec || _rxState == RX_WAIT_START) {
+        handleFrameByte(b);
+        return;
+    }
+
+    // ---- FEC: two code bytes → one frame byte ----
+    uint8_t nibble = butcom_fec_decode(b);
+    if (nibble == BUTCOM_FEC_INVALID) {
+        // Uncorrectable → drop the frame, the sender retries
+        rxReset();
+        return;
+    }
+    if (nibble & BUTCOM_FEC_CORRECTED) _fecCorrections++;
+    nibble &= 0x0F;
+
+    if (!_fecHaveLow) {
+        _fecLow     = nibble;
+        _fecHaveLow = true;
+        return;
+    }
+
+    _fecHaveLow = false;
+    handleFrameByte((uint8_t)(_fecLow | (nibble << 4)));
+}
+
+void ButComCore::handleFrameByte(uint8_t b) {
     switch (_rxState) {
         case RX_WAIT_START:
-            if (b == 0xA5)
-                _rxState = RX_WAIT_LENGTH;
+            if (b == 0xA5) {
+                _rxFrameStartUs = _phy.lastRxStartUs();
+                _fecHaveLow     = false;
+                _rxState        = RX_WAIT_LENGTH;
+            }
             break;
 
         case RX_WAIT_LENGTH:
             _rxExpectedLength = b;
 
             if (_rxExpectedLength < 3 ||
-                _rxExpectedLength > (2 + BUTCOM_MAX_PAYLOAD + 1))
+                (_rxExpectedLength > (uint16_t)(2 + _maxPayload + 1) &&
+                 _rxExpectedLength > sizeof(_rxScratch)))
             {
-                _rxState = RX_WAIT_START;
-            } else {
-                _rxIndex = 0;
-                _rxState = RX_READ_BODY;
+                rxReset();
+                break;
+            }
+
+            // A frame without payload (ACK) fits the scratch buffer, so a
+            // pending TX always gets its ACK even with the pool exhausted.
+            // So does a HELLO too long for the slots; the TYPE byte
+            // rejects anything else of that length.
+            _rxBuffer = (_rxExpectedLength == 3 ||
+                         _rxExpectedLength > (uint16_t)(2 + _maxPayload + 1))
+                ? _rxScratch : _pool.acquire();
+            if (!_rxBuffer) {
+                rxReset();      // no slot: drop, the sender retries
+                break;
             }
+            _rxIndex = 0;
+            _rxState = RX_READ_BODY;
             break;
 
         case RX_READ_BODY:
+            // Fast reject on the TYPE byte: no need to read (and CRC) the
+            // rest of a frame that cannot be valid, and resync starts earlier
+            if (_rxIndex == 0 &&
+                (!frameTypeValid(b, _rxExpectedLength) ||
+                 (_rxBuffer == _rxScratch && _rxExpectedLength > 3 &&
+                  b != BUTCOM_MSG_HELLO)))
+            {
+                rxReset();
+                break;
+            }
+
             _rxBuffer[_rxIndex++] = b;
             if (_rxIndex >= _rxExpectedLength) {
+                _phy.endReplySlot();        // the peer's frame is over
                 processFrame(_rxExpectedLength);
-                _rxState = RX_WAIT_START;
+                rxReset();
             }
             break;
     }
 }
 
-void ButCom::processFrame(uint8_t length) {
+void ButComCore::rxReset() {
+    if (_rxBuffer != _rxScratch)
+        _pool.release(_rxBuffer);
+
+    _rxBuffer   = nullptr;
+    _rxState    = RX_WAIT_START;
+    _fecHaveLow = false;
+}
+
+bool ButComCore::keepRxPayload() {
+    if (!_inCallback || !_rxBuffer || _rxBuffer == _rxScratch)
+        return false;
+    _rxKept = true;
+    return true;
+}
+
+bool ButComCore::frameTypeValid(uint8_t type, uint8_t bodyLength) {
+    uint8_t payLen = bodyLength - 3;
+
+    // NO_ACK: any type that is ACKed otherwise
+    if (type & BUTCOM_TYPE_NO_ACK) {
+        type &= ~BUTCOM_TYPE_NO_ACK;
+        if (type == BUTCOM_MSG_HELLO || type == BUTCOM_MSG_ACK) return false;
+    }
+
+    if (type == BUTCOM_MSG_HELLO) return payLen >= 1;
+    if (type == BUTCOM_MSG_ACK)   return payLen == 0;
+
+    // Add-on layers always start with an opcode byte
+    if (type >= BUTCOM_MSG_PUBSUB && type <= BUTCOM_MSG_TUNE) return payLen >= 1;
+
+    // 8..15 reserved
+    return type >= BUTCOM_MSG_USER || type == BUTCOM_MSG_DATA;
+}
+
+void ButComCore::processFrame(uint8_t length) {
 
     uint8_t type   = _rxBuffer[0];
     uint8_t msgId  = _rxBuffer[1];
@@ -331,34 +1356,69 @@ void ButCom::processFrame(uint8_t length) {
     if (crc != crcRx)
         return; // discard bad frame
 
+    _linkDown = false;                  // the peer is there
+
+    // Streamed frame: its layer confirms it, no ACK
+    bool noAck = (type & BUTCOM_TYPE_NO_ACK) != 0;
+    type &= ~BUTCOM_TYPE_NO_ACK;
+
     // ---- HELLO ----
+    bool rebooted = false;
     if (type == BUTCOM_MSG_HELLO && payLen >= 1) {
-        _remoteId    = _rxBuffer[2];
-        _hasRemoteId = true;
+        rebooted          = peerRebooted(&_rxBuffer[2], payLen);
+        _remoteId         = _rxBuffer[2];
+        _hasRemoteId      = true;
+        _remoteMaxPayload = (payLen >= 3) ? _rxBuffer[4] : 0;
+        _discoverTries    = 0;
+        // Sent from loop(): the ACK goes out first, and a reply never
+        // carries the request flag, so two nodes do not ping-pong
+        if (payLen >= 2 && (_rxBuffer[3] & BUTCOM_HELLO_REQUEST))
+            _helloReplyDue = true;
     }
 
     // ---- ACK ----
     if (type == BUTCOM_MSG_ACK) {
         if (_pending.active &&
             _pending.requiresAck &&
-            _pending.msgId == msgId)
+            _pending.frame[1] == msgId)
         {
             _pending.active = false;
+            _pool.release(_pending.frame);
+            _pending.frame  = nullptr;
         }
     }
 
-    // ---- Duplicate check for DATA ----
+    // ---- Duplicate check (DATA and add-on types) ----
     bool isDuplicate = false;
-    if (type == BUTCOM_MSG_DATA) {
-        if (msgId == _lastDataMsgId)
+    if (type != BUTCOM_MSG_HELLO && type != BUTCOM_MSG_ACK) {
+        if (_lastDataValid && msgId == _lastDataMsgId)
             isDuplicate = true;
-        else
-            _lastDataMsgId = msgId;
+        _lastDataMsgId = msgId;
+        _lastDataValid = true;
     }
 
-    // ---- Auto-ACK (not for ACK frames!) ----
-    if (type != BUTCOM_MSG_ACK)
+    // ---- Auto-ACK (not for ACK frames!), in the turnaround slot ----
+    if (type != BUTCOM_MSG_ACK && !noAck) {
+        _phy.replyInSlot();
         sendRawFrame(BUTCOM_MSG_ACK, msgId, nullptr, 0);
+    }
+
+    if (rebooted) {
+#if BUTCOM_PEER_REBOOT
+        bool dropped = false;
+        if (_rebootPolicy == BUTCOM_REBOOT_DROP && _pending.active) {
+            _pending.active = false;
+            _pool.release(_pending.frame);
+            _pending.frame  = nullptr;
+            dropped = true;
+        }
+        if (_onPeerReboot) {
+            _inCallback = true;
+            _onPeerReboot(_remoteId, dropped);
+            _inCallback = false;
+        }
+#endif
+    }
 
     if (isDuplicate)
         return;
@@ -366,6 +1426,18 @@ void ButCom::processFrame(uint8_t length) {
     if (_callback) {
         const uint8_t* payloadPtr =
             (payLen > 0) ? &_rxBuffer[2] : nullptr;
+        // A HELLO from the scratch buffer: the callback never sees more
+        // than maxPayload() bytes, the rest is in the accessors
+        if (payLen > _maxPayload) payLen = _maxPayload;
+
+        _inCallback = true;
         _callback(msgId, type, payloadPtr, payLen);
+        _inCallback = false;
+
+        // Slot now belongs to the application (releasePayload())
+        if (_rxKept) {
+            _rxKept   = false;
+            _rxBuffer = nullptr;
+        }
     }
 }
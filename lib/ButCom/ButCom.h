@@ -1,5 +1,6 @@
 #pragma once
 #include <Arduino.h>
+#include "ButComPool.h"
 
 /* ============================================================
    ButCom - Lightweight 1-wire communication protocol
@@ -8,6 +9,10 @@
    - Start/Stop bit UART-like framing
    - HELLO handshake (device discovery)
    - CRC-8 validation
+   - Optional Hamming(8,4) forward error correction
+   - Optional bit-timing diagnostics (edge jitter, sampling margin)
+   - Optional interrupt-driven RX; loop() reports its next deadline
+   - Optional wait-free send queue for interrupt handlers
    - Automatic ACK & retry logic
    - Duplicate filter for DATA messages
    - Configurable line speed (1..4 quality)
@@ -19,8 +24,159 @@
 #define BUTCOM_MSG_DATA  1
 #define BUTCOM_MSG_ACK   2
 
-// Maximum bytes per frame payload
+// Add-on layers (ButComPubSub, ...) use their own types on top of
+// sendMessage(). Values below BUTCOM_MSG_USER are reserved for ButCom.
+#define BUTCOM_MSG_PUBSUB 3
+#define BUTCOM_MSG_STATE  4
+#define BUTCOM_MSG_BULK   5
+#define BUTCOM_MSG_TIME   6
+#define BUTCOM_MSG_TUNE   7
+#define BUTCOM_MSG_USER   16
+
+// TYPE flag: the receiver does not ACK this frame. For layers that
+// confirm a run of frames themselves (ButComBulk's STATUS); never with
+// requestAck. The callback gets the type without it.
+#define BUTCOM_TYPE_NO_ACK 0x80
+
+// HELLO payload: [id, flags, maxPayload, bootNonce(2)]; older peers
+// send a prefix of it ([id] only before the flags byte)
+#define BUTCOM_HELLO_REQUEST 0x01   // flags: answer with your HELLO now
+#define BUTCOM_HELLO_LENGTH  5      // HELLO payload bytes, accepted by every instance size
+
+// HELLO requests sent by begin(true) / discover() until a HELLO comes back
+#ifndef BUTCOM_DISCOVER_TRIES
+#define BUTCOM_DISCOVER_TRIES 4
+#endif
+
+// 1 = send a boot nonce in HELLO and detect peer reboots by it
+// (setPeerRebootHandler()). 0 saves 7 bytes RAM per instance; HELLO
+// then carries nonce 0, which a peer never takes for a reboot.
+#ifndef BUTCOM_PEER_REBOOT
+#define BUTCOM_PEER_REBOOT 1
+#endif
+
+// EEPROM address of a 2-byte boot counter for the default boot nonce
+// (AVR, one EEPROM write per begin()); -1 = keep it in RAM that
+// survives warm resets. Unused with setBootNonce() or on the ESP32.
+#ifndef BUTCOM_BOOT_NONCE_EEPROM
+#define BUTCOM_BOOT_NONCE_EEPROM -1
+#endif
+
+// Maximum bytes per frame payload of the default ButCom class and the
+// add-on layers. ButComSized<N> sizes a single instance differently.
+#ifndef BUTCOM_MAX_PAYLOAD
 #define BUTCOM_MAX_PAYLOAD 16
+#endif
+
+// ----------- Timing diagnostics (optional) -----------
+// 1 = compile the edge timing statistics (setTimingDiagnostics()).
+// Costs ~90 bytes RAM per ButCom instance, so it is off by default.
+#ifndef BUTCOM_TIMING_DIAG
+#define BUTCOM_TIMING_DIAG 0
+#endif
+
+#define BUTCOM_DIAG_BINS 16
+
+// ----------- Interrupt RX (optional) -----------
+// 1 = compile the edge-interrupt receiver (setAsyncRx()): bytes are
+// received in the background, so the firmware may sleep between
+// loop() calls. Costs BUTCOM_RX_QUEUE * 5 + ~8 bytes RAM per instance.
+#ifndef BUTCOM_ASYNC_RX
+#define BUTCOM_ASYNC_RX 0
+#endif
+
+// Bytes the interrupt can queue before loop() drains them (power of 2)
+#ifndef BUTCOM_RX_QUEUE
+#define BUTCOM_RX_QUEUE 8
+#endif
+
+// Instances that can use the interrupt receiver at the same time
+#define BUTCOM_ASYNC_SLOTS 4
+
+// ----------- ISR send queue (optional) -----------
+// Slots for frames queued by sendFromIsr() and sent by loop() (power
+// of 2, one stays free; 0 = off). Costs BUTCOM_ISR_TX_QUEUE * (BUTCOM_ISR_TX_PAYLOAD + 2) + 4
+// bytes RAM per instance.
+#ifndef BUTCOM_ISR_TX_QUEUE
+#define BUTCOM_ISR_TX_QUEUE 0
+#endif
+
+// Largest payload sendFromIsr() takes
+#ifndef BUTCOM_ISR_TX_PAYLOAD
+#define BUTCOM_ISR_TX_PAYLOAD 4
+#endif
+
+// ISR code placement where the core requires it (IRAM on the ESP32)
+#ifdef IRAM_ATTR
+#define BUTCOM_ISR_ATTR IRAM_ATTR
+#else
+#define BUTCOM_ISR_ATTR
+#endif
+
+// ----------- Turnaround slot -----------
+// Bit times after the end of a frame in which only its receiver may
+// start sending (its ACK). The ACK starts one idle bit after the frame
+// if the receiver gets to it while 2 bits of the slot are left; the
+// sender stays off the bus for the whole slot, or until the ACK ended.
+#ifndef BUTCOM_REPLY_SLOT_BITS
+#define BUTCOM_REPLY_SLOT_BITS 10
+#endif
+
+// ----------- Bit time limits -----------
+// Shortest bit time setBitTimeUs() accepts. Quality 1 is 300 µs;
+// shorter only works on links that keep up (see ButComLinkTune).
+#ifndef BUTCOM_MIN_BIT_US
+#define BUTCOM_MIN_BIT_US 50
+#endif
+
+// loop() return value when no timer is running
+#define BUTCOM_NO_DEADLINE 0xFFFFFFFFUL
+
+#if BUTCOM_TIMING_DIAG
+// Edge positions of received bytes, measured against the bit
+// boundaries expected from the start-bit edge (see TIMING.md).
+struct ButComTimingStats {
+    uint16_t bitUs;           // bit time the numbers belong to
+    uint32_t bytes;           // bytes measured
+    uint32_t edges;           // data / stop edges measured
+    uint16_t framingErrors;   // stop bit read LOW
+    int16_t  devMinUs;        // earliest edge vs. its expected boundary
+    int16_t  devMaxUs;        // latest edge
+    int16_t  marginMinUs;     // smallest distance edge ↔ sample point
+
+    // Mean deviation of the first three and last three boundaries;
+    // the difference is the clock mismatch accumulated over a byte
+    int32_t  devSumEarly;
+    int32_t  devSumLate;
+    uint32_t countEarly;
+    uint32_t countLate;
+
+    // Edge deviation, bin i = [-bit/2 + i*bit/16, -bit/2 + (i+1)*bit/16)
+    uint16_t jitter[BUTCOM_DIAG_BINS];
+    // Per byte margin, bin i = [i*bit/32, (i+1)*bit/32); bin 0 also
+    // holds bytes whose edges crossed a sample point
+    uint16_t margin[BUTCOM_DIAG_BINS];
+
+    void reset(uint16_t bitUs);
+
+    // Mean deviation change from the first to the last boundary of a
+    // byte: clock mismatch plus the sender's per-bit overhead
+    int16_t  driftUs() const;
+
+    // Smallest bit time that keeps half of the sampling margin for this
+    // link, 0 = fewer than 64 bytes measured
+    uint16_t safeBitUs() const;
+};
+#endif
+
+// Run time of the Arduino calls the PHY is timed with on this MCU and
+// core (ns per call), measured by begin()
+struct ButComCalibration {
+    uint16_t digitalReadNs;
+    uint16_t pinModeNs;
+    uint16_t microsNs;
+    uint16_t millisNs;
+};
 
 // User callback type
 typedef void (*ButComCallback)(
@@ -30,6 +186,23 @@ typedef void (*ButComCallback)(
     uint8_t length
 );
 
+// Peer came back with a new boot nonce. pendingDropped: a frame that
+// waited for its ACK was given up (BUTCOM_REBOOT_DROP).
+typedef void (*ButComPeerRebootFn)(uint8_t remoteId, bool pendingDropped);
+
+// Result of trySend() / tryReserve() / commitReserved()
+enum ButComSendStatus : uint8_t {
+    BUTCOM_SEND_QUEUED,         // on the wire; with ACK request in the retry slot
+    BUTCOM_SEND_FULL,           // retry slot taken (or reserved), or pool empty
+    BUTCOM_SEND_TOO_LONG,       // longer than maxPayload()
+    BUTCOM_SEND_LINK_DOWN,      // last ACKed frame gave up, nothing heard since
+    BUTCOM_SEND_BAD_TYPE        // HELLO / ACK, or NO_ACK for commitReserved()
+};
+
+// What a peer reboot does to the frame waiting for its ACK
+#define BUTCOM_REBOOT_RESEND 0      // full retry budget again
+#define BUTCOM_REBOOT_DROP   1      // give it up
+
 /* ============================================================
    ButComPhy  (Physical Layer)
    ------------------------------------------------------------
@@ -39,12 +212,65 @@ typedef void (*ButComCallback)(
 class ButComPhy {
 public:
     ButComPhy(uint8_t pin, bool useInternalPullup = false);
+#if BUTCOM_ASYNC_RX
+    ~ButComPhy() { endAsync(); }       // frees the ISR slot
+#endif
 
-    void begin();
+    ButComCalibration begin();         // also runs calibrate()
     void setBitTimeUs(uint16_t bitUs);
+    uint16_t bitTimeUs() const { return _bitUs; }
+    // One byte on the wire: start, 8 data and stop bit after the idle guard
+    uint32_t byteUs() const    { return 10UL * _bitUs + _idleMinUs; }
+
+    // Times the pin and timer calls (~1 ms on an 8 MHz AVR, the line
+    // stays released) and moves the RX sample points and TX edges by
+    // their latency. Again after a CPU clock change. Only the resulting
+    // leads are kept; the measurement is returned (and kept for
+    // calibration() with BUTCOM_TIMING_DIAG).
+    ButComCalibration calibrate();
 
     void sendByte(uint8_t value);                        // transmit one byte
-    bool receiveByte(uint8_t& out, uint32_t timeoutMs);  // receive one byte
+    bool receiveByte(uint8_t& out, uint32_t timeoutUs);  // receive one byte
+
+    // micros() at the start-bit edge of the last sent / received byte
+    uint32_t lastTxStartUs() const { return _lastTxStartUs; }
+    uint32_t lastRxStartUs() const { return _lastRxStartUs; }
+
+    // Turnaround slot (see PROTOCOL.md). Sender: the frame just sent
+    // will be ACKed, so keep off the bus until the slot passes unused
+    // or the peer's ACK has ended. endReplySlot(): that ACK was received.
+    void reserveReplySlot();
+    void endReplySlot()            { _slot = SLOT_NONE; }
+    // µs until the slot closes or the peer's ACK must have gone on
+    // (0 = no ACK expected any more)
+    uint32_t replyWaitUs();
+
+    // Receiver: the next sendByte() starts the ACK after the short
+    // turnaround gap if the slot of the frame that just ended (last
+    // received byte) is still open; false if it is too late for that
+    bool replyInSlot();
+
+#if BUTCOM_TIMING_DIAG
+    const ButComCalibration& calibration() const  { return _cal; }
+    void setDiagnostics(bool enabled)             { _diag = enabled; }
+    bool diagnostics() const                      { return _diag; }
+    const ButComTimingStats& timingStats() const  { return _stats; }
+    void resetTimingStats()                       { _stats.reset(_bitUs); }
+#endif
+
+#if BUTCOM_ASYNC_RX
+    // Attach the falling-edge interrupt; notify (may be nullptr) is
+    // called from the ISR after every queued byte. false if the pin has
+    // no interrupt or BUTCOM_ASYNC_SLOTS instances already use one.
+    bool     beginAsync(void (*notify)());
+    void     endAsync();
+    bool     asyncRx() const     { return _asyncSlot >= 0; }
+
+    // Next byte the interrupt received; sets lastRxStartUs()
+    bool     readQueued(uint8_t& out);
+    bool     rxQueued() const    { return _rxHead != _rxTail; }
+    uint16_t rxOverruns() const  { return _rxOverruns; }
+#endif
 
 private:
     uint8_t _pin;
@@ -54,13 +280,82 @@ private:
     uint16_t _halfBitUs;
     uint32_t _idleMinUs;
 
+    uint32_t _lastTxStartUs;
+    uint32_t _lastRxStartUs;
+    uint8_t  _driveLowUs;          // last driveLow() / releaseLine(): call
+    uint8_t  _releaseUs;           // until the line has changed
+
+    // Call latencies from calibrate(): the glitch check and the bit 0
+    // sampleTime are moved this much earlier than a quarter / one and
+    // a half bit after the edge stamp
+    uint8_t  _rxGlitchLeadUs;
+    uint8_t  _rxFirstLeadUs;
+
+    // Turnaround slot. It opens at the end of our last byte's stop bit
+    // and an ACK in it starts one bit after the received frame, both
+    // taken from the byte start stamps.
+    enum SlotState : uint8_t {
+        SLOT_NONE,
+        SLOT_OPEN,
+        SLOT_USED,
+        SLOT_REPLY                 // next byte starts an ACK in the slot
+    };
+    SlotState _slot;
+#if BUTCOM_ASYNC_RX
+    uint8_t   _slotActivity;       // _rxActivity when the slot opened
+#endif
+
+#if BUTCOM_TIMING_DIAG
+    ButComCalibration _cal;
+    bool              _diag;
+    uint8_t           _diagLevel;      // line level seen by the last poll
+    uint16_t          _diagWorstUs;    // largest |deviation| in this byte
+    ButComTimingStats _stats;
+
+    void diagPoll(uint32_t edgeTime);
+    void diagByteDone(uint32_t edgeTime);
+#endif
+
+#if BUTCOM_ASYNC_RX
+    static_assert((BUTCOM_RX_QUEUE & (BUTCOM_RX_QUEUE - 1)) == 0 && BUTCOM_RX_QUEUE <= 128,
+                  "BUTCOM_RX_QUEUE must be a power of 2 up to 128");
+
+    // Single producer (ISR) / single consumer (loop) ring
+    volatile uint8_t  _rxQueue[BUTCOM_RX_QUEUE];
+    volatile uint32_t _rxQueueUs[BUTCOM_RX_QUEUE];
+    volatile uint8_t  _rxHead;
+    volatile uint8_t  _rxTail;
+    volatile uint16_t _rxOverruns;
+    volatile uint8_t  _rxActivity;     // bumped by every ISR that saw a start bit
+    volatile bool     _txActive;       // ISR ignores our own edges
+    int8_t            _asyncSlot;      // -1 = polling receiver
+    void            (*_rxNotify)();
+
+    uint8_t           _readLeadUs;     // one digitalRead()
+    uint8_t           _isrGlitchLeadUs;
+    uint16_t          _isrGlitchUs;    // ISR delays between the samples
+    uint16_t          _isrFirstUs;     // (updateTiming())
+    uint16_t          _isrBitUs;
+
+    static ButComPhy* _asyncOwner[BUTCOM_ASYNC_SLOTS];
+    template <uint8_t Slot> static void edgeIsr();
+    void onEdge();
+#endif
+
     void driveLow();
     void releaseLine();
+    static void waitUntil(uint32_t us);
+    uint32_t slotUs() const      { return BUTCOM_REPLY_SLOT_BITS * (uint32_t)_bitUs; }
+    uint32_t slotStartUs() const { return _lastTxStartUs + 10 * (uint32_t)_bitUs; }
+#if BUTCOM_ASYNC_RX
+    void updateTiming();
+#endif
     void waitIdle();
+    bool peerStartedInSlot() const;
 };
 
 /* ============================================================
-   ButCom (Logical Layer)
+   ButComCore (Logical Layer)
    ------------------------------------------------------------
    Handles:
    - HELLO handshake
@@ -69,35 +364,232 @@ private:
    - ACK & retry mechanism
    - Duplicate DATA filtering
    - Periodic HELLO resync
+
+   Frame buffers come from a ButComFramePool: ButComSized<N>
+   (and ButCom) bring a private one sized for one link, or
+   several instances share one pool. Add-on layers take a
+   ButComCore& and work with every size.
    ============================================================ */
-class ButCom {
+class ButComCore {
 public:
-    ButCom(uint8_t pin, bool internalPullup, uint8_t deviceId);
+    // Instance on a (possibly shared) pool; the pool's slot size sets
+    // maxPayload(). ButComSized / ButCom bring their own pool.
+    ButComCore(uint8_t pin, bool internalPullup, uint8_t deviceId,
+               ButComFramePool& pool);
 
+    // sendHelloOnStart: announce this node and ask the peer for its
+    // HELLO right away (see discover())
     void begin(bool sendHelloOnStart = true);
-    void loop();
+
+    // Sends a HELLO that asks the peer to answer with its own, repeated
+    // up to BUTCOM_DISCOVER_TRIES times until a HELLO arrives. The peer
+    // is known after one round trip instead of its next periodic HELLO.
+    void discover();
+
+    // Services RX, retries and HELLO. Returns the milliseconds until
+    // the next call is needed (see nextDeadlineMs()).
+    //
+    // budgetUs > 0: returns once that much time is used up instead of
+    // waiting up to 10 ms for a start bit. RX takes what fits; a byte
+    // that has started is read to its end, and a frame completed by it
+    // is ACKed (+ callback). A retry or HELLO only starts if the whole
+    // frame (frameUs()) fits, otherwise it waits for a later call and
+    // loop() returns 0. A call can therefore take budgetUs + one byte
+    // + one ACK (frameUs(0)) + the callback. Frames continue over
+    // calls, but the polling receiver only sees bytes that start
+    // while loop() runs.
+    uint32_t loop(uint32_t budgetUs = 0);
+
+    // Airtime of a frame with that payload at the current bit time and
+    // FEC mode: START + LEN + TYPE + MSGID + payload + CRC bytes, each
+    // with the idle gap before it (ACK not included)
+    uint32_t frameUs(uint8_t payloadLength) const;
+
+    // Airtime of the TX work the last loop(budgetUs) left for later,
+    // 0 if none: a call with at least that budget sends it
+    uint32_t deferredFrameUs() const {
+        return _deferredLength ? frameUs((uint8_t)(_deferredLength - 1)) : 0;
+    }
+
+    // Milliseconds until a retry, HELLO or RX timeout falls due,
+    // BUTCOM_NO_DEADLINE if none is running. With the polling receiver
+    // this is always 0: a start bit is only seen while loop() runs.
+    uint32_t nextDeadlineMs() const;
 
     // Send payload. Returns message ID used.
     // If requestAck=true → ButCom handles retries automatically.
     uint8_t send(const uint8_t* payload, uint8_t length, bool requestAck);
 
+    // Same as send(), but with an explicit message type. Used by the
+    // add-on layers; every type except HELLO/ACK gets duplicate filtering.
+    // type | BUTCOM_TYPE_NO_ACK: the peer sends no ACK (requestAck ignored).
+    uint8_t sendMessage(uint8_t type,
+                        const uint8_t* payload,
+                        uint8_t length,
+                        bool requestAck);
+
+    // Checked send: nothing goes out unless the frame can go out as
+    // asked (whole payload, ACK tracked). msgId (optional) receives the
+    // ID on BUTCOM_SEND_QUEUED. LINK_DOWN clears with the next frame
+    // from the peer; discover() asks for one.
+    ButComSendStatus trySend(const uint8_t* payload, uint8_t length,
+                             bool requestAck, uint8_t* msgId = nullptr);
+    ButComSendStatus trySendMessage(uint8_t type, const uint8_t* payload,
+                                    uint8_t length, bool requestAck,
+                                    uint8_t* msgId = nullptr);
+
+    // Non-blocking, zero-copy send with ACK request: takes the retry
+    // slot and returns its payload area (maxPayload() bytes), nullptr
+    // with the reason in status if a send would not go out now. Fill
+    // it, then commitReserved(); cancelReserved() hands it back. Plain
+    // send() frames go out without retry while a slot is reserved.
+    // The frame is ACKed: HELLO, ACK and NO_ACK types are refused with
+    // BUTCOM_SEND_BAD_TYPE and the slot stays reserved.
+    uint8_t*         tryReserve(ButComSendStatus* status = nullptr);
+    ButComSendStatus commitReserved(uint8_t length, uint8_t type = BUTCOM_MSG_DATA,
+                                    uint8_t* msgId = nullptr);
+    void             cancelReserved();
+
+    // false after an ACKed frame ran out of retries, until the peer is
+    // heard again
+    bool linkUp() const { return !_linkDown; }
+
     // Optional configuration
     void setCallback(ButComCallback cb) { _callback = cb; }
     void setAckTimeout(uint16_t ms)     { _ackTimeoutMs = ms; }
     void setMaxRetries(uint8_t r)       { _maxRetries = r; }
+    uint16_t ackTimeoutMs() const       { return _ackTimeoutMs; }
+    uint8_t  maxRetries() const         { return _maxRetries; }
     void setHelloInterval(uint32_t ms)  { _helloIntervalMs = ms; }
 
+    // Peer reboot detection: every HELLO carries a boot nonce. A change
+    // clears the duplicate filter, applies the policy to the frame
+    // waiting for its ACK and calls the handler (inside loop(), like
+    // the message callback). begin() takes the hardware RNG on the
+    // ESP32, elsewhere a boot counter (RAM or BUTCOM_BOOT_NONCE_EEPROM)
+    // that moves on every boot; or pass one before begin(). 0 is
+    // replaced. Both nonces read 0 without BUTCOM_PEER_REBOOT.
+#if BUTCOM_PEER_REBOOT
+    void setPeerRebootHandler(ButComPeerRebootFn fn) { _onPeerReboot = fn; }
+    void setRebootPolicy(uint8_t policy)             { _rebootPolicy = policy; }
+    void setBootNonce(uint16_t nonce)                { _bootNonce = nonce; }
+    uint16_t bootNonce() const                       { return _bootNonce; }
+    // The peer's nonce from its last HELLO, 0 until one brought it
+    uint16_t remoteBootNonce() const                 { return _remoteBootNonce; }
+#else
+    uint16_t bootNonce() const                       { return 0; }
+    uint16_t remoteBootNonce() const                 { return 0; }
+#endif
+
     // Speed Quality: 1=fast, 4=slow/robust
     void setSpeedQuality(uint8_t quality);
 
+    // Any bit time (µs), ACK and byte timeouts scaled like
+    // setSpeedQuality(). Used by ButComLinkTune; both sides must match.
+    void     setBitTimeUs(uint16_t us);
+    uint16_t bitTimeUs() const           { return _phy.bitTimeUs(); }
+
+    // Forward error correction: every byte after START is sent as two
+    // Hamming(8,4) code bytes (single-bit errors corrected before the
+    // CRC check). Doubles frame length; both sides must match.
+    void     setFecMode(bool enabled)    { _fec = enabled; }
+    bool     fecMode() const             { return _fec; }
+    uint16_t fecCorrections() const      { return _fecCorrections; }
+
+#if BUTCOM_TIMING_DIAG
+    // Diagnostic mode: the receiver measures every edge of every byte
+    // against its expected bit boundary. Polling between the sample
+    // points adds a little sampling latency; switch it off afterwards.
+    void setTimingDiagnostics(bool enabled)      { _phy.setDiagnostics(enabled); }
+    const ButComTimingStats& timingStats() const { return _phy.timingStats(); }
+    void resetTimingStats()                      { _phy.resetTimingStats(); }
+
+    // Fastest setSpeedQuality() level at or above timingStats().safeBitUs(),
+    // 0 if unknown (too few bytes) or none is safe
+    uint8_t recommendedQuality() const;
+#endif
+
+#if BUTCOM_ASYNC_RX
+    // Interrupt RX: a falling-edge interrupt on the bus pin receives
+    // each byte (the ISR runs for ~10 bit times with interrupts off,
+    // so AVR millis() loses ticks, see TIMING.md) and queues it for
+    // loop(). notify is called from the ISR after every byte, e.g. to
+    // set a wake-up flag. false if the pin has no interrupt or all
+    // BUTCOM_ASYNC_SLOTS are taken; the polling receiver stays active.
+    bool     setAsyncRx(bool enabled, void (*notify)() = nullptr);
+    bool     asyncRx() const             { return _phy.asyncRx(); }
+    uint16_t rxOverruns() const          { return _phy.rxOverruns(); }
+#endif
+
+#if BUTCOM_ISR_TX_QUEUE
+    // Wait-free send from an interrupt handler: copies the payload (up
+    // to BUTCOM_ISR_TX_PAYLOAD bytes) into a single-producer queue and
+    // returns in microseconds. loop() sends the oldest entry once no
+    // frame is being received and no other frame waits for its ACK.
+    // One producer: call it from ISRs that cannot interrupt each other
+    // (every ISR on AVR), never from both an ISR and loop().
+    // false if the queue is full; the frame is then counted in
+    // isrTxDropped(). Wake the MCU yourself if it sleeps until the
+    // loop() deadline.
+    bool     sendFromIsr(const uint8_t* payload, uint8_t length, bool requestAck);
+    bool     sendMessageFromIsr(uint8_t type, const uint8_t* payload,
+                                uint8_t length, bool requestAck);
+    uint8_t  isrTxQueued() const;
+    uint16_t isrTxDropped() const        { return _isrTxDropped; }
+#endif
+
+    // true while a frame sent with requestAck=true waits for its ACK
+    bool     txPending() const           { return _pending.active; }
+
+    // Feed one received byte into the RX state machine, bypassing the PHY.
+    // loop() does this itself; used by the host fuzz harness (tools/host).
+    void injectRxByte(uint8_t b) { handleReceivedByte(b); }
+
+    // Largest payload this instance sends or accepts; longer sends are
+    // truncated, longer frames dropped like a bad LEN
+    uint8_t maxPayload() const  { return _maxPayload; }
+
+#if BUTCOM_TIMING_DIAG
+    // Call overhead measured by begin() (see ButComPhy::calibrate())
+    const ButComCalibration& calibration() const { return _phy.calibration(); }
+#endif
+
+    // Zero-copy receive: called inside the callback, the payload buffer
+    // (a pool slot) stays valid after the callback returns until it is
+    // handed back with releasePayload(). false if there is nothing to keep.
+    bool keepRxPayload();
+    void releasePayload(const uint8_t* payload) { _pool.release(payload); }
+
+    // Slots of the pool behind this instance (shared if the pool is)
+    const ButComFramePool& pool() const { return _pool; }
+
     // Device identity
     uint8_t id() const          { return _id; }
     bool    hasRemoteId() const { return _hasRemoteId; }
     uint8_t remoteId() const    { return _remoteId; }
+    // Peer's maxPayload() from its HELLO, 0 if it did not send one
+    uint8_t remoteMaxPayload() const { return _remoteMaxPayload; }
+
+    // micros() at the start bit of the last sent / received frame
+    // (START byte). Used by ButComTimeSync.
+    uint32_t lastTxFrameUs() const { return _txFrameStartUs; }
+    uint32_t lastRxFrameUs() const { return _rxFrameStartUs; }
+
+    // CRC-8 (ATM, polynomial 0x07) step, shared with the add-on layers
+    static uint8_t crc8_update(uint8_t crc, uint8_t data);
+
+    // Early drop rule for TYPE vs. LEN (see PROTOCOL.md), shared with
+    // the capture analyzer in tools/host
+    static bool frameTypeValid(uint8_t type, uint8_t bodyLength);
+
+    // Milliseconds until a timer started at `since` fires under the
+    // loop() rule (now - since) > period, 0 if due. Shared with the
+    // add-on layers for their loop() deadlines.
+    static uint32_t msUntil(uint32_t since, uint32_t period, uint32_t now);
 
 private:
     // ----------- Frame Parsing State -----------
-    enum RxState {
+    enum RxState : uint8_t {
         RX_WAIT_START,
         RX_WAIT_LENGTH,
         RX_READ_BODY
@@ -106,50 +598,159 @@ private:
     struct PendingTx {
         bool active;
         bool requiresAck;
-        uint8_t type;
-        uint8_t msgId;
-        uint8_t payload[BUTCOM_MAX_PAYLOAD];
-        uint8_t length;
+        uint8_t* frame;         // pool slot: TYPE MSGID PAYLOAD CRC
+        uint8_t bodyLength;
         uint8_t retries;
         uint32_t lastSendMs;
     };
 
     // Internal helpers
-    void sendHello();
+    void sendHello(uint8_t flags);
+    ButComSendStatus sendCheck(uint8_t type, uint8_t length, bool requestAck) const;
+    bool     fitsBudget(uint8_t payloadLength, uint32_t startUs, uint32_t budgetUs);
+    uint8_t sendPending(uint8_t* slot, uint8_t type, uint8_t length);
+    bool peerRebooted(const uint8_t* hello, uint8_t length);
+    uint32_t discoverRetryMs() const;
+    void receiveReply(uint32_t startUs = 0, uint32_t budgetUs = 0);
     void handleReceivedByte(uint8_t b);
+    void handleFrameByte(uint8_t b);
+    void sendFrameByte(uint8_t b);
     void processFrame(uint8_t bodyLength);
+    void rxReset();
+    void sendBody(const uint8_t* body, uint8_t bodyLength);
 
     void sendRawFrame(uint8_t type,
                       uint8_t msgId,
                       const uint8_t* payload,
                       uint8_t length);
 
-    static uint8_t crc8_update(uint8_t crc, uint8_t data);
+#if BUTCOM_ISR_TX_QUEUE
+    bool isrTxReady() const;
+    void sendIsrQueued();
+#endif
 
     // ----------- Members -----------
     ButComPhy _phy;
     uint8_t   _id;
     uint8_t   _remoteId;
     bool      _hasRemoteId;
+    uint8_t   _remoteMaxPayload;
+#if BUTCOM_PEER_REBOOT
+    uint16_t  _bootNonce;
+    uint16_t  _remoteBootNonce;     // 0 until a HELLO brought one
+
+    ButComPeerRebootFn _onPeerReboot;
+    uint8_t            _rebootPolicy;
+#endif
 
-    ButComCallback _callback;
+    ButComCallback   _callback;
+    ButComFramePool& _pool;
+    uint8_t          _maxPayload;
 
     // RX state machine
     RxState  _rxState;
     uint8_t  _rxExpectedLength;
-    uint8_t  _rxBuffer[2 + BUTCOM_MAX_PAYLOAD + 1];
+    uint8_t* _rxBuffer;         // pool slot or _rxScratch, nullptr between frames
+    // ACKs never wait for a slot; a HELLO longer than the slots
+    // (small ButComSized) is received here too
+    uint8_t  _rxScratch[3 + BUTCOM_HELLO_LENGTH];
+    bool     _inCallback;
+    bool     _rxKept;           // callback took the slot over
     uint8_t  _rxIndex;
+    uint32_t _rxLastByteMs;     // inter-byte timeout while inside a frame
+    uint16_t _rxByteTimeoutMs;
+    uint32_t _rxFrameStartUs;
+    uint32_t _txFrameStartUs;
+
+    // Payload length + 1 of the longest frame the last loop(budgetUs)
+    // left for later, 0 if none
+    uint16_t _deferredLength;
 
     uint8_t  _lastDataMsgId;
+    bool     _lastDataValid;    // no ID is a duplicate before the first frame
+
+    // FEC
+    bool     _fec;
+    bool     _fecHaveLow;       // low nibble of the current byte decoded
+    uint8_t  _fecLow;
+    uint16_t _fecCorrections;
 
     // TX retry
     PendingTx _pending;
+    uint8_t*  _reserved;        // tryReserve() slot until commit / cancel
+    bool      _linkDown;
     uint16_t  _ackTimeoutMs;
     uint8_t   _maxRetries;
 
     // HELLO interval
     uint32_t _lastHelloMs;
     uint32_t _helloIntervalMs;
+    uint8_t  _discoverTries;    // requests left, 0 once a HELLO came back
+    bool     _helloReplyDue;    // the peer asked for our HELLO
 
     uint8_t  _nextMsgId;
+
+#if BUTCOM_ISR_TX_QUEUE
+    static_assert((BUTCOM_ISR_TX_QUEUE & (BUTCOM_ISR_TX_QUEUE - 1)) == 0 &&
+                  BUTCOM_ISR_TX_QUEUE <= 128,
+                  "BUTCOM_ISR_TX_QUEUE must be a power of 2 up to 128");
+    static_assert(BUTCOM_ISR_TX_PAYLOAD <= 127,
+                  "BUTCOM_ISR_TX_PAYLOAD must leave bit 7 of the length free");
+
+    // Single producer (ISR) / single consumer (loop) ring like the
+    // interrupt receiver's: the ISR owns _isrTxHead, loop() _isrTxTail
+    volatile uint8_t  _isrTxType[BUTCOM_ISR_TX_QUEUE];
+    volatile uint8_t  _isrTxLength[BUTCOM_ISR_TX_QUEUE];    // bit 7: requestAck
+    volatile uint8_t  _isrTxPayload[BUTCOM_ISR_TX_QUEUE][BUTCOM_ISR_TX_PAYLOAD];
+    volatile uint8_t  _isrTxHead;
+    volatile uint8_t  _isrTxTail;
+    volatile uint16_t _isrTxDropped;
+#endif
+};
+
+/* ============================================================
+   ButComSized<MaxPayload, Slots>
+   ------------------------------------------------------------
+   ButComCore with a private frame pool sized for one link:
+   Slots frame bodies of MaxPayload + 3 bytes. Two slots cover
+   a frame being received while a sent frame waits for its
+   ACK; with one slot a reply sent from the callback goes out
+   without retries. On AVR ButComSized<1, 1> takes 120 bytes
+   (sizeof, pool included) against 154 for ButCom; a gateway
+   can go up to 252 bytes.
+   Both ends of a link need the same size for the traffic they
+   exchange (a larger frame is dropped by the receiver). The
+   add-on layers size their frames from maxPayload() and stay
+   off below their minimum (usable()).
+
+   Define BUTCOM_RAM_BUDGET (bytes per instance) to have every
+   instance checked at compile time.
+   ============================================================ */
+template <uint8_t MaxPayload, uint8_t Slots>
+struct ButComPoolHolder {
+    ButComFramePoolStatic<MaxPayload, Slots> _framePool;
+};
+
+// The pool is a base listed first, so it exists before ButComCore uses it
+template <uint8_t MaxPayload, uint8_t Slots = 2>
+class ButComSized : private ButComPoolHolder<MaxPayload, Slots>, public ButComCore {
+    static_assert(MaxPayload >= 1,   "a frame slot needs a payload byte");
+    static_assert(MaxPayload <= 252, "LEN (payload + 3) must fit into one byte");
+
+public:
+    ButComSized(uint8_t pin, bool internalPullup, uint8_t deviceId)
+        : ButComCore(pin, internalPullup, deviceId, this->_framePool)
+    {
+#ifdef BUTCOM_RAM_BUDGET
+        static_assert(sizeof(*this) <= BUTCOM_RAM_BUDGET,
+                      "ButCom instance exceeds BUTCOM_RAM_BUDGET");
+#endif
+    }
+};
+
+// Default instance, sized by BUTCOM_MAX_PAYLOAD
+class ButCom : public ButComSized<BUTCOM_MAX_PAYLOAD> {
+public:
+    ButCom(uint8_t pin, bool internalPullup, uint8_t deviceId)
+        : ButComSized<BUTCOM_MAX_PAYLOAD>(pin, internalPullup, deviceId) {}
 };
@@ -0,0 +1,293 @@
+#include "ButComAsync.h"
+
+#if BUTCOM_CORO
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================================
+   Frame arena
+   ============================================================ */
+
+alignas(max_align_t) static uint8_t frameArena[BUTCOM_CORO_FRAMES][BUTCOM_CORO_FRAME_SIZE];
+static bool   frameUsed[BUTCOM_CORO_FRAMES];
+static size_t framePeak;
+
+void* ButComTask::promise_type::operator new(size_t size) noexcept {
+    if (size > framePeak) framePeak = size;
+    if (size > BUTCOM_CORO_FRAME_SIZE) return nullptr;
+
+    for (uint8_t i = 0; i < BUTCOM_CORO_FRAMES; i++) {
+        if (frameUsed[i]) continue;
+        frameUsed[i] = true;
+        return frameArena[i];
+    }
+    return nullptr;
+}
+
+void ButComTask::promise_type::operator delete(void* frame) noexcept {
+    for (uint8_t i = 0; i < BUTCOM_CORO_FRAMES; i++)
+        if (frame == frameArena[i]) frameUsed[i] = false;
+}
+
+// Nothing sensible to resume into
+void ButComTask::promise_type::unhandled_exception() noexcept {
+    abort();
+}
+
+uint8_t ButComTask::framesFree() {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < BUTCOM_CORO_FRAMES; i++)
+        if (!frameUsed[i]) n++;
+    return n;
+}
+
+size_t ButComTask::peakFrameSize() {
+    return framePeak;
+}
+
+/* ============================================================
+   Operations
+   ============================================================ */
+
+ButComAsync::Op::Op(ButComAsync& io, Kind kind)
+    : _io(io),
+      _next(nullptr),
+      _kind(kind),
+      _done(false),
+      _result(false),
+      _startMs(0),
+      _timeoutMs(0),
+      _type(0),
+      _msgId(0),
+      _length(0),
+      _sent(false),
+      _tracked(false),
+      _sentMs(0),
+      _out(nullptr),
+      _filter(BUTCOM_ASYNC_ANY)
+{}
+
+bool ButComAsync::Op::await_ready() {
+    _startMs = millis();
+
+    switch (_kind) {
+        case RECEIVE: return _io.takeFromInbox(*this);
+        case SLEEP:   _result = true; return _timeoutMs == 0;
+        default:      return false;
+    }
+}
+
+void ButComAsync::Op::await_suspend(std::coroutine_handle<> h) {
+    _handle = h;
+    if (_kind == SEND || _kind == CALL) {
+        append(_io._sends, *this);
+        _io.startSend();
+    } else {
+        append(_io._waits, *this);
+    }
+}
+
+ButComAsync::ButComAsync(ButComCore& bus)
+    : _bus(bus),
+      _sends(nullptr),
+      _waits(nullptr),
+      _inboxCount(0),
+      _inboxDropped(0)
+{}
+
+ButComAsync::Op ButComAsync::sendReliable(const uint8_t* payload, uint8_t length, uint8_t type) {
+    Op op(*this, Op::SEND);
+    if (length > BUTCOM_MAX_PAYLOAD) length = BUTCOM_MAX_PAYLOAD;
+    op._type   = type;
+    op._length = length;
+    if (length) memcpy(op._payload, payload, length);
+    return op;
+}
+
+ButComAsync::Op ButComAsync::receive(ButComMessage& out, uint32_t timeoutMs, uint8_t type) {
+    Op op(*this, Op::RECEIVE);
+    op._out       = &out;
+    op._filter    = type;
+    op._timeoutMs = timeoutMs;
+    return op;
+}
+
+ButComAsync::Op ButComAsync::call(uint8_t type, const uint8_t* request, uint8_t length,
+                                  ButComMessage& reply, uint32_t timeoutMs)
+{
+    Op op = sendReliable(request, length, type);
+    op._kind      = Op::CALL;
+    op._out       = &reply;
+    op._filter    = type;
+    op._timeoutMs = timeoutMs;
+    return op;
+}
+
+ButComAsync::Op ButComAsync::sleep(uint32_t ms) {
+    Op op(*this, Op::SLEEP);
+    op._timeoutMs = ms;
+    return op;
+}
+
+/* ============================================================
+   Wait lists
+   ------------------------------------------------------------
+   _sends holds SEND / CALL ops in order; only the head is on
+   the bus. Once its ACK arrives (or the core gives up) it moves
+   to _waits: finished, or - a CALL - waiting for the answer.
+   _waits also holds RECEIVE and SLEEP. loop() resumes every
+   finished op and unlinks it first, because the resumed
+   coroutine may queue the next operation right away.
+   ============================================================ */
+
+void ButComAsync::append(Op*& list, Op& op) {
+    Op** p = &list;
+    while (*p) p = &(*p)->_next;
+    op._next = nullptr;
+    *p = &op;
+}
+
+void ButComAsync::finish(Op& op, bool result) {
+    op._done   = true;
+    op._result = result;
+}
+
+bool ButComAsync::matches(const Op& op, uint8_t type) const {
+    if (op._filter == BUTCOM_ASYNC_ANY)
+        return type != BUTCOM_MSG_ACK && type != BUTCOM_MSG_HELLO;
+    return type == op._filter;
+}
+
+void ButComAsync::copyMessage(ButComMessage& out, uint8_t msgId, uint8_t type,
+                              const uint8_t* payload, uint8_t length)
+{
+    if (length > BUTCOM_MAX_PAYLOAD) length = BUTCOM_MAX_PAYLOAD;
+    out.msgId  = msgId;
+    out.type   = type;
+    out.length = length;
+    if (length) memcpy(out.payload, payload, length);
+}
+
+bool ButComAsync::takeFromInbox(Op& op) {
+    for (uint8_t i = 0; i < _inboxCount; i++) {
+        if (!matches(op, _inbox[i].type)) continue;
+
+        *op._out = _inbox[i];
+        for (uint8_t j = i + 1; j < _inboxCount; j++) _inbox[j - 1] = _inbox[j];
+        _inboxCount--;
+        op._result = true;
+        return true;
+    }
+    return false;
+}
+
+void ButComAsync::startSend() {
+    Op* op = _sends;
+    if (!op || op->_sent || _bus.txPending()) return;
+
+    op->_msgId   = _bus.sendMessage(op->_type, op->_payload, op->_length, true);
+    op->_sent    = true;
+    op->_tracked = _bus.txPending();
+    op->_sentMs  = millis();
+}
+
+/* ============================================================
+   ButCom callback
+   ============================================================ */
+
+bool ButComAsync::handleMessage(uint8_t msgId,
+                                uint8_t type,
+                                const uint8_t* payload,
+                                uint8_t length)
+{
+    if (type == BUTCOM_MSG_ACK) {
+        Op* op = _sends;
+        if (!op || !op->_sent || op->_msgId != msgId) return false;
+
+        // A CALL now waits for its answer; the inbox only holds
+        // messages from before the ACK, so it is not searched
+        _sends = op->_next;
+        if (op->_kind != Op::CALL) finish(*op, true);
+        append(_waits, *op);
+        return false;
+    }
+
+    // An answer goes to its CALL before any plain receive()
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        Op::Kind kind = pass ? Op::RECEIVE : Op::CALL;
+        for (Op* op = _waits; op; op = op->_next) {
+            if (op->_done || op->_kind != kind || !matches(*op, type)) continue;
+            copyMessage(*op->_out, msgId, type, payload, length);
+            finish(*op, true);
+            return false;
+        }
+    }
+
+    if (type == BUTCOM_MSG_HELLO) return false;
+    if (_inboxCount >= BUTCOM_CORO_INBOX) {
+        _inboxDropped++;
+        return false;
+    }
+    copyMessage(_inbox[_inboxCount++], msgId, type, payload, length);
+    return false;
+}
+
+/* ============================================================
+   Scheduler
+   ============================================================ */
+
+uint32_t ButComAsync::loop() {
+    for (;;) {
+        uint32_t now = millis();
+
+        // ---- Head send: the core gave up on it ----
+        Op* head = _sends;
+        if (head && head->_sent) {
+            bool failed = head->_tracked
+                ? !_bus.txPending()
+                : (now - head->_sentMs) > BUTCOM_CORO_ACK_WAIT_MS;
+            if (failed) {
+                _sends = head->_next;
+                finish(*head, false);
+                append(_waits, *head);
+            }
+        }
+
+        // ---- Timeouts ----
+        for (Op* op = _waits; op; op = op->_next) {
+            if (op->_done || !op->_timeoutMs) continue;
+            if (now - op->_startMs >= op->_timeoutMs)
+                finish(*op, op->_kind == Op::SLEEP);
+        }
+
+        startSend();
+
+        // ---- Resume one finished op, then look again ----
+        Op** p = &_waits;
+        while (*p && !(*p)->_done) p = &(*p)->_next;
+        if (!*p) break;
+
+        Op* op = *p;
+        *p = op->_next;
+        op->_next = nullptr;
+        op->_handle.resume();               // may destroy op (its frame)
+    }
+
+    // ---- Next deadline ----
+    uint32_t now  = millis();
+    uint32_t next = BUTCOM_NO_DEADLINE;
+
+    if (_sends && _sends->_sent && !_sends->_tracked) {
+        uint32_t t = ButComCore::msUntil(_sends->_sentMs, BUTCOM_CORO_ACK_WAIT_MS, now);
+        if (t < next) next = t;
+    }
+    for (Op* op = _waits; op; op = op->_next) {
+        if (!op->_timeoutMs) continue;
+        uint32_t elapsed = now - op->_startMs;
+        uint32_t t = (elapsed >= op->_timeoutMs) ? 0 : op->_timeoutMs - elapsed;
+        if (t < next) next = t;
+    }
+    return next;
+}
+
+#endif
@@ -0,0 +1,209 @@
+#pragma once
+#include "ButCom.h"
+
+/* ============================================================
+   ButComAsync - C++20 coroutine API
+   ------------------------------------------------------------
+   Protocol logic written as straight-line code:
+
+     ButComTask probe(ButComAsync& io) {
+         ButComMessage reply;
+         for (;;) {
+             uint8_t req[1] = { 0x01 };
+             if (co_await io.call(BUTCOM_MSG_DATA, req, 1, reply, 200))
+                 handle(reply);
+             co_await io.sleep(1000);
+         }
+     }
+
+     ButComTask t = probe(io);   // runs until its first co_await
+     if (!t.started()) { ... }   // no frame slot
+
+   A coroutine suspends on an operation and ButComAsync::loop()
+   resumes it when the operation is done - never from inside
+   the ButCom callback, so a resumed coroutine may send. All
+   coroutines run on the thread that calls loop().
+
+   Frames come from a static arena of BUTCOM_CORO_FRAMES slots
+   of BUTCOM_CORO_FRAME_SIZE bytes; no heap. A coroutine whose
+   frame does not fit is not started (ButComTask::started()).
+   The awaiters live in the suspended frames and are chained
+   into ButComAsync's wait lists, so waiting costs no extra RAM.
+
+   Messages nobody waits for are kept in a small inbox
+   (BUTCOM_CORO_INBOX); receive() looks there first. HELLO only
+   goes to a receive() that asks for it by type.
+   ============================================================ */
+
+// 1 = compile ButComAsync (default when the compiler has coroutines)
+#ifndef BUTCOM_CORO
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define BUTCOM_CORO 1
+#endif
+#endif
+#endif
+#ifndef BUTCOM_CORO
+#define BUTCOM_CORO 0
+#endif
+
+#if BUTCOM_CORO
+#include <coroutine>
+#include <stddef.h>
+
+// Coroutine frames that can be alive at the same time
+#ifndef BUTCOM_CORO_FRAMES
+#define BUTCOM_CORO_FRAMES 4
+#endif
+
+// Bytes per frame; ButComTask::peakFrameSize() shows what is used
+#ifndef BUTCOM_CORO_FRAME_SIZE
+#define BUTCOM_CORO_FRAME_SIZE 512
+#endif
+
+// Received messages kept while no coroutine waits for them
+#ifndef BUTCOM_CORO_INBOX
+#define BUTCOM_CORO_INBOX 4
+#endif
+
+// How long sendReliable() waits for an ACK when the core had no
+// retry slot for the frame (sent once, not tracked by txPending())
+#ifndef BUTCOM_CORO_ACK_WAIT_MS
+#define BUTCOM_CORO_ACK_WAIT_MS 250
+#endif
+
+// receive() type filter: every type except ACK and HELLO
+#define BUTCOM_ASYNC_ANY 0xFF
+
+struct ButComMessage {
+    uint8_t msgId;
+    uint8_t type;
+    uint8_t length;
+    uint8_t payload[BUTCOM_MAX_PAYLOAD];
+};
+
+// Fire-and-forget coroutine: starts at once, frees its frame when
+// it returns
+class ButComTask {
+public:
+    struct promise_type {
+        ButComTask get_return_object() noexcept { return ButComTask(true); }
+        static ButComTask get_return_object_on_allocation_failure() noexcept { return ButComTask(false); }
+
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept   { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept;
+
+        static void* operator new(size_t size) noexcept;
+        static void  operator delete(void* frame) noexcept;
+    };
+
+    // false if no arena slot was free or large enough
+    bool started() const { return _started; }
+
+    // Arena state
+    static uint8_t framesFree();
+    static size_t  peakFrameSize();       // largest frame requested so far
+
+private:
+    explicit ButComTask(bool started) : _started(started) {}
+    bool _started;
+};
+
+class ButComAsync {
+public:
+    explicit ButComAsync(ButComCore& bus);
+
+    class Op;
+
+    // co_await → true once the peer ACKed the frame, false when the
+    // core gave up after its retries. Frames go out one at a time.
+    Op sendReliable(const uint8_t* payload, uint8_t length,
+                    uint8_t type = BUTCOM_MSG_DATA);
+
+    // co_await → true with the next message of `type` in `out`,
+    // false after timeoutMs (0 = wait forever)
+    Op receive(ButComMessage& out, uint32_t timeoutMs = 0,
+               uint8_t type = BUTCOM_ASYNC_ANY);
+
+    // sendReliable() + receive() of the answer (same type); false if
+    // the request was not ACKed or no answer came within timeoutMs of
+    // the co_await. The core ACKs before its callback runs, so an
+    // answer sent from the peer's callback always follows the ACK.
+    Op call(uint8_t type, const uint8_t* request, uint8_t length,
+            ButComMessage& reply, uint32_t timeoutMs);
+
+    // co_await → true after ms milliseconds
+    Op sleep(uint32_t ms);
+
+    // Feed every frame from the ButCom callback through here
+    // (ACKs included). Always returns false: other layers still see
+    // the frame.
+    bool handleMessage(uint8_t msgId,
+                       uint8_t type,
+                       const uint8_t* payload,
+                       uint8_t length);
+
+    // Starts queued sends and resumes every coroutine whose operation
+    // finished. Call after bus.loop(). Returns the ms until the next
+    // timeout (BUTCOM_NO_DEADLINE if none).
+    uint32_t loop();
+
+    uint16_t inboxDropped() const { return _inboxDropped; }
+
+    /* ---- Awaitable returned by the operations ---- */
+    class Op {
+    public:
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        bool await_resume() const { return _result; }
+
+    private:
+        friend class ButComAsync;
+        enum Kind : uint8_t { SEND, RECEIVE, CALL, SLEEP };
+
+        Op(ButComAsync& io, Kind kind);
+
+        ButComAsync&            _io;
+        Op*                     _next;       // wait list link
+        std::coroutine_handle<> _handle;
+        Kind                    _kind;
+        bool                    _done;
+        bool                    _result;
+
+        uint32_t                _startMs;
+        uint32_t                _timeoutMs;  // RECEIVE / CALL / SLEEP, 0 = none
+
+        // SEND / CALL
+        uint8_t                 _type;
+        uint8_t                 _msgId;
+        uint8_t                 _length;
+        bool                    _sent;
+        bool                    _tracked;    // core holds it for retries
+        uint32_t                _sentMs;
+        uint8_t                 _payload[BUTCOM_MAX_PAYLOAD];
+
+        // RECEIVE / CALL
+        ButComMessage*          _out;
+        uint8_t                 _filter;
+    };
+
+private:
+    static void append(Op*& list, Op& op);
+    static void finish(Op& op, bool result);
+    bool takeFromInbox(Op& op);
+    bool matches(const Op& op, uint8_t type) const;
+    void startSend();
+    static void copyMessage(ButComMessage& out, uint8_t msgId, uint8_t type,
+                            const uint8_t* payload, uint8_t length);
+
+    ButComCore& _bus;
+    Op*         _sends;          // FIFO, head is on the bus once _sent
+    Op*         _waits;          // RECEIVE, SLEEP and CALL after its ACK
+
+    ButComMessage _inbox[BUTCOM_CORO_INBOX];
+    uint8_t       _inboxCount;
+    uint16_t      _inboxDropped;
+};
+#endif
@@ -0,0 +1,421 @@
+#include "ButComBulk.h"
+
+/* ============================================================
+   CRC-32 (nibble table)
+   ============================================================ */
+static const uint32_t crc32_nibble[16] PROGMEM = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t butcom_crc32_update(uint32_t crc, uint8_t data) {
+    crc ^= data;
+    crc = (crc >> 4) ^ pgm_read_dword(&crc32_nibble[crc & 0x0F]);
+    crc = (crc >> 4) ^ pgm_read_dword(&crc32_nibble[crc & 0x0F]);
+    return crc;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v);
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0]
+         | ((uint32_t)p[1] << 8)
+         | ((uint32_t)p[2] << 16)
+         | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t blockCrc(uint16_t block, const uint8_t* data, uint8_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    crc = butcom_crc32_update(crc, (uint8_t)block);
+    crc = butcom_crc32_update(crc, (uint8_t)(block >> 8));
+    for (uint8_t i = 0; i < length; i++)
+        crc = butcom_crc32_update(crc, data[i]);
+    return ~crc;
+}
+
+/* ============================================================
+   ButComBulkSender
+   ============================================================ */
+
+ButComBulkSender::ButComBulkSender(ButComCore& bus)
+    : _bus(bus),
+      _image(nullptr),
+      _read(nullptr),
+      _state(IDLE),
+      _size(0),
+      _imageCrc(0),
+      _blockSize(0),
+      _blockCount(0),
+      _base(0),
+      _next(0),
+      _statusTimeoutMs(250),
+      _maxRetries(5),
+      _retries(0),
+      _waitStartMs(0)
+{}
+
+bool ButComBulkSender::start(const uint8_t* image, uint32_t size) {
+    if (busy() || !image) return false;
+    _image = image;
+    _read  = nullptr;
+    return startTransfer(size);
+}
+
+bool ButComBulkSender::start(ButComBulkReadFn read, uint32_t size) {
+    if (busy() || !read) return false;
+    _image = nullptr;
+    _read  = read;
+    return startTransfer(size);
+}
+
+bool ButComBulkSender::startTransfer(uint32_t size) {
+    // Blocks fill the frames of this instance; START takes 10 bytes
+    uint8_t frame = _bus.maxPayload();
+    if (frame > BUTCOM_BULK_MAX_FRAME) frame = BUTCOM_BULK_MAX_FRAME;
+    if (frame < 10) return false;
+    uint8_t blockSize = frame - BUTCOM_BULK_BLOCK_OVERHEAD;
+
+    uint32_t blocks = (size + blockSize - 1) / blockSize;
+    if (size == 0 || blocks > 0xFFFF) return false;
+
+    // CRC-32 of the whole image (final hash check on the receiver)
+    uint32_t crc = 0xFFFFFFFF;
+    uint8_t  buf[BUTCOM_BULK_MAX_FRAME];
+    for (uint32_t off = 0; off < size; off += blockSize) {
+        uint8_t n = (size - off < blockSize) ? (uint8_t)(size - off) : blockSize;
+        readImage(off, buf, n);
+        for (uint8_t i = 0; i < n; i++)
+            crc = butcom_crc32_update(crc, buf[i]);
+    }
+
+    _size       = size;
+    _imageCrc   = ~crc;
+    _blockSize  = blockSize;
+    _blockCount = (uint16_t)blocks;
+    _base       = 0;
+    _next       = 0;
+    _retries    = 0;
+
+    sendStart();
+    return true;
+}
+
+void ButComBulkSender::abort() {
+    if (!busy()) return;
+    sendSimple(BUTCOM_BULK_OP_ABORT);
+    _state = FAILED;
+}
+
+uint32_t ButComBulkSender::bytesAcked() const {
+    uint32_t b = (uint32_t)_base * _blockSize;
+    return (b > _size) ? _size : b;
+}
+
+void ButComBulkSender::readImage(uint32_t offset, uint8_t* data, uint8_t length) {
+    if (_read) {
+        _read(offset, data, length);
+    } else {
+        for (uint8_t i = 0; i < length; i++)
+            data[i] = _image[offset + i];
+    }
+}
+
+// Every BULK frame goes without frame ACK: START, POLL and FINISH are
+// answered by STATUS, blocks are confirmed by it, and a lost STATUS
+// is asked for again
+void ButComBulkSender::sendStart() {
+    uint8_t payload[10];
+    payload[0] = BUTCOM_BULK_OP_START;
+    put32(&payload[1], _size);
+    put32(&payload[5], _imageCrc);
+    payload[9] = _blockSize;
+    _bus.sendMessage(BUTCOM_MSG_BULK | BUTCOM_TYPE_NO_ACK, payload, 10, false);
+
+    _state       = STARTING;
+    _waitStartMs = millis();
+}
+
+void ButComBulkSender::sendSimple(uint8_t op) {
+    uint8_t payload[1] = { op };
+    _bus.sendMessage(BUTCOM_MSG_BULK | BUTCOM_TYPE_NO_ACK, payload, 1, false);
+}
+
+void ButComBulkSender::sendBlock(uint16_t block, bool poll) {
+    uint32_t offset = (uint32_t)block * _blockSize;
+    uint8_t  n      = (_size - offset < _blockSize)
+                    ? (uint8_t)(_size - offset) : _blockSize;
+
+    uint8_t payload[BUTCOM_BULK_MAX_FRAME];
+    payload[0] = BUTCOM_BULK_OP_BLOCK | (poll ? BUTCOM_BULK_FLAG_POLL : 0);
+    payload[1] = (uint8_t)block;
+    payload[2] = (uint8_t)(block >> 8);
+    readImage(offset, &payload[3], n);
+    put32(&payload[3 + n], blockCrc(block, &payload[3], n));
+
+    // No ACK per block: the blocks of a window follow each other after
+    // the idle guard, and STATUS confirms them all
+    _bus.sendMessage(BUTCOM_MSG_BULK | BUTCOM_TYPE_NO_ACK, payload, 7 + n, false);
+}
+
+uint32_t ButComBulkSender::loop() {
+    uint32_t now = millis();
+
+    switch (_state) {
+        case SENDING: {
+            if (_base >= _blockCount) {
+                sendSimple(BUTCOM_BULK_OP_FINISH);
+                _state       = FINISHING;
+                _waitStartMs = now;
+                break;
+            }
+
+            // One block per call so bus.loop() keeps running in between
+            bool poll = ((uint16_t)(_next + 1 - _base) >= BUTCOM_BULK_WINDOW) ||
+                        (_next + 1 >= _blockCount);
+            sendBlock(_next++, poll);
+
+            if (poll) {
+                _state       = WAIT_STATUS;
+                _waitStartMs = millis();
+            }
+            break;
+        }
+
+        case STARTING:
+        case WAIT_STATUS:
+        case FINISHING:
+            if ((now - _waitStartMs) > _statusTimeoutMs)
+                onTimeout();
+            break;
+
+        default:
+            break;
+    }
+
+    switch (_state) {
+        case SENDING:
+            return 0;
+
+        case STARTING:
+        case WAIT_STATUS:
+        case FINISHING:
+            return ButComCore::msUntil(_waitStartMs, _statusTimeoutMs, millis());
+
+        default:
+            return BUTCOM_NO_DEADLINE;
+    }
+}
+
+void ButComBulkSender::onTimeout() {
+    if (_retries >= _maxRetries) {
+        // Receiver keeps its progress; a new start() resumes
+        _state = FAILED;
+        return;
+    }
+    _retries++;
+
+    if (_state == STARTING) {
+        sendStart();
+    } else {
+        sendSimple(_state == FINISHING ? BUTCOM_BULK_OP_FINISH
+                                       : BUTCOM_BULK_OP_POLL);
+        _waitStartMs = millis();
+    }
+}
+
+bool ButComBulkSender::handleMessage(uint8_t msgId,
+                                     uint8_t type,
+                                     const uint8_t* payload,
+                                     uint8_t length)
+{
+    (void)msgId;
+
+    if (type != BUTCOM_MSG_BULK || length < 1)
+        return false;
+    if (payload[0] != BUTCOM_BULK_OP_STATUS || length < 4 || !busy())
+        return true;
+
+    uint16_t next  = (uint16_t)payload[1] | ((uint16_t)payload[2] << 8);
+    uint8_t  flags = payload[3];
+
+    if (flags & (BUTCOM_BULK_STATUS_REJECTED | BUTCOM_BULK_STATUS_WRITE_ERROR)) {
+        _state = FAILED;
+        return true;
+    }
+
+    if (_state == FINISHING) {
+        if (flags & BUTCOM_BULK_STATUS_DONE_OK)  { _state = DONE;   return true; }
+        if (flags & BUTCOM_BULK_STATUS_DONE_BAD) { _state = FAILED; return true; }
+    }
+
+    if (next > _blockCount) next = _blockCount;
+
+    // Cumulative ACK; resend from the first missing block (go-back-N).
+    // No progress counts like a timeout, so a block the receiver keeps
+    // refusing does not hold the sender forever
+    if (next > _base || _state == STARTING) {
+        _retries = 0;
+    } else if (_retries >= _maxRetries) {
+        _state = FAILED;
+        return true;
+    } else {
+        _retries++;
+    }
+    _base  = next;
+    _next  = next;
+    _state = SENDING;
+    return true;
+}
+
+/* ============================================================
+   ButComBulkReceiver
+   ============================================================ */
+
+ButComBulkReceiver::ButComBulkReceiver(ButComCore& bus)
+    : _bus(bus),
+      _onBegin(nullptr),
+      _onWrite(nullptr),
+      _onDone(nullptr),
+      _active(false),
+      _size(0),
+      _imageCrc(0),
+      _blockSize(0),
+      _blockCount(0),
+      _nextBlock(0),
+      _runningCrc(0xFFFFFFFF),
+      _doneFlags(BUTCOM_BULK_STATUS_REJECTED)
+{}
+
+uint32_t ButComBulkReceiver::bytesReceived() const {
+    uint32_t b = (uint32_t)_nextBlock * _blockSize;
+    return (b > _size) ? _size : b;
+}
+
+void ButComBulkReceiver::sendStatus(uint8_t flags) {
+    uint8_t payload[4] = {
+        BUTCOM_BULK_OP_STATUS,
+        (uint8_t)_nextBlock,
+        (uint8_t)(_nextBlock >> 8),
+        flags
+    };
+    _bus.sendMessage(BUTCOM_MSG_BULK | BUTCOM_TYPE_NO_ACK, payload, 4, false);
+}
+
+// false only if the write hook failed (the transfer is over then)
+bool ButComBulkReceiver::onBlock(const uint8_t* payload, uint8_t length) {
+    if (length < 7) return true;
+
+    uint16_t block = (uint16_t)payload[1] | ((uint16_t)payload[2] << 8);
+    uint8_t  n     = length - 7;
+
+    // Only the next block in order is accepted (go-back-N)
+    if (block != _nextBlock || block >= _blockCount) return true;
+
+    uint32_t offset   = (uint32_t)block * _blockSize;
+    uint8_t  expected = (_size - offset < _blockSize)
+                      ? (uint8_t)(_size - offset) : _blockSize;
+    if (n != expected) return true;
+
+    if (get32(&payload[3 + n]) != blockCrc(block, &payload[3], n)) return true;
+
+    // Storage failed: resending the block would not help
+    if (_onWrite && !_onWrite(offset, &payload[3], n)) {
+        _active    = false;
+        _doneFlags = BUTCOM_BULK_STATUS_WRITE_ERROR;
+        if (_onDone) _onDone(false);
+        return false;
+    }
+
+    for (uint8_t i = 0; i < n; i++)
+        _runningCrc = butcom_crc32_update(_runningCrc, payload[3 + i]);
+    _nextBlock++;
+    return true;
+}
+
+bool ButComBulkReceiver::handleMessage(uint8_t msgId,
+                                       uint8_t type,
+                                       const uint8_t* payload,
+                                       uint8_t length)
+{
+    (void)msgId;
+
+    if (type != BUTCOM_MSG_BULK || length < 1)
+        return false;
+
+    uint8_t op = payload[0] & ~BUTCOM_BULK_FLAG_POLL;
+
+    switch (op) {
+        case BUTCOM_BULK_OP_START: {
+            if (length < 10) break;
+
+            uint32_t size      = get32(&payload[1]);
+            uint32_t crc       = get32(&payload[5]);
+            uint8_t  blockSize = payload[9];
+            uint32_t blocks    = blockSize ? (size + blockSize - 1) / blockSize : 0;
+
+            // Same image as the interrupted transfer → resume
+            bool resume = _active && size == _size && crc == _imageCrc &&
+                          blockSize == _blockSize;
+
+            if (!resume) {
+                // A block must fit our frames
+                if (size == 0 || blocks == 0 || blocks > 0xFFFF ||
+                    blockSize + BUTCOM_BULK_BLOCK_OVERHEAD > _bus.maxPayload() ||
+                    (_onBegin && !_onBegin(size)))
+                {
+                    _active = false;
+                    sendStatus(BUTCOM_BULK_STATUS_REJECTED);
+                    break;
+                }
+                _active     = true;
+                _size       = size;
+                _imageCrc   = crc;
+                _blockSize  = blockSize;
+                _blockCount = (uint16_t)blocks;
+                _nextBlock  = 0;
+                _runningCrc = 0xFFFFFFFF;
+                _doneFlags  = 0;
+            }
+            sendStatus(0);
+            break;
+        }
+
+        case BUTCOM_BULK_OP_BLOCK: {
+            // A write error is reported at once, not only on a poll
+            bool failed = _active && !onBlock(payload, length);
+            if (failed || (payload[0] & BUTCOM_BULK_FLAG_POLL))
+                sendStatus(_active ? 0 : _doneFlags);
+            break;
+        }
+
+        case BUTCOM_BULK_OP_POLL:
+            sendStatus(_active ? 0 : _doneFlags);
+            break;
+
+        case BUTCOM_BULK_OP_FINISH:
+            if (_active && _nextBlock >= _blockCount) {
+                bool ok = (~_runningCrc == _imageCrc);
+                _active    = false;
+                _doneFlags = ok ? BUTCOM_BULK_STATUS_DONE_OK
+                                : BUTCOM_BULK_STATUS_DONE_BAD;
+                if (_onDone) _onDone(ok);
+            }
+            // Not complete yet → plain STATUS tells the sender where to go on
+            sendStatus(_active ? 0 : _doneFlags);
+            break;
+
+        case BUTCOM_BULK_OP_ABORT:
+            _active    = false;
+            _doneFlags = BUTCOM_BULK_STATUS_REJECTED;
+            break;
+    }
+
+    return true;
+}
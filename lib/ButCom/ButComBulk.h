@@ -0,0 +1,174 @@
+#pragma once
+#include "ButCom.h"
+
+/* ============================================================
+   ButComBulk - Windowed bulk transfer (firmware images)
+   ------------------------------------------------------------
+   - Image is split in fixed-size blocks, each with its own
+     CRC-32 on top of the frame CRC-8
+   - Block size follows the sender's maxPayload() and is
+     announced in START; the receiver rejects blocks larger
+     than its own frames
+   - Sender streams a window of blocks without frame ACKs
+     (BUTCOM_TYPE_NO_ACK); the last block of a window asks
+     for a STATUS
+   - STATUS is a cumulative ACK (next expected block), so lost
+     or corrupt blocks are resent go-back-N style. A STATUS
+     without progress counts as a retry
+   - A failing write hook ends the transfer (WRITE_ERROR)
+   - A START for the same image (size + CRC-32) resumes at the
+     receiver's next expected block after an interruption
+   - FINISH makes the receiver check the CRC-32 of the whole
+     image before reporting success
+   ============================================================ */
+
+// BLOCK payload bytes besides the data: op + block number + CRC-32
+#define BUTCOM_BULK_BLOCK_OVERHEAD 7
+
+// Largest BLOCK payload the sender builds (a stack buffer), so at most
+// BUTCOM_BULK_MAX_FRAME - 7 data bytes per block on larger instances
+#ifndef BUTCOM_BULK_MAX_FRAME
+#define BUTCOM_BULK_MAX_FRAME 64
+#endif
+
+// Blocks sent before waiting for a STATUS
+#ifndef BUTCOM_BULK_WINDOW
+#define BUTCOM_BULK_WINDOW 8
+#endif
+
+// Opcodes (payload[0] of a BUTCOM_MSG_BULK frame)
+#define BUTCOM_BULK_OP_START   1   // [op, size(4), imageCrc(4), blockSize]
+#define BUTCOM_BULK_OP_BLOCK   2   // [op, block(2), data..., blockCrc(4)]
+#define BUTCOM_BULK_OP_FINISH  3   // [op]
+#define BUTCOM_BULK_OP_STATUS  4   // [op, nextBlock(2), flags]
+#define BUTCOM_BULK_OP_POLL    5   // [op] → receiver answers with STATUS
+#define BUTCOM_BULK_OP_ABORT   6   // [op]
+#define BUTCOM_BULK_FLAG_POLL  0x80 // on BLOCK: answer with STATUS
+
+// STATUS flags
+#define BUTCOM_BULK_STATUS_DONE_OK  0x01
+#define BUTCOM_BULK_STATUS_DONE_BAD 0x02
+#define BUTCOM_BULK_STATUS_REJECTED 0x04
+#define BUTCOM_BULK_STATUS_WRITE_ERROR 0x08   // write hook failed, transfer ended
+
+// CRC-32 (IEEE 802.3, reflected 0xEDB88320), start with 0xFFFFFFFF,
+// invert at the end. Nibble table → 64 bytes of flash.
+uint32_t butcom_crc32_update(uint32_t crc, uint8_t data);
+
+// ---- Receiver hooks (bootloader side) ----
+typedef bool (*ButComBulkBeginFn)(uint32_t size);     // prepare / erase; false = reject
+typedef bool (*ButComBulkWriteFn)(uint32_t offset,
+                                  const uint8_t* data,
+                                  uint8_t length);    // false = write error
+typedef void (*ButComBulkDoneFn)(bool ok);
+
+// ---- Sender data source ----
+typedef void (*ButComBulkReadFn)(uint32_t offset,
+                                 uint8_t* data,
+                                 uint8_t length);
+
+/* ============================================================
+   ButComBulkSender
+   ============================================================ */
+class ButComBulkSender {
+public:
+    enum State {
+        IDLE,
+        STARTING,
+        SENDING,
+        WAIT_STATUS,
+        FINISHING,
+        DONE,
+        FAILED
+    };
+
+    explicit ButComBulkSender(ButComCore& bus);
+
+    void setStatusTimeout(uint16_t ms) { _statusTimeoutMs = ms; }
+    void setMaxRetries(uint8_t r)      { _maxRetries = r; }
+
+    // Image from memory, or from a read callback (external flash, SD, ...).
+    // false while busy, or if the bus cannot carry START (10 bytes)
+    bool start(const uint8_t* image, uint32_t size);
+    bool start(ButComBulkReadFn read, uint32_t size);
+    void abort();
+
+    // Sends the next block or handles timeouts. Call after bus.loop().
+    // Returns the ms until it needs to run again (BUTCOM_NO_DEADLINE
+    // while idle or waiting for the bus).
+    uint32_t loop();
+
+    bool handleMessage(uint8_t msgId,
+                       uint8_t type,
+                       const uint8_t* payload,
+                       uint8_t length);
+
+    State    state() const       { return _state; }
+    bool     busy() const        { return _state != IDLE && _state != DONE && _state != FAILED; }
+    uint32_t bytesAcked() const;
+    uint32_t size() const        { return _size; }
+    uint8_t  blockSize() const   { return _blockSize; }
+
+private:
+    bool startTransfer(uint32_t size);
+    void readImage(uint32_t offset, uint8_t* data, uint8_t length);
+    void sendStart();
+    void sendBlock(uint16_t block, bool poll);
+    void sendSimple(uint8_t op);
+    void onTimeout();
+
+    ButComCore&      _bus;
+    const uint8_t*   _image;
+    ButComBulkReadFn _read;
+
+    State    _state;
+    uint32_t _size;
+    uint32_t _imageCrc;
+    uint8_t  _blockSize;   // data bytes per block
+    uint16_t _blockCount;
+    uint16_t _base;        // first unacknowledged block
+    uint16_t _next;        // next block to send
+
+    uint16_t _statusTimeoutMs;
+    uint8_t  _maxRetries;
+    uint8_t  _retries;
+    uint32_t _waitStartMs;
+};
+
+/* ============================================================
+   ButComBulkReceiver
+   ============================================================ */
+class ButComBulkReceiver {
+public:
+    explicit ButComBulkReceiver(ButComCore& bus);
+
+    void setBeginHandler(ButComBulkBeginFn fn) { _onBegin = fn; }
+    void setWriteHandler(ButComBulkWriteFn fn) { _onWrite = fn; }
+    void setDoneHandler(ButComBulkDoneFn fn)   { _onDone  = fn; }
+
+    bool handleMessage(uint8_t msgId,
+                       uint8_t type,
+                       const uint8_t* payload,
+                       uint8_t length);
+
+    bool     active() const        { return _active; }
+    uint32_t bytesReceived() const;
+
+private:
+    void sendStatus(uint8_t flags);
+    bool onBlock(const uint8_t* payload, uint8_t length);
+
+    ButComCore&       _bus;
+    ButComBulkBeginFn _onBegin;
+    ButComBulkWriteFn _onWrite;
+    ButComBulkDoneFn  _onDone;
+
+    bool     _active;
+    uint32_t _size;
+    uint32_t _imageCrc;
+    uint8_t  _blockSize;
+    uint16_t _blockCount;
+    uint16_t _nextBlock;
+    uint32_t _runningCrc;   // CRC-32 over all accepted blocks (in order)
+    uint8_t  _doneFlags;    // STATUS flags of the last finished transfer
+};
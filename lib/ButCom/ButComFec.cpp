@@ -0,0 +1,43 @@
+#include "ButComFec.h"
+
+/* ============================================================
+   Extended Hamming(8,4)
+   ------------------------------------------------------------
+   Code byte bits (LSB first): p1 p2 d0 p3 d1 d2 d3 p0
+     p1 = d0^d1^d3, p2 = d0^d2^d3, p3 = d1^d2^d3,
+     p0 = parity over the other 7 bits
+   ============================================================ */
+
+static const uint8_t fec_encode_table[16] PROGMEM = {
+    0x00, 0x87, 0x99, 0x1E, 0xAA, 0x2D, 0x33, 0xB4,
+    0x4B, 0xCC, 0xD2, 0x55, 0xE1, 0x66, 0x78, 0xFF
+};
+
+// Nearest codeword for every received byte:
+// distance 0 → nibble, 1 → nibble | CORRECTED, 2 → INVALID
+static const uint8_t fec_decode_table[256] PROGMEM = {
+    0x00, 0x10, 0x10, 0xFF, 0x10, 0xFF, 0xFF, 0x11, 0x10, 0xFF, 0xFF, 0x18, 0xFF, 0x15, 0x13, 0xFF,
+    0x10, 0xFF, 0xFF, 0x16, 0xFF, 0x1B, 0x13, 0xFF, 0xFF, 0x12, 0x13, 0xFF, 0x13, 0xFF, 0x03, 0x13,
+    0x10, 0xFF, 0xFF, 0x16, 0xFF, 0x15, 0x1D, 0xFF, 0xFF, 0x15, 0x14, 0xFF, 0x15, 0x05, 0xFF, 0x15,
+    0xFF, 0x16, 0x16, 0x06, 0x17, 0xFF, 0xFF, 0x16, 0x1E, 0xFF, 0xFF, 0x16, 0xFF, 0x15, 0x13, 0xFF,
+    0x10, 0xFF, 0xFF, 0x18, 0xFF, 0x1B, 0x1D, 0xFF, 0xFF, 0x18, 0x18, 0x08, 0x19, 0xFF, 0xFF, 0x18,
+    0xFF, 0x1B, 0x1A, 0xFF, 0x1B, 0x0B, 0xFF, 0x1B, 0x1E, 0xFF, 0xFF, 0x18, 0xFF, 0x1B, 0x13, 0xFF,
+    0xFF, 0x1C, 0x1D, 0xFF, 0x1D, 0xFF, 0x0D, 0x1D, 0x1E, 0xFF, 0xFF, 0x18, 0xFF, 0x15, 0x1D, 0xFF,
+    0x1E, 0xFF, 0xFF, 0x16, 0xFF, 0x1B, 0x1D, 0xFF, 0x0E, 0x1E, 0x1E, 0xFF, 0x1E, 0xFF, 0xFF, 0x1F,
+    0x10, 0xFF, 0xFF, 0x11, 0xFF, 0x11, 0x11, 0x01, 0xFF, 0x12, 0x14, 0xFF, 0x19, 0xFF, 0xFF, 0x11,
+    0xFF, 0x12, 0x1A, 0xFF, 0x17, 0xFF, 0xFF, 0x11, 0x12, 0x02, 0xFF, 0x12, 0xFF, 0x12, 0x13, 0xFF,
+    0xFF, 0x1C, 0x14, 0xFF, 0x17, 0xFF, 0xFF, 0x11, 0x14, 0xFF, 0x04, 0x14, 0xFF, 0x15, 0x14, 0xFF,
+    0x17, 0xFF, 0xFF, 0x16, 0x07, 0x17, 0x17, 0xFF, 0xFF, 0x12, 0x14, 0xFF, 0x17, 0xFF, 0xFF, 0x1F,
+    0xFF, 0x1C, 0x1A, 0xFF, 0x19, 0xFF, 0xFF, 0x11, 0x19, 0xFF, 0xFF, 0x18, 0x09, 0x19, 0x19, 0xFF,
+    0x1A, 0xFF, 0x0A, 0x1A, 0xFF, 0x1B, 0x1A, 0xFF, 0xFF, 0x12, 0x1A, 0xFF, 0x19, 0xFF, 0xFF, 0x1F,
+    0x1C, 0x0C, 0xFF, 0x1C, 0xFF, 0x1C, 0x1D, 0xFF, 0xFF, 0x1C, 0x14, 0xFF, 0x19, 0xFF, 0xFF, 0x1F,
+    0xFF, 0x1C, 0x1A, 0xFF, 0x17, 0xFF, 0xFF, 0x1F, 0x1E, 0xFF, 0xFF, 0x1F, 0xFF, 0x1F, 0x1F, 0x0F
+};
+
+uint8_t butcom_fec_encode(uint8_t nibble) {
+    return pgm_read_byte(&fec_encode_table[nibble & 0x0F]);
+}
+
+uint8_t butcom_fec_decode(uint8_t code) {
+    return pgm_read_byte(&fec_decode_table[code]);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   ButComFec - Extended Hamming(8,4) per nibble
+   ------------------------------------------------------------
+   Every nibble becomes one code byte (minimum distance 4):
+   - single-bit errors are corrected
+   - double-bit errors are detected
+   Both directions are table lookups (16 + 256 bytes flash).
+   ============================================================ */
+
+// Decoder result flags
+#define BUTCOM_FEC_CORRECTED 0x10   // nibble in low 4 bits was repaired
+#define BUTCOM_FEC_INVALID   0xFF   // uncorrectable code byte
+
+uint8_t butcom_fec_encode(uint8_t nibble);   // low 4 bits → code byte
+uint8_t butcom_fec_decode(uint8_t code);     // nibble | flags, or BUTCOM_FEC_INVALID
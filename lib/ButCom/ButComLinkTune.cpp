@@ -0,0 +1,640 @@
+#include "ButComLinkTune.h"
+
+/* ============================================================
+   ButComLinkTune
+   ============================================================ */
+
+// Bit times tried, slowest first; the sweep starts below the base
+static const uint16_t tuneBitUs[BUTCOM_TUNE_STEPS] = {
+    800, 500, 300, 200, 150, 100, 70, 50
+};
+
+// PRBS-9 (x^9 + x^5 + 1), MSB first. The seed differs per step,
+// frame and direction, so a stale frame never matches.
+static uint16_t prbsSeed(uint8_t step, uint8_t seq, bool echo) {
+    uint16_t s = (uint16_t)(seq * 29u + step * 97u + (echo ? 0x0AAu : 0x155u)) & 0x1FF;
+    return s ? s : 1;
+}
+
+static uint8_t prbsNext(uint16_t& s) {
+    uint8_t b = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+        uint8_t bit = ((s >> 8) ^ (s >> 4)) & 1;
+        s = (uint16_t)(((s << 1) | bit) & 0x1FF);
+        b = (uint8_t)((b << 1) | bit);
+    }
+    return b;
+}
+
+static void prbsFill(uint8_t* p, uint8_t n, uint16_t seed) {
+    for (uint8_t i = 0; i < n; i++) p[i] = prbsNext(seed);
+}
+
+static bool prbsMatches(const uint8_t* p, uint8_t n, uint16_t seed) {
+    for (uint8_t i = 0; i < n; i++)
+        if (p[i] != prbsNext(seed)) return false;
+    return true;
+}
+
+static bool stepPassed(const ButComTuneStep& s) {
+    return s.sent     == BUTCOM_TUNE_FRAMES &&
+           s.received == BUTCOM_TUNE_FRAMES &&
+           s.echoed   == BUTCOM_TUNE_FRAMES;
+}
+
+ButComLinkTune::ButComLinkTune(ButComCore& bus)
+    : _bus(bus),
+      _onDone(nullptr),
+      _readProfile(nullptr),
+      _writeProfile(nullptr),
+      _profile(),
+      _profileValid(false),
+      _baseFec(false),
+      _fastestUs(BUTCOM_MIN_BIT_US),
+      _margin(1),
+      _state(IDLE),
+      _baseUs(0),
+      _resultUs(0),
+      _length(0),
+      _next(0),
+      _steps(0),
+      _repeated(false),
+      _ctlSent(false),
+      _ctlMsgId(0),
+      _seq(0),
+      _awaitEcho(false),
+      _lastEchoOk(false),
+      _retries(0),
+      _startMs(0),
+      _waitMs(0),
+      _waitForMs(0),
+      _rActive(false),
+      _rCommit(false),
+      _rStep(0xFF),
+      _rBaseUs(0),
+      _rFrames(0),
+      _rLength(0),
+      _rReceived(0),
+      _rPeerId(0),
+      _rEpoch(0),
+      _rStartMs(0),
+      _rForMs(0)
+{}
+
+/* ---- Timing (same on both sides) ---- */
+
+// TEST + ACK + ECHO + ACK, ~13 bit times per byte incl. the idle
+// gap, plus both turnaround slots; half of it again as slack
+uint32_t ButComLinkTune::echoWaitMs(uint16_t bitUs, uint8_t length) const {
+    uint32_t bytes = 2UL * (length + 5) + 2 * 5;
+    if (_bus.fecMode()) bytes *= 2;
+    uint32_t ms = ((bytes * 13 + 2 * BUTCOM_REPLY_SLOT_BITS) * bitUs) / 1000;
+    return ms + ms / 2 + 5;
+}
+
+// The responder starts its window when PROPOSE arrives, the initiator
+// once the ACK is back: one more round trip at the base bit time
+uint32_t ButComLinkTune::windowMs(uint16_t bitUs, uint8_t frames, uint8_t length,
+                                  uint16_t baseUs) const
+{
+    return (frames + 1UL) * echoWaitMs(bitUs, length) + echoWaitMs(baseUs, 0);
+}
+
+// The responder starts it when COMMIT arrives; the initiator sends
+// CONFIRM a switch guard after the ACK and may retry it until the
+// core gives up
+uint32_t ButComLinkTune::confirmWindowMs(uint16_t baseUs) const {
+    return echoWaitMs(baseUs, 6) + 1 + (2UL * baseUs) / 1000 +
+           (_bus.maxRetries() + 1UL) * _bus.ackTimeoutMs();
+}
+
+// The ACK is read before its stop bit ends, and the peer switches in
+// its callback after that: give it time before the first TEST
+uint32_t ButComLinkTune::switchGuardMs() const {
+    return 1 + (2UL * _baseUs) / 1000;
+}
+
+/* ---- Initiator ---- */
+
+bool ButComLinkTune::start() {
+    if (busy() || !_bus.hasRemoteId()) return false;
+
+    // PROPOSE and COMMIT carry 6 bytes, TEST frames use the largest
+    // payload both sides accept
+    uint8_t length = _bus.maxPayload();
+    if (length > BUTCOM_MAX_PAYLOAD) length = BUTCOM_MAX_PAYLOAD;
+    if (_bus.remoteMaxPayload() && length > _bus.remoteMaxPayload())
+        length = _bus.remoteMaxPayload();
+    if (length < 6) return false;
+
+    _baseUs   = _bus.bitTimeUs();
+    _resultUs = _baseUs;
+    _length   = length;
+    _steps    = 0;
+    _next     = 0;
+    _repeated = false;
+    while (_next < BUTCOM_TUNE_STEPS && tuneBitUs[_next] >= _baseUs) _next++;
+
+    propose();
+    return true;
+}
+
+void ButComLinkTune::propose() {
+    if (_next >= BUTCOM_TUNE_STEPS || tuneBitUs[_next] < _fastestUs) {
+        finish();
+        return;
+    }
+
+    ButComTuneStep& s = _step[_steps];
+    s.bitUs    = tuneBitUs[_next];
+    s.sent     = 0;
+    s.received = 0;
+    s.echoed   = 0;
+
+    _state   = PROPOSING;
+    _ctlSent = false;
+}
+
+// PROPOSE / COMMIT / CONFIRM go out with ACK request once no other frame
+// waits for its ACK (otherwise the core would not track it)
+void ButComLinkTune::sendControl(const uint8_t* payload, uint8_t length) {
+    _ctlMsgId = _bus.sendMessage(BUTCOM_MSG_TUNE, payload, length, true);
+    _ctlSent  = true;
+}
+
+void ButComLinkTune::sendTest() {
+    uint8_t payload[BUTCOM_MAX_PAYLOAD];
+    payload[0] = BUTCOM_TUNE_OP_TEST;
+    payload[1] = _steps;
+    payload[2] = _seq;
+    prbsFill(&payload[3], _length - 3, prbsSeed(_steps, _seq, false));
+    _bus.sendMessage(BUTCOM_MSG_TUNE, payload, _length, false);
+
+    _step[_steps].sent++;
+    _seq++;
+    _awaitEcho  = true;
+    _lastEchoOk = false;
+    _waitMs     = millis();
+}
+
+void ButComLinkTune::sendQuery() {
+    uint8_t payload[2] = { BUTCOM_TUNE_OP_QUERY, _steps };
+    _bus.sendMessage(BUTCOM_MSG_TUNE, payload, 2, false);
+
+    _waitMs    = millis();
+    _waitForMs = echoWaitMs(_baseUs, 3);
+}
+
+void ButComLinkTune::evaluate(uint8_t received) {
+    ButComTuneStep& s = _step[_steps];
+    s.received = received;
+
+    // Once more before giving up: one collision (a periodic HELLO)
+    // should not end the sweep
+    if (!stepPassed(s) && !_repeated) {
+        _repeated = true;
+        propose();
+        return;
+    }
+    _repeated = false;
+    _steps++;
+    _next++;
+
+    if (stepPassed(s) && _steps < BUTCOM_TUNE_STEPS)
+        propose();
+    else
+        finish();
+}
+
+void ButComLinkTune::finish() {
+    // The sweep stopped at the first failing step
+    uint8_t passed = 0;
+    while (passed < _steps && stepPassed(_step[passed])) passed++;
+
+    _resultUs = (passed > _margin) ? _step[passed - 1 - _margin].bitUs : _baseUs;
+
+    if (_resultUs == _baseUs) {
+        _state = DONE;
+        if (_onDone) _onDone(true, _resultUs);
+        return;
+    }
+    _state   = COMMITTING;
+    _ctlSent = false;
+}
+
+void ButComLinkTune::fail() {
+    _bus.setBitTimeUs(_baseUs);
+    _resultUs = _baseUs;
+    _state    = FAILED;
+    if (_onDone) _onDone(false, _baseUs);
+}
+
+uint32_t ButComLinkTune::loop() {
+    uint32_t now = millis();
+
+    switch (_state) {
+        case PROPOSING:
+        case COMMITTING: {
+            if (!_ctlSent) {
+                if (_bus.txPending()) break;
+
+                uint16_t us = (_state == PROPOSING) ? _step[_steps].bitUs : _resultUs;
+                if (_state == PROPOSING) {
+                    uint8_t payload[6] = { BUTCOM_TUNE_OP_PROPOSE, _steps,
+                                           (uint8_t)us, (uint8_t)(us >> 8),
+                                           BUTCOM_TUNE_FRAMES, _length };
+                    sendControl(payload, 6);
+                    _startMs = millis();
+                } else {
+                    uint16_t epoch = _profile.epoch + 1;
+                    uint8_t payload[6] = { BUTCOM_TUNE_OP_COMMIT,
+                                           (uint8_t)us, (uint8_t)(us >> 8),
+                                           (uint8_t)epoch, (uint8_t)(epoch >> 8),
+                                           _bus.id() };
+                    sendControl(payload, 6);
+                }
+                break;
+            }
+            if (_bus.txPending()) break;
+
+            // The core gave up without an ACK (the peer stays at or
+            // falls back to the base bit time)
+            if (_state == COMMITTING) {
+                fail();
+            } else {
+                // The peer may have switched all the same: let its
+                // window run out, then ask (the step counts as failed)
+                _lastEchoOk = false;
+                _waitMs     = _startMs;
+                _waitForMs  = windowMs(_step[_steps].bitUs, BUTCOM_TUNE_FRAMES, _length, _baseUs);
+                _state      = SETTLING;
+            }
+            break;
+        }
+
+        case CONFIRMING: {
+            if (!_ctlSent) {
+                if ((now - _startMs) <= switchGuardMs() || _bus.txPending()) break;
+
+                uint16_t epoch = _profile.epoch + 1;
+                uint8_t payload[3] = { BUTCOM_TUNE_OP_CONFIRM,
+                                       (uint8_t)epoch, (uint8_t)(epoch >> 8) };
+                sendControl(payload, 3);
+                break;
+            }
+            if (!_bus.txPending()) fail();
+            break;
+        }
+
+        case RESUMING:
+            if ((now - _waitMs) <= _waitForMs) break;
+            if (_retries >= BUTCOM_TUNE_RESUME_PROBES) {
+                fallBack();
+                break;
+            }
+            _retries++;
+            sendResume(false);
+
+            // Both sides probe after a reboot; the id spreads them apart
+            _waitMs    = millis();
+            _waitForMs = echoWaitMs(_bus.bitTimeUs(), 5) + (_bus.id() & 7) * 3;
+            break;
+
+        case TESTING:
+            if (_seq == 0 && (now - _startMs) <= switchGuardMs()) break;
+            if (_awaitEcho) {
+                if ((now - _waitMs) <= echoWaitMs(_step[_steps].bitUs, _length)) break;
+                _awaitEcho = false;                         // lost
+            }
+            if (_seq < BUTCOM_TUNE_FRAMES) {
+                // One frame per call so bus.loop() receives the ECHO
+                sendTest();
+                break;
+            }
+
+            // The responder lingers one echo wait after the last TEST
+            // it got, or runs its whole window if it missed it
+            _waitMs    = _lastEchoOk ? now : _startMs;
+            _waitForMs = _lastEchoOk
+                ? echoWaitMs(_step[_steps].bitUs, _length) + 1
+                : windowMs(_step[_steps].bitUs, BUTCOM_TUNE_FRAMES, _length, _baseUs);
+            _state     = SETTLING;
+            break;
+
+        case SETTLING:
+            if ((now - _waitMs) <= _waitForMs) break;
+            _bus.setBitTimeUs(_baseUs);
+            _retries = 0;
+            sendQuery();
+            _state = QUERYING;
+            break;
+
+        case QUERYING:
+            if ((now - _waitMs) <= _waitForMs) break;
+            if (_retries >= 3) {
+                fail();
+                break;
+            }
+            _retries++;
+            sendQuery();
+            break;
+
+        default:
+            break;
+    }
+
+    uint32_t next = respondLoop();
+    uint32_t t    = BUTCOM_NO_DEADLINE;
+    now = millis();
+
+    switch (_state) {
+        case PROPOSING:
+        case COMMITTING:
+            // The bus' retry deadline covers the wait for the ACK
+            t = _bus.txPending() ? BUTCOM_NO_DEADLINE : 0;
+            break;
+
+        case CONFIRMING:
+            if (_bus.txPending())
+                t = BUTCOM_NO_DEADLINE;
+            else
+                t = _ctlSent ? 0 : ButComCore::msUntil(_startMs, switchGuardMs(), now);
+            break;
+
+        case TESTING:
+            if (_seq == 0)
+                t = ButComCore::msUntil(_startMs, switchGuardMs(), now);
+            else if (_awaitEcho)
+                t = ButComCore::msUntil(_waitMs, echoWaitMs(_step[_steps].bitUs, _length), now);
+            else
+                t = 0;
+            break;
+
+        case RESUMING:
+        case SETTLING:
+        case QUERYING:
+            t = ButComCore::msUntil(_waitMs, _waitForMs, now);
+            break;
+
+        default:
+            break;
+    }
+    return (t < next) ? t : next;
+}
+
+/* ---- Stored profile ---- */
+
+bool ButComLinkTune::resume() {
+    uint8_t d[BUTCOM_PROFILE_SIZE];
+    if (busy() || !_readProfile || !_readProfile(d, BUTCOM_PROFILE_SIZE))
+        return false;
+
+    // Erased EEPROM / flash reads as 0xFF, fails version and CRC
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < BUTCOM_PROFILE_SIZE - 1; i++)
+        crc = ButComCore::crc8_update(crc, d[i]);
+    if (d[0] != 1 || crc != d[BUTCOM_PROFILE_SIZE - 1])
+        return false;
+
+    _profile.peerId = d[1];
+    _profile.bitUs  = (uint16_t)d[2] | ((uint16_t)d[3] << 8);
+    _profile.baseUs = (uint16_t)d[4] | ((uint16_t)d[5] << 8);
+    _profile.flags  = d[6];
+    _profile.epoch  = (uint16_t)d[7] | ((uint16_t)d[8] << 8);
+    _profileValid   = true;
+
+    _baseFec = _bus.fecMode();
+    _bus.setFecMode(_profile.flags & BUTCOM_PROFILE_FEC);
+    _bus.setBitTimeUs(_profile.bitUs);
+
+    _state     = RESUMING;
+    _retries   = 0;
+    _waitMs    = millis();
+    // Not right away: leave the wire to a HELLO from begin()
+    _waitForMs = echoWaitMs(_profile.bitUs, 5) + (_bus.id() & 7) * 3;
+    return true;
+}
+
+void ButComLinkTune::saveProfile(uint8_t peerId, uint16_t bitUs, uint16_t baseUs,
+                                 uint16_t epoch)
+{
+    _profile.peerId = peerId;
+    _profile.bitUs  = bitUs;
+    _profile.baseUs = baseUs;
+    _profile.flags  = _bus.fecMode() ? BUTCOM_PROFILE_FEC : 0;
+    _profile.epoch  = epoch;
+    _profileValid   = true;
+    if (!_writeProfile) return;
+
+    uint8_t d[BUTCOM_PROFILE_SIZE] = {
+        1, peerId,
+        (uint8_t)bitUs,  (uint8_t)(bitUs >> 8),
+        (uint8_t)baseUs, (uint8_t)(baseUs >> 8),
+        _profile.flags,
+        (uint8_t)epoch,  (uint8_t)(epoch >> 8),
+        0
+    };
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < BUTCOM_PROFILE_SIZE - 1; i++)
+        crc = ButComCore::crc8_update(crc, d[i]);
+    d[BUTCOM_PROFILE_SIZE - 1] = crc;
+    _writeProfile(d, BUTCOM_PROFILE_SIZE);
+}
+
+// Epoch 0 = no profile, never matches
+void ButComLinkTune::sendResume(bool reply) {
+    uint16_t epoch = _profileValid ? _profile.epoch : 0;
+    uint8_t payload[5] = { BUTCOM_TUNE_OP_RESUME,
+                           (uint8_t)epoch, (uint8_t)(epoch >> 8),
+                           (uint8_t)(reply ? 1 : 0), _bus.id() };
+    _bus.sendMessage(BUTCOM_MSG_TUNE, payload, 5, false);
+}
+
+// Back to the bit time the profile was negotiated from; the stale
+// profile is no longer offered until the next COMMIT
+void ButComLinkTune::fallBack() {
+    _bus.setBitTimeUs(_profile.baseUs);
+    _bus.setFecMode(_baseFec);
+    _profileValid = false;
+    _state        = IDLE;
+    if (_onDone) _onDone(false, _profile.baseUs);
+}
+
+/* ---- Responder ---- */
+
+uint32_t ButComLinkTune::respondLoop() {
+    if (!_rActive) return BUTCOM_NO_DEADLINE;
+
+    uint32_t now = millis();
+    if ((now - _rStartMs) > _rForMs) {
+        _bus.setBitTimeUs(_rBaseUs);
+        _rActive = false;
+        if (_rCommit) {
+            _rCommit = false;
+            if (_onDone) _onDone(false, _rBaseUs);
+        }
+        return BUTCOM_NO_DEADLINE;
+    }
+    return ButComCore::msUntil(_rStartMs, _rForMs, now);
+}
+
+bool ButComLinkTune::handleMessage(uint8_t msgId,
+                                   uint8_t type,
+                                   const uint8_t* payload,
+                                   uint8_t length)
+{
+    // ---- Committed bit time: a frame arrived at it ----
+    if (_rCommit) {
+        _rCommit = false;
+        _rActive = false;
+        saveProfile(_rPeerId, _bus.bitTimeUs(), _rBaseUs, _rEpoch);
+        if (_onDone) _onDone(true, _bus.bitTimeUs());
+    }
+
+    // ---- ACK of PROPOSE / COMMIT: switch after the peer did ----
+    if (type == BUTCOM_MSG_ACK) {
+        if (!_ctlSent || msgId != _ctlMsgId) return false;
+
+        if (_state == PROPOSING) {
+            _bus.setBitTimeUs(_step[_steps].bitUs);
+            _seq        = 0;
+            _awaitEcho  = false;
+            _lastEchoOk = false;
+            _startMs    = millis();
+            _state      = TESTING;
+        } else if (_state == COMMITTING) {
+            _bus.setBitTimeUs(_resultUs);
+            _startMs = millis();
+            _state   = CONFIRMING;
+        } else if (_state == CONFIRMING) {
+            saveProfile(_bus.remoteId(), _resultUs, _baseUs, _profile.epoch + 1);
+            _state = DONE;
+            if (_onDone) _onDone(true, _resultUs);
+        }
+        _ctlSent = false;
+        return false;
+    }
+
+    if (type != BUTCOM_MSG_TUNE || length < 1)
+        return false;
+
+    switch (payload[0]) {
+        case BUTCOM_TUNE_OP_PROPOSE: {
+            if (length < 6 || busy()) break;
+
+            // The ACK already went out at the base bit time
+            if (!_rActive) _rBaseUs = _bus.bitTimeUs();
+            uint16_t us = (uint16_t)payload[2] | ((uint16_t)payload[3] << 8);
+
+            _rStep     = payload[1];
+            _rFrames   = payload[4];
+            _rLength   = payload[5];
+            _rReceived = 0;
+            _rActive   = true;
+            _rStartMs  = millis();
+            _rForMs    = windowMs(us, _rFrames, _rLength, _rBaseUs);
+            _bus.setBitTimeUs(us);
+            break;
+        }
+
+        case BUTCOM_TUNE_OP_TEST: {
+            if (length < 4 || !_rActive || payload[1] != _rStep) break;
+
+            uint8_t seq = payload[2];
+            if (length == _rLength &&
+                prbsMatches(&payload[3], length - 3, prbsSeed(_rStep, seq, false)))
+                _rReceived++;
+
+            uint8_t echo[BUTCOM_MAX_PAYLOAD];
+            uint8_t n = (length > BUTCOM_MAX_PAYLOAD) ? BUTCOM_MAX_PAYLOAD : length;
+            echo[0] = BUTCOM_TUNE_OP_ECHO;
+            echo[1] = _rStep;
+            echo[2] = seq;
+            prbsFill(&echo[3], n - 3, prbsSeed(_rStep, seq, true));
+            _bus.sendMessage(BUTCOM_MSG_TUNE, echo, n, false);
+
+            // Last one: stay for the initiator's ACK, then go back
+            if ((uint8_t)(seq + 1) >= _rFrames) {
+                _rStartMs = millis();
+                _rForMs   = echoWaitMs(_bus.bitTimeUs(), _rLength);
+            }
+            break;
+        }
+
+        case BUTCOM_TUNE_OP_ECHO: {
+            if (_state != TESTING || !_awaitEcho || length < 4) break;
+            if (payload[1] != _steps || payload[2] != (uint8_t)(_seq - 1)) break;
+
+            _awaitEcho  = false;
+            _lastEchoOk = length == _length &&
+                          prbsMatches(&payload[3], length - 3, prbsSeed(_steps, payload[2], true));
+            if (_lastEchoOk) _step[_steps].echoed++;
+            break;
+        }
+
+        case BUTCOM_TUNE_OP_QUERY: {
+            if (length < 2) break;
+
+            // The initiator is back at the base bit time
+            if (_rActive) {
+                _bus.setBitTimeUs(_rBaseUs);
+                _rActive = false;
+            }
+            uint8_t report[3] = { BUTCOM_TUNE_OP_REPORT, payload[1],
+                                  (uint8_t)(payload[1] == _rStep ? _rReceived : 0) };
+            _bus.sendMessage(BUTCOM_MSG_TUNE, report, 3, false);
+            break;
+        }
+
+        case BUTCOM_TUNE_OP_REPORT:
+            if (_state != QUERYING || length < 3 || payload[1] != _steps) break;
+            evaluate(payload[2]);
+            break;
+
+        case BUTCOM_TUNE_OP_COMMIT: {
+            if (length < 6 || busy()) break;
+
+            // The ACK already went out at the base bit time; the
+            // profile is saved once a frame arrives at the new one
+            if (!_rActive) _rBaseUs = _bus.bitTimeUs();
+            uint16_t us = (uint16_t)payload[1] | ((uint16_t)payload[2] << 8);
+
+            _rStep    = 0xFF;
+            _rEpoch   = (uint16_t)payload[3] | ((uint16_t)payload[4] << 8);
+            _rPeerId  = payload[5];
+            _rCommit  = true;
+            _rActive  = true;
+            _rStartMs = millis();
+            _rForMs   = confirmWindowMs(_rBaseUs);
+            _bus.setBitTimeUs(us);
+            break;
+        }
+
+        case BUTCOM_TUNE_OP_CONFIRM:
+            break;                      // confirmed the commit above
+
+        case BUTCOM_TUNE_OP_RESUME: {
+            if (length < 5) break;
+
+            uint16_t epoch = (uint16_t)payload[1] | ((uint16_t)payload[2] << 8);
+            bool     same  = _profileValid && epoch == _profile.epoch &&
+                             payload[4] == _profile.peerId;
+
+            // Answer every probe, so a peer that rebooted alone confirms
+            // (or learns that this side has another profile)
+            if (!payload[3]) sendResume(true);
+            if (_state != RESUMING) break;
+
+            if (same) {
+                _resultUs = _profile.bitUs;
+                _state    = DONE;
+                if (_onDone) _onDone(true, _resultUs);
+            } else {
+                fallBack();
+            }
+            break;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,212 @@
+#pragma once
+#include "ButCom.h"
+
+/* ============================================================
+   ButComLinkTune - Link training: fastest reliable bit time
+   ------------------------------------------------------------
+   One side (the initiator) calls start() after the HELLO
+   handshake; both sides feed their frames through
+   handleMessage() and call loop(). For each bit time of a
+   descending table, shorter than the current (base) one:
+   - PROPOSE at the base bit time; once it is ACKed both
+     sides switch to the test bit time
+   - TEST / ECHO ping-pong filled with PRBS-9: the peer checks
+     every TEST and answers with an ECHO of its own pattern,
+     so both directions are counted
+   - both sides fall back to the base bit time; QUERY →
+     REPORT brings the peer's count
+   A step passes when every frame arrived intact in both
+   directions; a failing step is repeated once. The sweep
+   stops at the first step that fails twice; the
+   result is the fastest passing bit time, setMargin() steps
+   slower. COMMIT switches both sides to it; the initiator
+   then sends CONFIRM at the new bit time. The responder
+   keeps the new bit time once any frame arrives at it and
+   falls back to the base bit time if none does within the
+   initiator's retry budget, so a lost COMMIT ACK leaves
+   both sides at the base.
+
+   A bit error makes a frame fail its CRC-8, so every lost
+   frame counts as (at least) one error. No loss over N test
+   bits puts the bit error rate below ~3/N (95 % confidence).
+   Keep other traffic off the bus while the sweep runs.
+
+   With a profile store both sides save the agreed link
+   (peer id, bit time, FEC, epoch) once COMMIT is confirmed. resume() starts
+   at the saved bit time after a reboot; a RESUME exchange
+   with the same epoch and peer id confirms it. A mismatch
+   or no answer falls back to the base bit time, and the
+   initiator's start() negotiates again.
+   ============================================================ */
+
+// Opcodes (payload[0] of a BUTCOM_MSG_TUNE frame)
+#define BUTCOM_TUNE_OP_PROPOSE 1   // [op, step, bitUs(2), frames, length]
+#define BUTCOM_TUNE_OP_TEST    2   // [op, step, seq, prbs...]
+#define BUTCOM_TUNE_OP_ECHO    3   // [op, step, seq, prbs...]
+#define BUTCOM_TUNE_OP_QUERY   4   // [op, step]
+#define BUTCOM_TUNE_OP_REPORT  5   // [op, step, received]
+#define BUTCOM_TUNE_OP_COMMIT  6   // [op, bitUs(2), epoch(2), id]
+#define BUTCOM_TUNE_OP_RESUME  7   // [op, epoch(2), reply, id]
+#define BUTCOM_TUNE_OP_CONFIRM 8   // [op, epoch(2)], at the committed bit time
+
+// TEST frames per step (and as many ECHOs back)
+#ifndef BUTCOM_TUNE_FRAMES
+#define BUTCOM_TUNE_FRAMES 8
+#endif
+
+// Entries of the bit time table (ButComLinkTune.cpp)
+#define BUTCOM_TUNE_STEPS 8
+
+// RESUME probes sent after resume() before falling back
+#ifndef BUTCOM_TUNE_RESUME_PROBES
+#define BUTCOM_TUNE_RESUME_PROBES 4
+#endif
+
+// Stored link profile: version, peerId, bitUs(2), baseUs(2), flags,
+// epoch(2), CRC-8
+#define BUTCOM_PROFILE_SIZE 10
+#define BUTCOM_PROFILE_FEC  0x01     // flags: FEC mode on
+
+// Called on both sides when the sweep ends: ok with the agreed bit
+// time, or false with the base bit time still in use
+typedef void (*ButComLinkTuneDoneFn)(bool ok, uint16_t bitUs);
+
+// Non-volatile storage of the profile (EEPROM, NVS, a flash page):
+// BUTCOM_PROFILE_SIZE bytes; false if nothing could be read / written
+typedef bool (*ButComProfileReadFn)(uint8_t* data, uint8_t length);
+typedef bool (*ButComProfileWriteFn)(const uint8_t* data, uint8_t length);
+
+struct ButComLinkProfile {
+    uint8_t  peerId;
+    uint16_t bitUs;         // agreed
+    uint16_t baseUs;        // fallback, the bit time the sweep started at
+    uint8_t  flags;         // BUTCOM_PROFILE_*
+    uint16_t epoch;         // counts COMMITs, the same on both sides
+};
+
+struct ButComTuneStep {
+    uint16_t bitUs;
+    uint8_t  sent;          // TEST frames sent
+    uint8_t  received;      // TEST frames the peer got intact
+    uint8_t  echoed;        // ECHO frames back intact
+};
+
+class ButComLinkTune {
+public:
+    enum State {
+        IDLE,
+        RESUMING,
+        PROPOSING,
+        TESTING,
+        SETTLING,
+        QUERYING,
+        COMMITTING,
+        CONFIRMING,
+        DONE,
+        FAILED
+    };
+
+    explicit ButComLinkTune(ButComCore& bus);
+
+    // Shortest bit time tried (default BUTCOM_MIN_BIT_US)
+    void setFastestBitUs(uint16_t us)            { _fastestUs = us; }
+    // Table steps to back off from the fastest passing bit time (default 1)
+    void setMargin(uint8_t steps)                { _margin = steps; }
+    void setDoneHandler(ButComLinkTuneDoneFn fn) { _onDone = fn; }
+    void setProfileStore(ButComProfileReadFn read, ButComProfileWriteFn write)
+        { _readProfile = read; _writeProfile = write; }
+
+    // Both sides, before bus.begin(): switches to the stored profile and
+    // confirms it with the peer (RESUMING). false if none is stored.
+    // The done handler reports the outcome; on a fallback the state
+    // goes back to IDLE.
+    bool resume();
+    bool                     hasProfile() const { return _profileValid; }
+    const ButComLinkProfile& profile() const    { return _profile; }
+
+    // Initiator: sweeps down from the current bit time. false while a
+    // sweep runs, before the peer's HELLO was received or if either
+    // side's maxPayload() is below 6 (PROPOSE / COMMIT size).
+    bool start();
+
+    // Sends the next frame, handles timeouts and the peer's test
+    // window. Call after bus.loop(), on both sides. Returns the ms
+    // until it needs to run again.
+    uint32_t loop();
+
+    // Feed every frame from the ButCom callback through here (ACKs
+    // included). Returns true if the frame belonged to the tune layer.
+    bool handleMessage(uint8_t msgId,
+                       uint8_t type,
+                       const uint8_t* payload,
+                       uint8_t length);
+
+    State    state() const      { return _state; }
+    bool     busy() const       { return _state != IDLE && _state != DONE && _state != FAILED; }
+
+    // Agreed bit time once DONE
+    uint16_t bitTimeUs() const  { return _resultUs; }
+
+    // Initiator: the steps tried, fastest last
+    uint8_t               steps() const          { return _steps; }
+    const ButComTuneStep& step(uint8_t i) const  { return _step[i]; }
+
+private:
+    void     propose();
+    void     sendTest();
+    void     sendQuery();
+    void     evaluate(uint8_t received);
+    void     finish();
+    void     fail();
+    void     sendControl(const uint8_t* payload, uint8_t length);
+    uint32_t switchGuardMs() const;
+    uint32_t echoWaitMs(uint16_t bitUs, uint8_t length) const;
+    uint32_t windowMs(uint16_t bitUs, uint8_t frames, uint8_t length, uint16_t baseUs) const;
+    uint32_t confirmWindowMs(uint16_t baseUs) const;
+    uint32_t respondLoop();
+    void     sendResume(bool reply);
+    void     fallBack();
+    void     saveProfile(uint8_t peerId, uint16_t bitUs, uint16_t baseUs, uint16_t epoch);
+
+    ButComCore&          _bus;
+    ButComLinkTuneDoneFn _onDone;
+    ButComProfileReadFn  _readProfile;
+    ButComProfileWriteFn _writeProfile;
+    ButComLinkProfile    _profile;
+    bool                 _profileValid;
+    bool                 _baseFec;      // FEC mode before resume()
+    uint16_t             _fastestUs;
+    uint8_t              _margin;
+
+    // Initiator
+    State          _state;
+    uint16_t       _baseUs;
+    uint16_t       _resultUs;
+    uint8_t        _length;         // TEST payload bytes
+    uint8_t        _next;           // next table index to try
+    ButComTuneStep _step[BUTCOM_TUNE_STEPS];
+    uint8_t        _steps;
+    bool           _repeated;       // this step failed once already
+    bool           _ctlSent;        // PROPOSE / COMMIT / CONFIRM on the bus
+    uint8_t        _ctlMsgId;
+    uint8_t        _seq;            // TEST frames sent this step
+    bool           _awaitEcho;
+    bool           _lastEchoOk;
+    uint8_t        _retries;
+    uint32_t       _startMs;        // test window start
+    uint32_t       _waitMs;         // TEST / QUERY sent, settling started
+    uint32_t       _waitForMs;
+
+    // Responder
+    bool     _rActive;              // at the test or committed bit time
+    bool     _rCommit;              // committed, not yet confirmed
+    uint8_t  _rStep;
+    uint16_t _rBaseUs;
+    uint8_t  _rFrames;
+    uint8_t  _rLength;
+    uint8_t  _rReceived;
+    uint8_t  _rPeerId;              // of the pending COMMIT
+    uint16_t _rEpoch;
+    uint32_t _rStartMs;
+    uint32_t _rForMs;
+};
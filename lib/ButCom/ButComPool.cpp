@@ -0,0 +1,39 @@
+#include "ButComPool.h"
+
+ButComFramePool::ButComFramePool(uint8_t* storage, uint8_t slotSize, uint8_t slots)
+    : _storage(storage),
+      _slotSize(slotSize),
+      _slots(slots > 32 ? 32 : slots),
+      _inUse(0),
+      _peak(0),
+      _exhausted(0),
+      _used(0)
+{}
+
+uint8_t* ButComFramePool::acquire() {
+    for (uint8_t i = 0; i < _slots; i++) {
+        uint32_t bit = (uint32_t)1 << i;
+        if (_used & bit) continue;
+
+        _used |= bit;
+        if (++_inUse > _peak) _peak = _inUse;
+        return _storage + (uint16_t)i * _slotSize;
+    }
+
+    if (_exhausted != 0xFFFF) _exhausted++;
+    return nullptr;
+}
+
+void ButComFramePool::release(const uint8_t* p) {
+    if (!p || p < _storage) return;
+
+    size_t off = (size_t)(p - _storage);
+    if (off >= (size_t)_slots * _slotSize) return;     // not from this pool
+
+    uint8_t  i   = (uint8_t)(off / _slotSize);
+    uint32_t bit = (uint32_t)1 << i;
+    if (!(_used & bit)) return;
+
+    _used &= ~bit;
+    _inUse--;
+}
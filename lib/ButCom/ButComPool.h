@@ -0,0 +1,52 @@
+#pragma once
+#include <Arduino.h>
+
+/* ============================================================
+   ButComFramePool - Shared frame slots
+   ------------------------------------------------------------
+   One statically allocated block of equal slots. A slot holds
+   a frame body (TYPE MSGID PAYLOAD CRC) and is owned by exactly
+   one user at a time:
+   - RX assembly, from a valid LEN until the callback returns
+   - the application, if it keeps the payload (keepRxPayload())
+   - the TX retry path, from send() until ACK or give-up
+   Several ButComCore instances can share one pool; peak()
+   tells how many slots a deployment really needs.
+   ============================================================ */
+class ButComFramePool {
+public:
+    // storage: slots * slotSize bytes, slots <= 32
+    ButComFramePool(uint8_t* storage, uint8_t slotSize, uint8_t slots);
+
+    uint8_t* acquire();                    // free slot, nullptr if exhausted
+    void     release(const uint8_t* p);    // any pointer into a slot; nullptr is ignored
+
+    uint8_t  slotSize() const  { return _slotSize; }
+    uint8_t  slots() const     { return _slots; }
+    uint8_t  inUse() const     { return _inUse; }
+    uint8_t  peak() const      { return _peak; }        // highest inUse() since resetPeak()
+    uint16_t exhausted() const { return _exhausted; }   // acquire() calls that failed
+    void     resetPeak()       { _peak = _inUse; _exhausted = 0; }
+
+private:
+    uint8_t* _storage;
+    uint8_t  _slotSize;
+    uint8_t  _slots;
+    uint8_t  _inUse;
+    uint8_t  _peak;
+    uint16_t _exhausted;
+    uint32_t _used;                        // bit i = slot i taken
+};
+
+// Pool with its own storage, slots sized for MaxPayload
+template <uint8_t MaxPayload, uint8_t Slots>
+class ButComFramePoolStatic : public ButComFramePool {
+    static_assert(Slots >= 1 && Slots <= 32, "1..32 slots");
+    static_assert(MaxPayload <= 252, "LEN (payload + 3) must fit into one byte");
+
+public:
+    ButComFramePoolStatic() : ButComFramePool(_store, MaxPayload + 3, Slots) {}
+
+private:
+    uint8_t _store[Slots * (MaxPayload + 3)];
+};
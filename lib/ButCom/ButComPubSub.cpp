@@ -0,0 +1,163 @@
+#include "ButComPubSub.h"
+
+/* ============================================================
+   ButComPubSub
+   ============================================================ */
+
+ButComPubSub::ButComPubSub(ButComCore& bus)
+    : _bus(bus),
+      _callback(nullptr),
+      _localMask(0),
+      _remoteMask(0),
+      _pushMask(0),
+      _announceDue(false),
+      _peerNonce(0),
+      _usable(bus.maxPayload() >= 5)
+{
+    for (uint8_t i = 0; i < BUTCOM_PUBSUB_MAX_TOPICS; i++) {
+        _cache[i].valid  = false;
+        _cache[i].length = 0;
+    }
+}
+
+void ButComPubSub::subscribe(uint8_t topic) {
+    uint32_t m = bit(topic);
+    if (!m || (_localMask & m)) return;
+
+    _localMask |= m;
+    _announceDue = true;
+}
+
+void ButComPubSub::unsubscribe(uint8_t topic) {
+    uint32_t m = bit(topic);
+    if (!(_localMask & m)) return;
+
+    _localMask &= ~m;
+    _announceDue = true;
+}
+
+uint32_t ButComPubSub::loop() {
+    if (!_usable || (!_announceDue && !_pushMask)) return BUTCOM_NO_DEADLINE;
+    if (_bus.txPending()) return BUTCOM_NO_DEADLINE;    // the ACK wakes us
+
+    if (_announceDue) {
+        _announceDue = false;
+        announce();
+    } else {
+        uint8_t t = 0;
+        while (!(_pushMask & bit(t))) t++;
+        _pushMask &= ~bit(t);
+        sendTopic(t, true);
+    }
+
+    // More to send: the next call checks the retry slot again
+    return (_announceDue || _pushMask) ? 0 : BUTCOM_NO_DEADLINE;
+}
+
+void ButComPubSub::announce() {
+    uint8_t payload[5] = {
+        BUTCOM_PUBSUB_OP_SUBSCRIBE,
+        (uint8_t)(_localMask),
+        (uint8_t)(_localMask >> 8),
+        (uint8_t)(_localMask >> 16),
+        (uint8_t)(_localMask >> 24)
+    };
+    _bus.sendMessage(BUTCOM_MSG_PUBSUB, payload, 5, true);
+}
+
+bool ButComPubSub::publish(uint8_t topic,
+                           const uint8_t* value,
+                           uint8_t length,
+                           bool requestAck)
+{
+    if (!_usable || !bit(topic)) return false;
+    if (length > BUTCOM_PUBSUB_MAX_VALUE)
+        length = BUTCOM_PUBSUB_MAX_VALUE;
+    if (length > _bus.maxPayload() - 2)
+        length = _bus.maxPayload() - 2;
+
+    CachedTopic& c = _cache[topic];
+    c.valid  = true;
+    c.length = length;
+    for (uint8_t i = 0; i < length; i++)
+        c.value[i] = value[i];
+
+    // Nobody listening → keep it in the cache only
+    if (!peerSubscribed(topic)) return false;
+
+    sendTopic(topic, requestAck);
+    _pushMask &= ~bit(topic);           // the peer has the latest value now
+    return true;
+}
+
+void ButComPubSub::sendTopic(uint8_t topic, bool requestAck) {
+    const CachedTopic& c = _cache[topic];
+
+    uint8_t payload[2 + BUTCOM_PUBSUB_MAX_VALUE];
+    payload[0] = BUTCOM_PUBSUB_OP_PUBLISH;
+    payload[1] = topic;
+    for (uint8_t i = 0; i < c.length; i++)
+        payload[2 + i] = c.value[i];
+
+    _bus.sendMessage(BUTCOM_MSG_PUBSUB, payload, 2 + c.length, requestAck);
+}
+
+bool ButComPubSub::handleMessage(uint8_t msgId,
+                                 uint8_t type,
+                                 const uint8_t* payload,
+                                 uint8_t length)
+{
+    (void)msgId;
+    if (!_usable) return false;
+
+    // A new peer or a rebooted one (new boot nonce) does not know our
+    // subscriptions, and a rebooted one has lost its own until it
+    // announces again. A periodic HELLO of the same boot changes
+    // nothing. A peer without a nonce (0) gets them on every HELLO.
+    if (type == BUTCOM_MSG_HELLO) {
+        uint16_t nonce = _bus.remoteBootNonce();
+        if (_peerNonce && nonce != _peerNonce) {
+            _remoteMask = 0;
+            _pushMask   = 0;
+        }
+        if (_localMask && (!_peerNonce || nonce != _peerNonce))
+            _announceDue = true;
+        _peerNonce = nonce;
+        return false;   // HELLO stays visible to the application
+    }
+
+    if (type != BUTCOM_MSG_PUBSUB || length < 1)
+        return false;
+
+    switch (payload[0]) {
+        case BUTCOM_PUBSUB_OP_SUBSCRIBE: {
+            if (length < 5) break;
+
+            uint32_t mask = (uint32_t)payload[1]
+                          | ((uint32_t)payload[2] << 8)
+                          | ((uint32_t)payload[3] << 16)
+                          | ((uint32_t)payload[4] << 24);
+            uint32_t added = mask & ~_remoteMask;
+            _remoteMask = mask;
+
+            // Late subscriber → loop() pushes the cached values
+            _pushMask &= mask;
+            for (uint8_t t = 0; t < BUTCOM_PUBSUB_MAX_TOPICS; t++) {
+                if ((added & bit(t)) && _cache[t].valid)
+                    _pushMask |= bit(t);
+            }
+            break;
+        }
+
+        case BUTCOM_PUBSUB_OP_PUBLISH: {
+            if (length < 2) break;
+
+            uint8_t topic = payload[1];
+            if (isSubscribed(topic) && _callback)
+                _callback(topic, payload + 2, length - 2);
+            break;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "ButCom.h"
+
+/* ============================================================
+   ButComPubSub - Topic publish/subscribe on top of ButCom
+   ------------------------------------------------------------
+   - Compact numeric topic ids (0..BUTCOM_PUBSUB_MAX_TOPICS-1)
+   - Subscriptions are announced to the peer as a bit mask
+   - publish() only puts a topic on the wire if the peer
+     has subscribed to it
+   - Latest-value cache per topic: a late subscriber gets
+     the current value as soon as its SUBSCRIBE arrives
+   - SUBSCRIBE and the cached values go out from loop(), one
+     ACKed frame at a time: the core tracks a single retry
+   - A peer reboot (new boot nonce in its HELLO) clears its
+     subscriptions until it announces them again
+   ============================================================ */
+
+// Number of topics (max 32, one bit each in the subscription mask)
+#ifndef BUTCOM_PUBSUB_MAX_TOPICS
+#define BUTCOM_PUBSUB_MAX_TOPICS 8
+#endif
+
+// Bytes cached per topic (a PUBLISH frame carries 2 header bytes)
+#ifndef BUTCOM_PUBSUB_MAX_VALUE
+#define BUTCOM_PUBSUB_MAX_VALUE 4
+#endif
+
+#if BUTCOM_PUBSUB_MAX_TOPICS > 32
+#error "BUTCOM_PUBSUB_MAX_TOPICS must be <= 32"
+#endif
+#if BUTCOM_PUBSUB_MAX_VALUE > (BUTCOM_MAX_PAYLOAD - 2)
+#error "BUTCOM_PUBSUB_MAX_VALUE does not fit in a ButCom payload"
+#endif
+
+// Opcodes (payload[0] of a BUTCOM_MSG_PUBSUB frame)
+#define BUTCOM_PUBSUB_OP_SUBSCRIBE 1   // payload[1..4] = mask (LSB first)
+#define BUTCOM_PUBSUB_OP_PUBLISH   2   // payload[1] = topic, payload[2..] = value
+
+// Called for every received update of a locally subscribed topic
+typedef void (*ButComTopicCallback)(
+    uint8_t topic,
+    const uint8_t* value,
+    uint8_t length
+);
+
+class ButComPubSub {
+public:
+    // A bus whose maxPayload() cannot carry SUBSCRIBE (5 bytes) leaves
+    // the layer inactive (usable() false): nothing is sent or handled
+    explicit ButComPubSub(ButComCore& bus);
+    bool usable() const { return _usable; }
+
+    void setCallback(ButComTopicCallback cb) { _callback = cb; }
+
+    // Local subscriptions. Changes are announced to the peer by the
+    // next loop() (several changes in one SUBSCRIBE).
+    void subscribe(uint8_t topic);
+    void unsubscribe(uint8_t topic);
+
+    // Store value in the cache and send it if the peer subscribed.
+    // The value is cut to BUTCOM_PUBSUB_MAX_VALUE and to what a frame
+    // of this bus holds (maxPayload() - 2). Returns true if a frame
+    // was sent.
+    bool publish(uint8_t topic,
+                 const uint8_t* value,
+                 uint8_t length,
+                 bool requestAck = false);
+
+    // Sends a due SUBSCRIBE or one cached value the peer has not got
+    // yet, once no frame waits for its ACK. Call after bus.loop().
+    // Returns the ms until it needs to run again.
+    uint32_t loop();
+
+    // Feed every frame from the ButCom callback through here.
+    // Returns true if the frame belonged to the pub/sub layer.
+    bool handleMessage(uint8_t msgId,
+                       uint8_t type,
+                       const uint8_t* payload,
+                       uint8_t length);
+
+    bool isSubscribed(uint8_t topic) const   { return (bit(topic) & _localMask) != 0; }
+    bool peerSubscribed(uint8_t topic) const { return (bit(topic) & _remoteMask) != 0; }
+
+private:
+    struct CachedTopic {
+        bool    valid;
+        uint8_t length;
+        uint8_t value[BUTCOM_PUBSUB_MAX_VALUE];
+    };
+
+    static uint32_t bit(uint8_t topic) {
+        return (topic < BUTCOM_PUBSUB_MAX_TOPICS) ? ((uint32_t)1 << topic) : 0;
+    }
+
+    void announce();
+    void sendTopic(uint8_t topic, bool requestAck);
+
+    ButComCore&         _bus;
+    ButComTopicCallback _callback;
+
+    uint32_t    _localMask;
+    uint32_t    _remoteMask;
+    uint32_t    _pushMask;      // cached topics still to send to a new subscriber
+    bool        _announceDue;   // SUBSCRIBE still to send
+    uint16_t    _peerNonce;     // peer's boot nonce, 0 until its first HELLO
+    bool        _usable;        // bus frames hold SUBSCRIBE
+    CachedTopic _cache[BUTCOM_PUBSUB_MAX_TOPICS];
+};
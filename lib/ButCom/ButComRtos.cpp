@@ -0,0 +1,131 @@
+#include "ButComRtos.h"
+
+#if BUTCOM_RTOS
+
+/* ============================================================
+   ButComRtos
+   ============================================================ */
+
+ButComRtos::ButComRtos(ButComCore& bus)
+    : _bus(bus),
+      _task(nullptr),
+      _txQueue(nullptr),
+      _rxQueue(nullptr),
+      _rxNotifyTask(nullptr),
+      _rxNotifyBits(0),
+      _txSent(0),
+      _rxDropped(0),
+      _rxTooLong(0)
+{}
+
+bool ButComRtos::begin(UBaseType_t priority, BaseType_t core, uint32_t stackSize) {
+    if (_task) return true;
+
+    _txQueue = xQueueCreate(BUTCOM_RTOS_TX_QUEUE, sizeof(TxItem));
+    _rxQueue = xQueueCreate(BUTCOM_RTOS_RX_QUEUE, sizeof(ButComRtosFrame));
+    if (!_txQueue || !_rxQueue) return false;
+
+    return xTaskCreatePinnedToCore(taskEntry, "ButCom", stackSize, this,
+                                   priority, &_task, core) == pdPASS;
+}
+
+ButComSendStatus ButComRtos::trySend(const uint8_t* payload, uint8_t length,
+                                     bool requestAck, TickType_t wait)
+{
+    return trySendMessage(BUTCOM_MSG_DATA, payload, length, requestAck, wait);
+}
+
+ButComSendStatus ButComRtos::trySendMessage(uint8_t type, const uint8_t* payload,
+                                            uint8_t length, bool requestAck,
+                                            TickType_t wait)
+{
+    if (length > BUTCOM_MAX_PAYLOAD || length > _bus.maxPayload())
+        return BUTCOM_SEND_TOO_LONG;
+    if (!_task) return BUTCOM_SEND_FULL;
+
+    TxItem item;
+    item.type       = type;
+    item.length     = length;
+    item.requestAck = requestAck;
+    if (length) memcpy(item.payload, payload, length);
+
+    if (xQueueSend(_txQueue, &item, wait) != pdPASS) return BUTCOM_SEND_FULL;
+    xTaskNotifyGive(_task);
+    return BUTCOM_SEND_QUEUED;
+}
+
+bool ButComRtos::receive(ButComRtosFrame& out, TickType_t wait) {
+    if (!_rxQueue) return false;
+    return xQueueReceive(_rxQueue, &out, wait) == pdPASS;
+}
+
+void ButComRtos::setReceiveNotify(TaskHandle_t task, uint32_t bits) {
+    _rxNotifyTask = task;
+    _rxNotifyBits = bits;
+}
+
+bool ButComRtos::handleMessage(uint8_t msgId,
+                               uint8_t type,
+                               const uint8_t* payload,
+                               uint8_t length)
+{
+    if (type == BUTCOM_MSG_ACK || !_rxQueue) return false;
+    if (length > BUTCOM_MAX_PAYLOAD) {
+        _rxTooLong = _rxTooLong + 1;
+        return false;
+    }
+
+    ButComRtosFrame f;
+    f.msgId  = msgId;
+    f.type   = type;
+    f.length = length;
+    if (length) memcpy(f.payload, payload, length);
+
+    // Never block the bus on a slow consumer
+    if (xQueueSend(_rxQueue, &f, 0) != pdPASS) {
+        _rxDropped = _rxDropped + 1;
+        return false;
+    }
+    if (_rxNotifyTask) xTaskNotify(_rxNotifyTask, _rxNotifyBits, eSetBits);
+    return true;
+}
+
+void BUTCOM_ISR_ATTR ButComRtos::wakeFromIsr() {
+    if (!_task) return;
+
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(_task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+void ButComRtos::taskEntry(void* self) {
+    static_cast<ButComRtos*>(self)->run();
+}
+
+void ButComRtos::run() {
+    TxItem item;
+
+    for (;;) {
+        uint32_t wait = _bus.loop();
+
+        // One queued frame at a time, each after the previous one's ACK
+        if (!_bus.txPending() && xQueueReceive(_txQueue, &item, 0) == pdPASS) {
+            _bus.sendMessage(item.type, item.payload, item.length, item.requestAck);
+            _txSent = _txSent + 1;
+            continue;
+        }
+
+        // Polling receiver: a start bit is only seen inside loop()
+        if (wait == 0) {
+            taskYIELD();
+            continue;
+        }
+
+        TickType_t ticks = (wait == BUTCOM_NO_DEADLINE)
+            ? portMAX_DELAY
+            : (TickType_t)((wait + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+        ulTaskNotifyTake(pdTRUE, ticks);
+    }
+}
+
+#endif
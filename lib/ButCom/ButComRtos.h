@@ -0,0 +1,149 @@
+#pragma once
+#include "ButCom.h"
+
+/* ============================================================
+   ButComRtos - FreeRTOS service task (ESP32)
+   ------------------------------------------------------------
+   ButComCore is not thread-safe. With ButComRtos a single
+   service task owns the bus; every other task only talks to
+   FreeRTOS queues:
+
+     send()      any task: copies the frame into the TX queue
+                 and wakes the service task
+     receive()   any task: next received frame from the RX
+                 queue; setReceiveNotify() additionally sets
+                 notification bits of one task per frame
+
+   The service task runs bus.loop() and sleeps on its task
+   notification until the deadline loop() returns, a TX
+   request or - with the interrupt receiver - a received
+   byte wakes it. Queued frames go out in order, each after
+   the previous one is ACKed.
+
+   Give the service task the highest priority of the
+   application: bit-banging must not be preempted. With the
+   polling receiver it never sleeps; pin it to the other core
+   of a dual-core ESP32 or use setAsyncRx().
+   ============================================================ */
+
+// 1 = compile ButComRtos (default on ESP-IDF / Arduino-ESP32)
+#ifndef BUTCOM_RTOS
+#ifdef ESP_PLATFORM
+#define BUTCOM_RTOS 1
+#else
+#define BUTCOM_RTOS 0
+#endif
+#endif
+
+#if BUTCOM_RTOS
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+#ifndef BUTCOM_RTOS_PRIORITY
+#define BUTCOM_RTOS_PRIORITY 5
+#endif
+
+#ifndef BUTCOM_RTOS_CORE
+#define BUTCOM_RTOS_CORE tskNO_AFFINITY
+#endif
+
+#ifndef BUTCOM_RTOS_STACK
+#define BUTCOM_RTOS_STACK 3072         // bytes (ESP-IDF counts bytes)
+#endif
+
+// Frames waiting in each direction
+#ifndef BUTCOM_RTOS_TX_QUEUE
+#define BUTCOM_RTOS_TX_QUEUE 8
+#endif
+
+#ifndef BUTCOM_RTOS_RX_QUEUE
+#define BUTCOM_RTOS_RX_QUEUE 8
+#endif
+
+// One received frame, as handed to the RX queue
+struct ButComRtosFrame {
+    uint8_t msgId;
+    uint8_t type;
+    uint8_t length;
+    uint8_t payload[BUTCOM_MAX_PAYLOAD];
+};
+
+class ButComRtos {
+public:
+    explicit ButComRtos(ButComCore& bus);
+
+    // Creates the queues and the service task. Call after bus.begin()
+    // (and setAsyncRx()); afterwards only the service task may use bus.
+    bool begin(UBaseType_t priority  = BUTCOM_RTOS_PRIORITY,
+               BaseType_t  core      = BUTCOM_RTOS_CORE,
+               uint32_t    stackSize = BUTCOM_RTOS_STACK);
+
+    // Any task. Queues the frame (payload copied) and waits up to
+    // `wait` ticks for room. BUTCOM_SEND_QUEUED once it is in the TX
+    // queue, TOO_LONG above BUTCOM_MAX_PAYLOAD or bus.maxPayload()
+    // (nothing is queued), FULL if the queue stayed full or begin()
+    // has not run.
+    ButComSendStatus trySend(const uint8_t* payload, uint8_t length,
+                             bool requestAck, TickType_t wait = 0);
+    ButComSendStatus trySendMessage(uint8_t type, const uint8_t* payload,
+                                    uint8_t length, bool requestAck,
+                                    TickType_t wait = 0);
+
+    // As above, true if queued
+    bool send(const uint8_t* payload, uint8_t length, bool requestAck,
+              TickType_t wait = 0)
+    { return trySend(payload, length, requestAck, wait) == BUTCOM_SEND_QUEUED; }
+    bool sendMessage(uint8_t type, const uint8_t* payload, uint8_t length,
+                     bool requestAck, TickType_t wait = 0)
+    { return trySendMessage(type, payload, length, requestAck, wait) == BUTCOM_SEND_QUEUED; }
+
+    // Any task. Next received frame, waiting up to `wait` ticks.
+    bool receive(ButComRtosFrame& out, TickType_t wait = portMAX_DELAY);
+
+    // Also set `bits` in the notification value of `task` for every
+    // queued frame (xTaskNotifyWait()); nullptr = off
+    void setReceiveNotify(TaskHandle_t task, uint32_t bits);
+
+    // Feed every frame from the ButCom callback through here (runs in
+    // the service task). Queues everything but ACKs; true if queued.
+    // Frames longer than BUTCOM_MAX_PAYLOAD (a ButComSized bus) do
+    // not fit ButComRtosFrame and are dropped (rxTooLong()).
+    bool handleMessage(uint8_t msgId,
+                       uint8_t type,
+                       const uint8_t* payload,
+                       uint8_t length);
+
+    // Call from the setAsyncRx() notify function (ISR context)
+    void wakeFromIsr();
+
+    TaskHandle_t task() const      { return _task; }
+
+    // Service task counters
+    uint32_t framesSent() const    { return _txSent; }
+    uint32_t rxDropped() const     { return _rxDropped; }   // RX queue full
+    uint32_t rxTooLong() const     { return _rxTooLong; }   // > BUTCOM_MAX_PAYLOAD
+
+private:
+    struct TxItem {
+        uint8_t type;
+        uint8_t length;
+        bool    requestAck;
+        uint8_t payload[BUTCOM_MAX_PAYLOAD];
+    };
+
+    static void taskEntry(void* self);
+    void run();
+
+    ButComCore&   _bus;
+    TaskHandle_t  _task;
+    QueueHandle_t _txQueue;
+    QueueHandle_t _rxQueue;
+    TaskHandle_t  _rxNotifyTask;
+    uint32_t      _rxNotifyBits;
+
+    volatile uint32_t _txSent;
+    volatile uint32_t _rxDropped;
+    volatile uint32_t _rxTooLong;
+};
+#endif
@@ -0,0 +1,181 @@
+#include "ButComStateSync.h"
+
+/* ============================================================
+   ButComStateSync
+   ============================================================ */
+
+ButComStateSync::ButComStateSync(ButComCore& bus,
+                                 uint8_t* localRegs,  uint8_t localCount,
+                                 uint8_t* remoteRegs, uint8_t remoteCount)
+    : _bus(bus),
+      _callback(nullptr),
+      _local(localRegs),
+      _localCount(localCount > BUTCOM_STATE_MAX_REGS ? BUTCOM_STATE_MAX_REGS : localCount),
+      _remote(remoteRegs),
+      _remoteCount(remoteCount),
+      _anyDirty(false),
+      _txVersion(0),
+      _rxVersion(0),
+      _rxVersionValid(false),
+      _remoteInSync(false),
+      _usable(bus.maxPayload() >= 4),
+      _digestIntervalMs(2000),
+      _lastDigestMs(0)
+{
+    // Initial full push so the peer starts from our current state
+    markAllDirty();
+}
+
+void ButComStateSync::markAllDirty() {
+    for (uint8_t i = 0; i < sizeof(_dirty); i++)
+        _dirty[i] = 0;
+    for (uint8_t i = 0; i < _localCount; i++)
+        setDirty(i);
+    _anyDirty = (_localCount > 0);
+}
+
+void ButComStateSync::set(uint8_t index, uint8_t value) {
+    if (index >= _localCount) return;
+    if (_local[index] == value) return;   // unchanged → no traffic
+
+    _local[index] = value;
+    setDirty(index);
+    _anyDirty = true;
+}
+
+uint8_t ButComStateSync::get(uint8_t index) const {
+    return (index < _localCount) ? _local[index] : 0;
+}
+
+uint8_t ButComStateSync::remote(uint8_t index) const {
+    return (index < _remoteCount) ? _remote[index] : 0;
+}
+
+uint8_t ButComStateSync::blockCrc(const uint8_t* regs, uint8_t count) {
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < count; i++)
+        crc = ButCom::crc8_update(crc, regs[i]);
+    return crc;
+}
+
+uint32_t ButComStateSync::loop() {
+    if (!_usable) return BUTCOM_NO_DEADLINE;
+
+    if (_anyDirty) {
+        flushDeltas();
+        _lastDigestMs = millis();
+        if (_anyDirty) return 0;            // more than one frame's worth
+    }
+    else if (_digestIntervalMs &&
+             (millis() - _lastDigestMs) > _digestIntervalMs)
+    {
+        sendDigest();
+    }
+
+    if (!_digestIntervalMs) return BUTCOM_NO_DEADLINE;
+    return ButComCore::msUntil(_lastDigestMs, _digestIntervalMs, millis());
+}
+
+void ButComStateSync::flushDeltas() {
+    // Pairs that fit a frame of this bus: a cut-off DELTA would lose
+    // registers whose dirty bits are already cleared
+    uint8_t payload[2 + 2 * BUTCOM_STATE_PAIRS_PER_FRAME];
+    uint8_t pairs = (uint8_t)((_bus.maxPayload() - 2) / 2);
+    if (pairs > BUTCOM_STATE_PAIRS_PER_FRAME) pairs = BUTCOM_STATE_PAIRS_PER_FRAME;
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < _localCount && n < pairs; i++) {
+        if (!isDirty(i)) continue;
+
+        payload[2 + 2 * n]     = i;
+        payload[2 + 2 * n + 1] = _local[i];
+        clearDirty(i);
+        n++;
+    }
+
+    // Anything left goes out on the next loop()
+    _anyDirty = false;
+    for (uint8_t i = 0; i < sizeof(_dirty); i++)
+        if (_dirty[i]) _anyDirty = true;
+
+    if (n == 0) return;
+
+    payload[0] = BUTCOM_STATE_OP_DELTA;
+    payload[1] = ++_txVersion;
+    _bus.sendMessage(BUTCOM_MSG_STATE, payload, 2 + 2 * n, true);
+}
+
+void ButComStateSync::sendDigest() {
+    uint8_t payload[4] = {
+        BUTCOM_STATE_OP_DIGEST,
+        _txVersion,
+        _localCount,
+        blockCrc(_local, _localCount)
+    };
+    _bus.sendMessage(BUTCOM_MSG_STATE, payload, 4, false);
+    _lastDigestMs = millis();
+}
+
+void ButComStateSync::requestResync() {
+    uint8_t payload[1] = { BUTCOM_STATE_OP_RESYNC };
+    _bus.sendMessage(BUTCOM_MSG_STATE, payload, 1, true);
+    _remoteInSync = false;
+}
+
+bool ButComStateSync::handleMessage(uint8_t msgId,
+                                    uint8_t type,
+                                    const uint8_t* payload,
+                                    uint8_t length)
+{
+    (void)msgId;
+
+    if (!_usable || type != BUTCOM_MSG_STATE || length < 1)
+        return false;
+
+    switch (payload[0]) {
+        case BUTCOM_STATE_OP_DELTA: {
+            if (length < 2) break;
+
+            uint8_t version = payload[1];
+            uint8_t expected = _rxVersionValid ? (uint8_t)(_rxVersion + 1) : 1;
+            bool    gap      = (version != expected);
+
+            // Values are absolute, so applying after a gap is safe;
+            // the resync only fills in what was lost.
+            for (uint8_t p = 2; p + 1 < length; p += 2) {
+                uint8_t idx = payload[p];
+                uint8_t val = payload[p + 1];
+                if (idx >= _remoteCount || _remote[idx] == val) continue;
+
+                _remote[idx] = val;
+                if (_callback) _callback(idx, val);
+            }
+
+            _rxVersion      = version;
+            _rxVersionValid = true;
+
+            if (gap) requestResync();
+            break;
+        }
+
+        case BUTCOM_STATE_OP_DIGEST: {
+            if (length < 4) break;
+
+            // Block sizes differ → only the version can be compared
+            bool ok = _rxVersionValid &&
+                      payload[1] == _rxVersion &&
+                      (payload[2] != _remoteCount ||
+                       payload[3] == blockCrc(_remote, _remoteCount));
+
+            _remoteInSync = ok;
+            if (!ok) requestResync();
+            break;
+        }
+
+        case BUTCOM_STATE_OP_RESYNC:
+            markAllDirty();
+            break;
+    }
+
+    return true;
+}
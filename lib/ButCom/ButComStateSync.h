@@ -0,0 +1,99 @@
+#pragma once
+#include "ButCom.h"
+
+/* ============================================================
+   ButComStateSync - Replicated register blocks
+   ------------------------------------------------------------
+   Each side owns a LOCAL block of 8-bit registers and keeps
+   a REMOTE mirror of the peer's block.
+   - Only changed registers are sent, as packed (index, value)
+     pairs, several per frame
+   - Every DELTA frame carries a version number; a gap makes
+     the receiver request a resync
+   - A periodic DIGEST (version + CRC-8 of the block) catches
+     anything else; a full resend only happens on mismatch
+   ============================================================ */
+
+// Max registers per block (sizes the dirty bit map)
+#ifndef BUTCOM_STATE_MAX_REGS
+#define BUTCOM_STATE_MAX_REGS 32
+#endif
+
+// Opcodes (payload[0] of a BUTCOM_MSG_STATE frame)
+#define BUTCOM_STATE_OP_DELTA  1   // [op, version, idx, val, idx, val, ...]
+#define BUTCOM_STATE_OP_DIGEST 2   // [op, version, count, crc8]
+#define BUTCOM_STATE_OP_RESYNC 3   // [op]  → peer marks its whole block dirty
+
+// Most (index, value) pairs per DELTA frame; a smaller bus sends
+// (maxPayload() - 2) / 2
+#define BUTCOM_STATE_PAIRS_PER_FRAME ((BUTCOM_MAX_PAYLOAD - 2) / 2)
+
+// Called when a register of the REMOTE mirror changes
+typedef void (*ButComRegisterCallback)(uint8_t index, uint8_t value);
+
+class ButComStateSync {
+public:
+    // local/remote arrays are owned by the application. A bus whose
+    // maxPayload() cannot carry DIGEST or one DELTA pair (4 bytes)
+    // leaves the layer inactive (usable() false).
+    ButComStateSync(ButComCore& bus,
+                    uint8_t* localRegs,  uint8_t localCount,
+                    uint8_t* remoteRegs, uint8_t remoteCount);
+    bool usable() const { return _usable; }
+
+    void setCallback(ButComRegisterCallback cb) { _callback = cb; }
+    void setDigestInterval(uint32_t ms)         { _digestIntervalMs = ms; }
+
+    // Local block
+    void    set(uint8_t index, uint8_t value);
+    uint8_t get(uint8_t index) const;
+
+    // Remote mirror
+    uint8_t remote(uint8_t index) const;
+    bool    inSync() const { return _remoteInSync; }
+
+    // Flush dirty registers / send digest. Call after bus.loop().
+    // Returns the ms until the next digest or flush is due.
+    uint32_t loop();
+
+    // Feed every frame from the ButCom callback through here.
+    // Returns true if the frame belonged to the state layer.
+    bool handleMessage(uint8_t msgId,
+                       uint8_t type,
+                       const uint8_t* payload,
+                       uint8_t length);
+
+    // Mark the complete local block for resend
+    void markAllDirty();
+
+private:
+    bool isDirty(uint8_t i) const { return _dirty[i >> 3] & (1 << (i & 7)); }
+    void setDirty(uint8_t i)      { _dirty[i >> 3] |=  (uint8_t)(1 << (i & 7)); }
+    void clearDirty(uint8_t i)    { _dirty[i >> 3] &= (uint8_t)~(1 << (i & 7)); }
+
+    void flushDeltas();
+    void sendDigest();
+    void requestResync();
+
+    static uint8_t blockCrc(const uint8_t* regs, uint8_t count);
+
+    ButComCore&            _bus;
+    ButComRegisterCallback _callback;
+
+    uint8_t* _local;
+    uint8_t  _localCount;
+    uint8_t* _remote;
+    uint8_t  _remoteCount;
+
+    uint8_t  _dirty[(BUTCOM_STATE_MAX_REGS + 7) / 8];
+    bool     _anyDirty;
+
+    uint8_t  _txVersion;        // version of the last DELTA we sent
+    uint8_t  _rxVersion;        // version of the last DELTA we applied
+    bool     _rxVersionValid;
+    bool     _remoteInSync;
+    bool     _usable;           // bus frames hold DIGEST / one pair
+
+    uint32_t _digestIntervalMs;
+    uint32_t _lastDigestMs;
+};
@@ -0,0 +1,150 @@
+#include "ButComTimeSync.h"
+
+/* ============================================================
+   ButComTimeSync
+   ============================================================ */
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v);
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0]
+         | ((uint32_t)p[1] << 8)
+         | ((uint32_t)p[2] << 16)
+         | ((uint32_t)p[3] << 24);
+}
+
+ButComTimeSync::ButComTimeSync(ButComCore& bus)
+    : _bus(bus),
+      _usable(bus.maxPayload() >= 11),
+      _intervalMs(10000),       // one exchange every 10s
+      _lastRequestMs(0),
+      _seq(0),
+      _reqOpen(false),
+      _reqT1(0),
+      _prevValid(false),
+      _prevSeq(0),
+      _prevT1(0), _prevT2(0), _prevT4(0),
+      _respValid(false),
+      _respSeq(0),
+      _respT3(0),
+      _samples(0),
+      _offsetUs(0),
+      _driftPpb(0),
+      _delayUs(0),
+      _sampleLocalUs(0)
+{}
+
+uint32_t ButComTimeSync::loop() {
+    if (!_usable || !_intervalMs) return BUTCOM_NO_DEADLINE;
+
+    // First exchanges back-to-back until the piggybacked t3 gives a sample
+    uint32_t interval = valid() ? _intervalMs : _intervalMs / 8;
+
+    if ((millis() - _lastRequestMs) > interval)
+        sendRequest();
+
+    return ButComCore::msUntil(_lastRequestMs, interval, millis());
+}
+
+void ButComTimeSync::sendRequest() {
+    uint8_t payload[2] = { BUTCOM_TIME_OP_REQUEST, ++_seq };
+    _bus.sendMessage(BUTCOM_MSG_TIME, payload, 2, false);
+
+    _reqT1         = _bus.lastTxFrameUs();
+    _reqOpen       = true;
+    _lastRequestMs = millis();
+}
+
+uint32_t ButComTimeSync::toPeerMicros(uint32_t localUs) const {
+    int32_t elapsed = (int32_t)(localUs - _sampleLocalUs);
+    int32_t drift   = (int32_t)(((int64_t)elapsed * _driftPpb) / 1000000000);
+    return localUs + (uint32_t)(_offsetUs + drift);
+}
+
+void ButComTimeSync::addSample(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4) {
+    // Unsigned differences stay correct across the micros() wrap
+    int32_t a = (int32_t)(t2 - t1);
+    int32_t b = (int32_t)(t3 - t4);
+    int32_t offset = a / 2 + b / 2;
+    int32_t delay  = (int32_t)(t4 - t1) - (int32_t)(t3 - t2);
+
+    if (_samples > 0) {
+        int32_t elapsed = (int32_t)(t1 - _sampleLocalUs);
+        if (elapsed > 0) {
+            int32_t step = offset - _offsetUs;
+            int32_t ppb  = (int32_t)(((int64_t)step * 1000000000) / elapsed);
+
+            // EWMA (1/4) once there is a previous drift value
+            _driftPpb = (_samples == 1) ? ppb : _driftPpb + (ppb - _driftPpb) / 4;
+        }
+    }
+
+    _offsetUs      = offset;
+    _delayUs       = (delay > 0) ? (uint32_t)delay : 0;
+    _sampleLocalUs = t1;
+    if (_samples < 0xFFFF) _samples++;
+}
+
+bool ButComTimeSync::handleMessage(uint8_t msgId,
+                                   uint8_t type,
+                                   const uint8_t* payload,
+                                   uint8_t length)
+{
+    (void)msgId;
+
+    if (!_usable || type != BUTCOM_MSG_TIME || length < 1)
+        return false;
+
+    switch (payload[0]) {
+        case BUTCOM_TIME_OP_REQUEST: {
+            if (length < 2) break;
+
+            // t2 = start bit of the REQUEST we are handling right now
+            uint32_t t2 = _bus.lastRxFrameUs();
+
+            uint8_t resp[11];
+            resp[0] = BUTCOM_TIME_OP_RESPONSE;
+            resp[1] = payload[1];
+            put32(&resp[2], t2);
+
+            // Only hand out t3 for the directly preceding exchange;
+            // otherwise prevSeq = seq, which never matches on the requester.
+            bool chained = _respValid && _respSeq == (uint8_t)(payload[1] - 1);
+            resp[6] = chained ? _respSeq : payload[1];
+            put32(&resp[7], chained ? _respT3 : 0);
+
+            _bus.sendMessage(BUTCOM_MSG_TIME, resp, 11, false);
+
+            _respSeq   = payload[1];
+            _respT3    = _bus.lastTxFrameUs();
+            _respValid = true;
+            break;
+        }
+
+        case BUTCOM_TIME_OP_RESPONSE: {
+            if (length < 11 || !_reqOpen || payload[1] != _seq) break;
+
+            uint32_t t4 = _bus.lastRxFrameUs();
+            uint32_t t2 = get32(&payload[2]);
+
+            // Previous exchange completes with its piggybacked t3
+            if (_prevValid && payload[6] == _prevSeq)
+                addSample(_prevT1, _prevT2, get32(&payload[7]), _prevT4);
+
+            _prevSeq   = _seq;
+            _prevT1    = _reqT1;
+            _prevT2    = t2;
+            _prevT4    = t4;
+            _prevValid = true;
+            _reqOpen   = false;
+            break;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "ButCom.h"
+
+/* ============================================================
+   ButComTimeSync - Peer clock offset and drift estimation
+   ------------------------------------------------------------
+   NTP-style exchange with four timestamps:
+     t1  requester: start bit of REQUEST sent
+     t2  responder: start bit of REQUEST received
+     t3  responder: start bit of RESPONSE sent
+     t4  requester: start bit of RESPONSE received
+   All timestamps are micros() captured by ButComPhy at the
+   start-bit edge, so frame length and loop() latency do not
+   add jitter.
+
+   t3 is only known after the RESPONSE went out, so it is
+   carried in the NEXT response (piggyback). Two frames per
+   exchange, one sample per exchange after the first.
+
+     offset = ((t2 - t1) + (t3 - t4)) / 2     peer - local
+     delay  = (t4 - t1) - (t3 - t2)
+   ============================================================ */
+
+// Opcodes (payload[0] of a BUTCOM_MSG_TIME frame)
+#define BUTCOM_TIME_OP_REQUEST  1   // [op, seq]
+#define BUTCOM_TIME_OP_RESPONSE 2   // [op, seq, t2(4), prevSeq, prevT3(4)]
+
+class ButComTimeSync {
+public:
+    // Both sides send or receive the 11-byte RESPONSE; on a bus with a
+    // smaller maxPayload() the layer stays inactive (usable() false)
+    explicit ButComTimeSync(ButComCore& bus);
+    bool usable() const { return _usable; }
+
+    // Exchange interval in ms. 0 = only answer the peer's requests.
+    void setInterval(uint32_t ms) { _intervalMs = ms; }
+
+    // Sends a REQUEST when the interval expired. Call after bus.loop().
+    // Returns the ms until the next REQUEST is due.
+    uint32_t loop();
+
+    // Feed every frame from the ButCom callback through here.
+    // Returns true if the frame belonged to the time layer.
+    bool handleMessage(uint8_t msgId,
+                       uint8_t type,
+                       const uint8_t* payload,
+                       uint8_t length);
+
+    // ---- Results (valid() == true after the first full exchange) ----
+    bool     valid() const       { return _samples > 0; }
+    int32_t  offsetUs() const    { return _offsetUs; }      // peer - local at last sample
+    int32_t  driftPpb() const    { return _driftPpb; }      // peer clock rate - local, ppb
+    uint32_t roundTripUs() const { return _delayUs; }
+    uint16_t samples() const     { return _samples; }
+
+    // Peer's micros() at the given local micros(), drift-corrected
+    uint32_t toPeerMicros(uint32_t localUs) const;
+
+private:
+    void sendRequest();
+    void addSample(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4);
+
+    ButComCore& _bus;
+    bool     _usable;           // bus frames hold a RESPONSE
+    uint32_t _intervalMs;
+    uint32_t _lastRequestMs;
+
+    // Requester: exchange waiting for its t3
+    uint8_t  _seq;
+    bool     _reqOpen;          // t1 of _seq recorded, RESPONSE outstanding
+    uint32_t _reqT1;
+    bool     _prevValid;
+    uint8_t  _prevSeq;
+    uint32_t _prevT1, _prevT2, _prevT4;
+
+    // Responder: t3 of our last RESPONSE (sent with the next one)
+    bool     _respValid;
+    uint8_t  _respSeq;
+    uint32_t _respT3;
+
+    // Estimate
+    uint16_t _samples;
+    int32_t  _offsetUs;
+    int32_t  _driftPpb;
+    uint32_t _delayUs;
+    uint32_t _sampleLocalUs;    // local t1 of the last sample
+};
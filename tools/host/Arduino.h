@@ -0,0 +1,52 @@
+#pragma once
+
+/* ============================================================
+   Arduino API shim for host builds (Linux)
+   ------------------------------------------------------------
+   Just enough of the Arduino core for lib/ButCom to compile
+   and run inside ButComSim. Every call is routed to the
+   SimNode that is currently executing and costs virtual time
+   on that node's clock (see SimCosts in ButComSim.h).
+
+   Types follow 32-bit MCUs: micros()/millis() are uint32_t
+   and wrap like on the real targets.
+   ============================================================ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define PROGMEM
+#define pgm_read_byte(addr)  (*(const uint8_t*)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+
+#define digitalPinToInterrupt(p) (p)
+
+typedef uint8_t byte;
+
+void     pinMode(uint8_t pin, uint8_t mode);
+void     digitalWrite(uint8_t pin, uint8_t value);
+int      digitalRead(uint8_t pin);
+
+uint32_t micros();
+uint32_t millis();
+void     delayMicroseconds(unsigned int us);
+void     delay(uint32_t ms);
+void     yield();
+
+void     attachInterrupt(uint8_t interruptNum, void (*isr)(void), int mode);
+void     detachInterrupt(uint8_t interruptNum);
+void     noInterrupts();
+void     interrupts();
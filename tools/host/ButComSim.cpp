@@ -0,0 +1,491 @@
+#include "ButComSim.h"
+#include "Arduino.h"
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+/* ============================================================
+   SimCosts
+   ============================================================ */
+
+SimCosts SimCosts::esp32c3() {
+    SimCosts c;
+    c.digitalReadNs  = 150;
+    c.digitalWriteNs = 150;
+    c.pinModeNs      = 2000;     // goes through the GPIO matrix config
+    c.microsNs       = 120;
+    c.millisNs       = 150;
+    c.loopNs         = 500;
+    return c;
+}
+
+SimCosts SimCosts::attiny85() {
+    SimCosts c;
+    c.digitalReadNs  = 3000;
+    c.digitalWriteNs = 3500;
+    c.pinModeNs      = 3500;
+    c.microsNs       = 4000;
+    c.millisNs       = 2000;
+    c.loopNs         = 1000;
+    return c;
+}
+
+/* ============================================================
+   SimWire
+   ============================================================ */
+
+SimWire::SimWire(bool externalPullup)
+    : _externalPullup(externalPullup),
+      _lowDrivers(0),
+      _highDrivers(0),
+      _pullups(0),
+      _glitchRatePerNs(0),
+      _glitchNs(0),
+      _rng(1),
+      _glitchStart(0),
+      _glitchEnd(0),
+      _edges(0),
+      _contentions(0)
+{}
+
+void SimWire::setNoise(double bitErrorRate, uint32_t glitchNs, uint32_t seed) {
+    _glitchNs        = glitchNs ? glitchNs : 1;
+    _glitchRatePerNs = (bitErrorRate > 0) ? bitErrorRate / _glitchNs : 0;
+    _rng             = seed ? seed : 1;
+    _glitchStart     = 0;
+    _glitchEnd       = 0;
+}
+
+void SimWire::nextGlitch() {
+    // xorshift64* → uniform (0,1] → exponential inter-arrival time
+    _rng ^= _rng >> 12;
+    _rng ^= _rng << 25;
+    _rng ^= _rng >> 27;
+    uint64_t r = _rng * 2685821657736338717ULL;
+    double   u = ((r >> 11) + 1) * (1.0 / 9007199254740992.0);
+
+    uint64_t gap = (uint64_t)(-log(u) / _glitchRatePerNs);
+    _glitchStart = _glitchEnd + gap;
+    _glitchEnd   = _glitchStart + _glitchNs;
+}
+
+bool SimWire::drivenLevel() const {
+    // Wired-AND: any LOW driver wins; otherwise pulled up (or floating HIGH)
+    return _lowDrivers == 0;
+}
+
+bool SimWire::level(uint64_t tNs) {
+    bool lvl = drivenLevel();
+
+    if (_glitchRatePerNs > 0) {
+        while (tNs >= _glitchEnd) nextGlitch();
+        if (tNs >= _glitchStart) lvl = !lvl;
+    }
+    return lvl;
+}
+
+void SimWire::update(uint64_t tNs, int lowDelta, int pullDelta, int highDelta) {
+    bool before = drivenLevel();
+
+    _lowDrivers  += lowDelta;
+    _pullups     += pullDelta;
+    _highDrivers += highDelta;
+
+    if ((lowDelta > 0 || highDelta > 0) && _lowDrivers > 0 && _highDrivers > 0)
+        _contentions++;
+
+    bool after = drivenLevel();
+    if (before == after) return;
+
+    _edges++;
+    if (_edgeLogger) _edgeLogger(tNs, after);
+
+    for (size_t i = 0; i < _listeners.size(); i++)
+        _listeners[i].first->raiseInterrupt(_listeners[i].second, after, tNs);
+}
+
+/* ============================================================
+   SimNode
+   ============================================================ */
+
+static const size_t SIM_STACK_SIZE = 1024 * 1024;
+
+SimNode::SimNode(const char* name, SimCosts costs)
+    : _name(name),
+      _costs(costs),
+      _t(0),
+      _yieldAt(0),
+      _ppm(0),
+      _bootOffsetUs(0),
+      _calls(0),
+      _spin(0),
+      _lastRead(-1),
+      _irqEnabled(true),
+      _inIsr(false),
+      _irqPending(false),
+      _irqTimeNs(0),
+      _scheduler(nullptr),
+      _ctx(new ucontext_t),
+      _jmp(new jmp_buf),
+      _stack(new uint8_t[SIM_STACK_SIZE]),
+      _started(false)
+{
+    for (uint8_t i = 0; i < MAX_PINS; i++) {
+        _pins[i].wire       = nullptr;
+        _pins[i].mode       = INPUT;
+        _pins[i].out        = LOW;
+        _pins[i].input      = true;
+        _pins[i].isr        = nullptr;
+        _pins[i].isrMode    = 0;
+        _pins[i].isrPending = false;
+    }
+}
+
+SimNode::~SimNode() {
+    delete (ucontext_t*)_ctx;
+    delete (jmp_buf*)_jmp;
+    delete[] _stack;
+}
+
+void SimNode::attach(uint8_t pin, SimWire& wire) {
+    if (pin >= MAX_PINS) return;
+    _pins[pin].wire = &wire;
+}
+
+void SimNode::setInput(uint8_t pin, bool level) {
+    if (pin >= MAX_PINS || _pins[pin].input == level) return;
+    _pins[pin].input = level;
+
+    // Edge at the caller's time (another node's loop, like a wire edge)
+    SimNode* caller = Sim::current();
+    raiseInterrupt(pin, level, caller ? caller->_t : _t);
+}
+
+bool SimNode::output(uint8_t pin) const {
+    return (pin < MAX_PINS) ? _pins[pin].out : false;
+}
+
+void SimNode::setClockError(int32_t ppm, uint32_t bootOffsetUs) {
+    _ppm          = ppm;
+    _bootOffsetUs = bootOffsetUs;
+}
+
+uint32_t SimNode::localMicros() const {
+    int64_t local = (int64_t)_t + ((int64_t)_t * _ppm) / 1000000;
+    return _bootOffsetUs + (uint32_t)((uint64_t)local / 1000);
+}
+
+void SimNode::advance(uint32_t ns) {
+    _t += ns;
+    _calls++;
+
+    if (_t > _yieldAt)
+        Sim::_active->yieldToScheduler();
+
+    if (_irqPending && _irqEnabled && !_inIsr)
+        runPendingInterrupts();
+
+    if (_scheduler && !_inIsr)
+        _scheduler->preemptionPoint();
+}
+
+void SimNode::delayLocalNs(uint64_t ns) {
+    // A fast oscillator (ppm > 0) finishes a delay early in real time
+    if (_ppm) ns = (uint64_t)((int64_t)ns * 1000000 / (1000000 + _ppm));
+    while (ns > 1000000000ULL) { advance(1000000000u); ns -= 1000000000ULL; }
+    advance((uint32_t)ns);
+}
+
+void SimNode::poll(uint32_t ns) {
+    // Idle fast-forward: a node that keeps reading the same level is
+    // charged at least the spin quantum per call (0 = exact)
+    uint32_t q = Sim::_active->_spinQuantumNs;
+    if (_spin < SPIN_THRESHOLD) _spin++;
+    else if (q && ns < q)       ns = q;
+    advance(ns);
+}
+
+void SimNode::applyPin(uint8_t pin, uint8_t newMode, uint8_t newOut) {
+    Pin& p = _pins[pin];
+    _spin = 0;
+
+    if (p.wire) {
+        int oldLow  = (p.mode == OUTPUT && p.out == LOW);
+        int oldHigh = (p.mode == OUTPUT && p.out == HIGH);
+        int oldPull = (p.mode == INPUT_PULLUP);
+        int newLow  = (newMode == OUTPUT && newOut == LOW);
+        int newHigh = (newMode == OUTPUT && newOut == HIGH);
+        int newPull = (newMode == INPUT_PULLUP);
+
+        if (oldLow != newLow || oldHigh != newHigh || oldPull != newPull)
+            p.wire->update(_t, newLow - oldLow, newPull - oldPull, newHigh - oldHigh);
+    }
+
+    p.mode = newMode;
+    p.out  = newOut;
+}
+
+void SimNode::pinModeImpl(uint8_t pin, uint8_t mode) {
+    if (pin < MAX_PINS) {
+        // AVR semantics: INPUT_PULLUP sets the output latch, INPUT clears it
+        uint8_t out = _pins[pin].out;
+        if (mode == INPUT_PULLUP) out = HIGH;
+        if (mode == INPUT)        out = LOW;
+        applyPin(pin, mode, out);
+    }
+    advance(_costs.pinModeNs);
+}
+
+void SimNode::digitalWriteImpl(uint8_t pin, uint8_t value) {
+    if (pin < MAX_PINS)
+        applyPin(pin, _pins[pin].mode, value ? HIGH : LOW);
+    advance(_costs.digitalWriteNs);
+}
+
+int SimNode::digitalReadImpl(uint8_t pin) {
+    int v = HIGH;
+    if (pin < MAX_PINS) {
+        const Pin& p = _pins[pin];
+        v = p.wire ? (p.wire->level(_t) ? HIGH : LOW)
+                   : (p.input ? HIGH : LOW);
+    }
+
+    if (v != _lastRead) {
+        _spin     = 0;
+        _lastRead = v;
+    }
+    poll(_costs.digitalReadNs);
+    return v;
+}
+
+void SimNode::attachInterruptImpl(uint8_t pin, void (*isr)(void), int mode) {
+    if (pin >= MAX_PINS) return;
+    Pin& p = _pins[pin];
+
+    if (p.wire && !p.isr)
+        p.wire->_listeners.push_back(std::make_pair(this, pin));
+    p.isr     = isr;
+    p.isrMode = mode;
+}
+
+void SimNode::detachInterruptImpl(uint8_t pin) {
+    if (pin >= MAX_PINS) return;
+    Pin& p = _pins[pin];
+
+    if (p.wire && p.isr) {
+        std::vector<std::pair<SimNode*, uint8_t>>& l = p.wire->_listeners;
+        for (size_t i = 0; i < l.size(); i++) {
+            if (l[i].first == this && l[i].second == pin) {
+                l.erase(l.begin() + i);
+                break;
+            }
+        }
+    }
+    p.isr        = nullptr;
+    p.isrPending = false;
+}
+
+void SimNode::setInterruptsEnabled(bool on) {
+    _irqEnabled = on;
+    if (on && _irqPending && !_inIsr)
+        runPendingInterrupts();
+}
+
+void SimNode::raiseInterrupt(uint8_t pin, bool level, uint64_t tNs) {
+    Pin& p = _pins[pin];
+    if (!p.isr) return;
+
+    bool match = (p.isrMode == CHANGE) ||
+                 (p.isrMode == FALLING && !level) ||
+                 (p.isrMode == RISING  &&  level);
+    if (!match) return;
+
+    if (!_irqPending) _irqTimeNs = tNs;
+    p.isrPending = true;
+    _irqPending  = true;
+}
+
+void SimNode::runPendingInterrupts() {
+    // The node may already be past the edge (it yielded inside a long
+    // call); the ISR runs at the edge time so micros() inside it is exact.
+    uint64_t resumeAt = _t;
+    if (_irqTimeNs < _t) _t = _irqTimeNs;
+    uint64_t isrStart = _t;
+
+    _inIsr = true;
+    do {
+        // Edges latched while an ISR ran fire as soon as it returns
+        _irqPending = false;
+        for (uint8_t i = 0; i < MAX_PINS; i++) {
+            if (!_pins[i].isrPending) continue;
+            _pins[i].isrPending = false;
+            _pins[i].isr();
+        }
+    } while (_irqPending);
+    _inIsr = false;
+
+    // The ISR's own cost still delays the interrupted code
+    _t = resumeAt + (_t - isrStart);
+}
+
+void SimNode::trampoline() {
+    SimNode* n = Sim::current();
+
+    if (n->_setup) n->_setup();
+    for (;;) {
+        if (n->_loop) n->_loop();
+        n->advance(n->_costs.loopNs);
+    }
+}
+
+/* ============================================================
+   Sim
+   ============================================================ */
+
+Sim* Sim::_active = nullptr;
+
+Sim::Sim()
+    : _current(nullptr),
+      _schedCtx(new ucontext_t),
+      _schedJmp(new jmp_buf),
+      _endNs(0),
+      _switches(0),
+      _spinQuantumNs(0)
+{
+    _active = this;
+}
+
+Sim::~Sim() {
+    if (_active == this) _active = nullptr;
+    delete (ucontext_t*)_schedCtx;
+    delete (jmp_buf*)_schedJmp;
+}
+
+void Sim::add(SimNode& node) {
+    node._t = _nodes.empty() ? 0 : now();
+    _nodes.push_back(&node);
+}
+
+uint64_t Sim::now() const {
+    uint64_t t = UINT64_MAX;
+    for (size_t i = 0; i < _nodes.size(); i++)
+        if (_nodes[i]->_t < t) t = _nodes[i]->_t;
+    return _nodes.empty() ? 0 : t;
+}
+
+// ucontext only starts a node; switching uses _setjmp/_longjmp, which
+// (unlike swapcontext) does not save the signal mask with a syscall.
+void Sim::yieldToScheduler() {
+    SimNode* n = _current;
+    if (!_setjmp(*(jmp_buf*)n->_jmp))
+        _longjmp(*(jmp_buf*)_schedJmp, 1);
+}
+
+void Sim::run(uint64_t ns) {
+    _active = this;
+    _endNs  = now() + ns;
+
+    for (;;) {
+        // Conservative scheduling: always advance the node furthest behind
+        SimNode* next = nullptr;
+        for (size_t i = 0; i < _nodes.size(); i++) {
+            SimNode* n = _nodes[i];
+            if (n->_t < _endNs && (!next || n->_t < next->_t))
+                next = n;
+        }
+        if (!next) break;
+
+        uint64_t limit = _endNs;
+        for (size_t i = 0; i < _nodes.size(); i++) {
+            SimNode* n = _nodes[i];
+            if (n != next && n->_t < limit) limit = n->_t;
+        }
+        next->_yieldAt = limit;
+
+        resume(next);
+        _switches++;
+        _current = nullptr;
+    }
+}
+
+void Sim::resume(SimNode* n) {
+    _current = n;
+    if (!_setjmp(*(jmp_buf*)_schedJmp)) {
+        if (!n->_started) {
+            n->_started = true;
+            ucontext_t* ctx = (ucontext_t*)n->_ctx;
+            getcontext(ctx);
+            ctx->uc_stack.ss_sp   = n->_stack;
+            ctx->uc_stack.ss_size = SIM_STACK_SIZE;
+            ctx->uc_link          = nullptr;
+            makecontext(ctx, &SimNode::trampoline, 0);
+            swapcontext((ucontext_t*)_schedCtx, ctx);
+        } else {
+            _longjmp(*(jmp_buf*)n->_jmp, 1);
+        }
+    }
+}
+
+bool Sim::runUntil(std::function<bool()> done, uint64_t timeoutNs, uint64_t sliceNs) {
+    uint64_t start = now();
+    while (!done()) {
+        if (now() - start >= timeoutNs) return false;
+        run(sliceNs);
+    }
+    return true;
+}
+
+/* ============================================================
+   Arduino API shim
+   ============================================================ */
+
+static SimNode* node() {
+    SimNode* n = Sim::current();
+    if (!n) {
+        fprintf(stderr, "ButComSim: Arduino call outside of a SimNode\n");
+        abort();
+    }
+    return n;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)       { node()->pinModeImpl(pin, mode); }
+void digitalWrite(uint8_t pin, uint8_t value) { node()->digitalWriteImpl(pin, value); }
+int  digitalRead(uint8_t pin)                 { return node()->digitalReadImpl(pin); }
+
+uint32_t micros() {
+    SimNode* n = node();
+    uint32_t v = n->localMicros();
+    n->poll(n->costs().microsNs);
+    return v;
+}
+
+uint32_t millis() {
+    SimNode* n = node();
+    uint32_t v = n->localMicros() / 1000;
+    n->poll(n->costs().millisNs);
+    return v;
+}
+
+void delayMicroseconds(unsigned int us) { node()->delayLocalNs(us * 1000ULL); }
+
+void delay(uint32_t ms) {
+    SimNode* n = node();
+    while (ms--) n->delayLocalNs(1000000u);
+}
+
+void yield() { node()->advance(node()->costs().loopNs); }
+
+void attachInterrupt(uint8_t interruptNum, void (*isr)(void), int mode) {
+    node()->attachInterruptImpl(interruptNum, isr, mode);
+}
+
+// Also called from destructors after the simulation (no current node)
+void detachInterrupt(uint8_t interruptNum) {
+    if (SimNode* n = Sim::current()) n->detachInterruptImpl(interruptNum);
+}
+
+void noInterrupts()                        { node()->setInterruptsEnabled(false); }
+void interrupts()                          { node()->setInterruptsEnabled(true); }
@@ -0,0 +1,229 @@
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+/* ============================================================
+   ButComSim - Deterministic host simulator for ButCom
+   ------------------------------------------------------------
+   - SimWire:  wired-AND (open-drain) line with pull-up,
+               optional random glitches for error injection
+   - SimNode:  one virtual MCU. Runs its setup()/loop() as a
+               coroutine with its own virtual clock; every
+               Arduino call costs a configurable time
+   - Sim:      conservative discrete-event scheduler. Always
+               runs the node that is furthest behind in time,
+               so every read sees all earlier writes.
+   - SimNodeScheduler: hook for a task scheduler inside one
+               node (SimRtos, the FreeRTOS shim)
+
+   Single-threaded and fully deterministic: the same program
+   and seed always produce the same bit-exact run.
+   ============================================================ */
+
+class SimNode;
+
+// Task scheduler running inside one node. preemptionPoint() is called
+// after every Arduino call (outside ISRs), so a task that became ready
+// can take the CPU like on the tick / yield of a real RTOS.
+class SimNodeScheduler {
+public:
+    virtual ~SimNodeScheduler() {}
+    virtual void preemptionPoint() = 0;
+};
+
+// Virtual time charged per Arduino call (nanoseconds)
+struct SimCosts {
+    uint32_t digitalReadNs;
+    uint32_t digitalWriteNs;
+    uint32_t pinModeNs;
+    uint32_t microsNs;
+    uint32_t millisNs;
+    uint32_t loopNs;            // between two loop() calls
+
+    static SimCosts esp32c3();  // 160 MHz RISC-V, Arduino core
+    static SimCosts attiny85(); // 8 MHz AVR, Arduino core
+};
+
+/* ============================================================
+   SimWire
+   ============================================================ */
+class SimWire {
+public:
+    explicit SimWire(bool externalPullup = true);
+
+    // Random glitches that invert the line for glitchNs each. The rate
+    // is chosen so that a sample lands in a glitch with probability
+    // bitErrorRate. 0 disables.
+    void setNoise(double bitErrorRate, uint32_t glitchNs, uint32_t seed = 1);
+
+    // Called on every driven level change (not on glitches)
+    void setEdgeLogger(std::function<void(uint64_t tNs, bool level)> fn) { _edgeLogger = fn; }
+
+    bool     level(uint64_t tNs);          // level seen by a reader at tNs
+    bool     drivenLevel() const;          // without noise
+    uint32_t edges() const       { return _edges; }
+    uint32_t contentions() const { return _contentions; }
+
+private:
+    friend class SimNode;
+
+    void update(uint64_t tNs, int lowDelta, int pullDelta, int highDelta);
+    void nextGlitch();
+
+    bool     _externalPullup;
+    int      _lowDrivers;
+    int      _highDrivers;       // push-pull HIGH (pinMode OUTPUT + HIGH)
+    int      _pullups;           // nodes with INPUT_PULLUP
+
+    double   _glitchRatePerNs;
+    uint32_t _glitchNs;
+    uint64_t _rng;
+    uint64_t _glitchStart;
+    uint64_t _glitchEnd;
+
+    uint32_t _edges;
+    uint32_t _contentions;
+    std::function<void(uint64_t, bool)> _edgeLogger;
+
+    std::vector<std::pair<SimNode*, uint8_t>> _listeners;   // (node, pin) with ISR
+};
+
+/* ============================================================
+   SimNode
+   ============================================================ */
+class SimNode {
+public:
+    explicit SimNode(const char* name, SimCosts costs = SimCosts::esp32c3());
+    ~SimNode();
+
+    SimNode(const SimNode&) = delete;
+    SimNode& operator=(const SimNode&) = delete;
+
+    void attach(uint8_t pin, SimWire& wire);
+    void setInput(uint8_t pin, bool level);          // unattached pins (buttons, ...), fires their ISR
+    bool output(uint8_t pin) const;                  // last digitalWrite() value
+
+    // Local oscillator error and power-on offset of micros(); delays
+    // run on the same skewed clock
+    void setClockError(int32_t ppm, uint32_t bootOffsetUs = 0);
+
+    void setSetup(std::function<void()> fn) { _setup = fn; }
+    void setLoop(std::function<void()> fn)  { _loop = fn; }
+
+    // setup()/loop() become one task of the scheduler (owned by the caller)
+    void setScheduler(SimNodeScheduler* s) { _scheduler = s; }
+    SimNodeScheduler* scheduler() const    { return _scheduler; }
+
+    const char* name() const      { return _name; }
+    uint64_t    timeNs() const    { return _t; }
+    uint32_t    localMicros() const;
+    const SimCosts& costs() const { return _costs; }
+    uint64_t    arduinoCalls() const { return _calls; }
+
+    // ---- Used by the Arduino shim (current node only) ----
+    void     advance(uint32_t ns);
+    void     poll(uint32_t ns);                      // advance() for read/micros/millis
+    void     delayLocalNs(uint64_t ns);              // advance() by local-clock time
+    void     pinModeImpl(uint8_t pin, uint8_t mode);
+    void     digitalWriteImpl(uint8_t pin, uint8_t value);
+    int      digitalReadImpl(uint8_t pin);
+    void     attachInterruptImpl(uint8_t pin, void (*isr)(void), int mode);
+    void     detachInterruptImpl(uint8_t pin);
+    void     setInterruptsEnabled(bool on);
+
+private:
+    friend class Sim;
+    friend class SimWire;
+
+    enum { MAX_PINS = 64, SPIN_THRESHOLD = 32 };
+
+    struct Pin {
+        SimWire* wire;
+        uint8_t  mode;
+        uint8_t  out;
+        bool     input;          // level of an unattached pin
+        void   (*isr)(void);
+        int      isrMode;
+        bool     isrPending;
+    };
+
+    static void trampoline();
+    void applyPin(uint8_t pin, uint8_t newMode, uint8_t newOut);
+    void raiseInterrupt(uint8_t pin, bool level, uint64_t tNs);
+    void runPendingInterrupts();
+
+    const char* _name;
+    SimCosts    _costs;
+    Pin         _pins[MAX_PINS];
+
+    uint64_t    _t;              // virtual time (ns)
+    uint64_t    _yieldAt;        // run until _t passes this
+    int32_t     _ppm;
+    uint32_t    _bootOffsetUs;
+    uint64_t    _calls;
+    uint8_t     _spin;           // polls since the last level change / write
+    int         _lastRead;
+
+    bool        _irqEnabled;
+    bool        _inIsr;
+    bool        _irqPending;
+    uint64_t    _irqTimeNs;
+
+    std::function<void()> _setup;
+    std::function<void()> _loop;
+    SimNodeScheduler*     _scheduler;
+
+    void*       _ctx;            // ucontext_t (start only)
+    void*       _jmp;            // jmp_buf
+    uint8_t*    _stack;
+    bool        _started;
+};
+
+/* ============================================================
+   Sim (scheduler)
+   ============================================================ */
+class Sim {
+public:
+    Sim();
+    ~Sim();
+
+    void add(SimNode& node);
+
+    // Run every node until virtual time reaches now() + ns
+    void run(uint64_t ns);
+
+    // Run until done() returns true (checked every sliceNs) or timeout.
+    // Returns true if done() became true.
+    bool runUntil(std::function<bool()> done,
+                  uint64_t timeoutNs,
+                  uint64_t sliceNs = 100000);
+
+    uint64_t now() const;                 // virtual time of the slowest node
+
+    // Idle fast-forward. After 32 read/micros()/millis() calls in a row
+    // without seeing a level change or driving a pin, each further such
+    // call costs at least quantumNs. Edge detection, sample points and
+    // timeouts are then off by up to ~2 quanta. 0 (default) = exact.
+    void setSpinQuantum(uint32_t quantumNs) { _spinQuantumNs = quantumNs; }
+    uint64_t switches() const { return _switches; }
+
+    static Sim*     active()  { return _active; }
+    static SimNode* current() { return _active ? _active->_current : nullptr; }
+
+private:
+    friend class SimNode;
+
+    void yieldToScheduler();
+    void resume(SimNode* n);
+
+    std::vector<SimNode*> _nodes;
+    SimNode*              _current;
+    void*                 _schedCtx;      // ucontext_t
+    void*                 _schedJmp;      // jmp_buf
+    uint64_t              _endNs;
+    uint64_t              _switches;
+    uint32_t              _spinQuantumNs;
+
+    static Sim*           _active;
+};
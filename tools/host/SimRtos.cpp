@@ -0,0 +1,488 @@
+#include "SimRtos.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+static const size_t   TASK_STACK_SIZE = 256 * 1024;
+static const uint64_t TICK_NS         = 1000000;      // 1 kHz
+
+enum { WAIT_NONE, WAIT_DELAY, WAIT_NOTIFY, WAIT_SEND, WAIT_RECEIVE };
+
+struct SimTask {
+    SimRtos*       kernel;
+    const char*    name;
+    UBaseType_t    prio;
+    TaskFunction_t fn;
+    void*          arg;
+    ucontext_t     ctx;
+    uint8_t*       stack;        // nullptr: loopTask runs on the node's stack
+
+    enum { READY, BLOCKED, DELETED } state;
+    uint64_t       seq;          // FIFO order within a priority
+    uint64_t       wakeNs;       // UINT64_MAX = no timeout
+    bool           timedOut;
+    const void*    waitObj;
+    uint8_t        waitKind;
+
+    uint32_t       notifyValue;
+    bool           notifyPending;
+    uint64_t       runNs;
+};
+
+struct SimQueue {
+    UBaseType_t          length;
+    UBaseType_t          itemSize;
+    UBaseType_t          head;
+    UBaseType_t          count;
+    std::vector<uint8_t> buf;
+};
+
+static uint64_t seqCounter;
+
+/* ============================================================
+   SimRtos
+   ============================================================ */
+
+SimRtos::SimRtos(SimNode& node, uint32_t switchNs, uint32_t idleStepNs, uint32_t apiNs)
+    : _node(node),
+      _switchNs(switchNs),
+      _idleStepNs(idleStepNs),
+      _apiNs(apiNs),
+      _current(nullptr),
+      _inKernel(false),
+      _switchPending(false),
+      _nextEventNs(TICK_NS),
+      _nextTickNs(TICK_NS),
+      _runStartNs(0),
+      _idleNs(0),
+      _switches(0)
+{
+    SimTask* loop = new SimTask();
+    loop->kernel = this;
+    loop->name   = "loopTask";
+    loop->prio   = 1;
+    loop->state  = SimTask::READY;
+    loop->seq    = ++seqCounter;
+    loop->wakeNs = UINT64_MAX;
+    _tasks.push_back(loop);
+    _current = loop;
+
+    _node.setScheduler(this);
+}
+
+SimRtos::~SimRtos() {
+    _node.setScheduler(nullptr);
+    for (size_t i = 0; i < _tasks.size(); i++) {
+        delete[] _tasks[i]->stack;
+        delete _tasks[i];
+    }
+}
+
+SimRtos* SimRtos::current() {
+    SimNode* n = Sim::current();
+    SimRtos* k = n ? static_cast<SimRtos*>(n->scheduler()) : nullptr;
+    if (!k) {
+        fprintf(stderr, "SimRtos: FreeRTOS call on a node without SimRtos\n");
+        abort();
+    }
+    return k;
+}
+
+uint64_t SimRtos::nowNs() const {
+    return _node.timeNs();
+}
+
+uint64_t SimRtos::runNs(TaskHandle_t t) const {
+    uint64_t ns = t->runNs;
+    if (t == _current) ns += nowNs() - _runStartNs;
+    return ns;
+}
+
+void SimRtos::charge(uint64_t now) {
+    _current->runNs += now - _runStartNs;
+    _runStartNs = now;
+}
+
+SimTask* SimRtos::createTask(TaskFunction_t fn, const char* name, void* arg, UBaseType_t prio) {
+    SimTask* t = new SimTask();
+    t->kernel = this;
+    t->name   = name;
+    t->prio   = prio;
+    t->fn     = fn;
+    t->arg    = arg;
+    t->stack  = new uint8_t[TASK_STACK_SIZE];
+    t->state  = SimTask::READY;
+    t->seq    = ++seqCounter;
+    t->wakeNs = UINT64_MAX;
+
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp   = t->stack;
+    t->ctx.uc_stack.ss_size = TASK_STACK_SIZE;
+    t->ctx.uc_link          = nullptr;
+    makecontext(&t->ctx, &SimRtos::taskEntry, 0);
+
+    _tasks.push_back(t);
+    return t;
+}
+
+void SimRtos::taskEntry() {
+    SimRtos* k = current();
+    SimTask* t = k->_current;
+    k->_inKernel = false;           // switchTo() entered the kernel for us
+
+    t->fn(t->arg);
+    k->deleteTask(t);               // returning from a task function
+}
+
+void SimRtos::deleteTask(SimTask* t) {
+    t->state = SimTask::DELETED;
+    if (t != _current) return;
+
+    // The stack stays allocated until the kernel goes away
+    _inKernel = true;
+    schedule(false);
+    fprintf(stderr, "SimRtos: deleted task resumed\n");
+    abort();
+}
+
+void SimRtos::makeReady(SimTask* t, bool fromIsr) {
+    t->state    = SimTask::READY;
+    t->seq      = ++seqCounter;
+    t->waitObj  = nullptr;
+    t->waitKind = WAIT_NONE;
+    t->wakeNs   = UINT64_MAX;
+
+    if (t->prio > _current->prio) {
+        _switchPending = true;
+        if (!fromIsr && !_inKernel) {
+            _inKernel = true;
+            schedule(false);
+            _inKernel = false;
+        }
+    }
+}
+
+SimTask* SimRtos::firstWaiter(const void* obj, uint8_t kind) const {
+    SimTask* best = nullptr;
+    for (size_t i = 0; i < _tasks.size(); i++) {
+        SimTask* t = _tasks[i];
+        if (t->state != SimTask::BLOCKED || t->waitObj != obj || t->waitKind != kind) continue;
+        if (!best || t->prio > best->prio || (t->prio == best->prio && t->seq < best->seq))
+            best = t;
+    }
+    return best;
+}
+
+void SimRtos::wakeTimeouts(uint64_t now) {
+    _nextEventNs = _nextTickNs;
+    for (size_t i = 0; i < _tasks.size(); i++) {
+        SimTask* t = _tasks[i];
+        if (t->state != SimTask::BLOCKED) continue;
+
+        if (t->wakeNs <= now) {
+            t->timedOut = true;
+            t->state    = SimTask::READY;
+            t->seq      = ++seqCounter;
+            t->wakeNs   = UINT64_MAX;
+        } else if (t->wakeNs < _nextEventNs) {
+            _nextEventNs = t->wakeNs;
+        }
+    }
+}
+
+SimTask* SimRtos::pickNext(bool rotate) const {
+    SimTask* best = nullptr;
+    for (size_t i = 0; i < _tasks.size(); i++) {
+        SimTask* t = _tasks[i];
+        if (t->state != SimTask::READY) continue;
+        if (!best || t->prio > best->prio || (t->prio == best->prio && t->seq < best->seq))
+            best = t;
+    }
+
+    // A ready task of the same priority waits for the next tick
+    if (!rotate && best && _current->state == SimTask::READY && _current->prio >= best->prio)
+        return _current;
+    return best;
+}
+
+void SimRtos::switchTo(SimTask* next) {
+    charge(nowNs());
+    _switches++;
+
+    SimTask* prev = _current;
+    _current = next;
+    _node.advance(_switchNs);       // charged to the next task
+
+    swapcontext(&prev->ctx, &next->ctx);
+}
+
+void SimRtos::schedule(bool rotate) {
+    for (;;) {
+        uint64_t now = nowNs();
+        wakeTimeouts(now);
+
+        if (rotate && _current->state == SimTask::READY)
+            _current->seq = ++seqCounter;
+
+        SimTask* next = pickNext(rotate);
+        if (next) {
+            _switchPending = false;
+            if (next != _current) switchTo(next);
+            return;
+        }
+
+        // Idle: ISRs and timeouts make a task ready
+        charge(now);
+        uint64_t step = _idleStepNs;
+        if (_nextEventNs > now && _nextEventNs - now < step) step = _nextEventNs - now;
+        if (step == 0) step = 1;
+        _node.advance((uint32_t)step);
+
+        uint64_t after = nowNs();
+        _idleNs    += after - now;
+        _runStartNs = after;
+        rotate      = false;
+    }
+}
+
+bool SimRtos::block(TickType_t ticks, const void* waitObj, uint8_t waitKind) {
+    SimTask* t  = _current;
+    t->state    = SimTask::BLOCKED;
+    t->seq      = ++seqCounter;
+    t->waitObj  = waitObj;
+    t->waitKind = waitKind;
+    t->timedOut = false;
+    t->wakeNs   = (ticks == portMAX_DELAY) ? UINT64_MAX : nowNs() + (uint64_t)ticks * TICK_NS;
+    if (t->wakeNs < _nextEventNs) _nextEventNs = t->wakeNs;
+
+    _inKernel = true;
+    schedule(false);
+    _inKernel = false;
+    return !t->timedOut;
+}
+
+void SimRtos::yield() {
+    _inKernel = true;
+    schedule(true);
+    _inKernel = false;
+}
+
+void SimRtos::preemptionPoint() {
+    if (_inKernel) return;
+
+    uint64_t now = nowNs();
+    if (!_switchPending && now < _nextEventNs) return;
+
+    bool tick = false;
+    if (now >= _nextTickNs) {
+        tick        = true;
+        _nextTickNs = (now / TICK_NS + 1) * TICK_NS;
+    }
+
+    _inKernel = true;
+    schedule(tick);
+    _inKernel = false;
+}
+
+/* ============================================================
+   FreeRTOS API
+   ============================================================ */
+
+void vSimRtosYieldFromIsr() { SimRtos::current()->requestSwitch(); }
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t,
+                                   void* arg, UBaseType_t prio, TaskHandle_t* handle,
+                                   BaseType_t)
+{
+    SimRtos* k = SimRtos::current();
+    SimTask* t = k->createTask(fn, name, arg, prio);
+    if (handle) *handle = t;
+
+    t->state = SimTask::BLOCKED;      // makeReady() preempts if it outranks us
+    k->makeReady(t, false);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack,
+                       void* arg, UBaseType_t prio, TaskHandle_t* handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    SimRtos* k = SimRtos::current();
+    k->deleteTask(task ? task : k->running());
+}
+
+void vTaskDelay(TickType_t ticks) {
+    SimRtos* k = SimRtos::current();
+    if (ticks == 0) k->yield();
+    else            k->block(ticks, nullptr, WAIT_DELAY);
+}
+
+TickType_t   xTaskGetTickCount()         { return (TickType_t)(SimRtos::current()->nowNs() / TICK_NS); }
+TaskHandle_t xTaskGetCurrentTaskHandle() { return SimRtos::current()->running(); }
+void         taskYIELD()                 { SimRtos::current()->yield(); }
+
+static BaseType_t notify(SimTask* t, uint32_t value, eNotifyAction action,
+                         bool fromIsr, BaseType_t* woken)
+{
+    t->kernel->apiCall();
+
+    switch (action) {
+        case eSetBits:               t->notifyValue |= value; break;
+        case eIncrement:             t->notifyValue++;        break;
+        case eSetValueWithOverwrite: t->notifyValue = value;  break;
+        case eSetValueWithoutOverwrite:
+            if (t->notifyPending) return pdFAIL;
+            t->notifyValue = value;
+            break;
+        case eNoAction:
+            break;
+    }
+    t->notifyPending = true;
+
+    if (t->state == SimTask::BLOCKED && t->waitKind == WAIT_NOTIFY) {
+        SimRtos* k = t->kernel;
+        if (woken && t->prio > k->running()->prio) *woken = pdTRUE;
+        k->makeReady(t, fromIsr);
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t t, uint32_t value, eNotifyAction action) {
+    return notify(t, value, action, false, nullptr);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t t) {
+    return notify(t, 0, eIncrement, false, nullptr);
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t t, uint32_t value, eNotifyAction action,
+                              BaseType_t* woken)
+{
+    return notify(t, value, action, true, woken);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t t, BaseType_t* woken) {
+    notify(t, 0, eIncrement, true, woken);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    SimRtos* k = SimRtos::current();
+    SimTask* t = k->running();
+    k->apiCall();
+
+    if (t->notifyValue == 0 && ticks) k->block(ticks, nullptr, WAIT_NOTIFY);
+
+    uint32_t v = t->notifyValue;
+    if (v) t->notifyValue = clearOnExit ? 0 : v - 1;
+    t->notifyPending = false;
+    return v;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit,
+                           uint32_t* value, TickType_t ticks)
+{
+    SimRtos* k = SimRtos::current();
+    SimTask* t = k->running();
+    k->apiCall();
+
+    if (!t->notifyPending) {
+        t->notifyValue &= ~clearOnEntry;
+        if (ticks) k->block(ticks, nullptr, WAIT_NOTIFY);
+    }
+
+    if (value) *value = t->notifyValue;
+    if (!t->notifyPending) return pdFALSE;
+
+    t->notifyValue  &= ~clearOnExit;
+    t->notifyPending = false;
+    return pdTRUE;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    SimQueue* q = new SimQueue();
+    q->length   = length;
+    q->itemSize = itemSize;
+    q->head     = 0;
+    q->count    = 0;
+    q->buf.resize((size_t)length * itemSize);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q) { delete q; }
+
+static void queuePush(SimQueue* q, const void* item) {
+    UBaseType_t tail = (q->head + q->count) % q->length;
+    memcpy(&q->buf[(size_t)tail * q->itemSize], item, q->itemSize);
+    q->count++;
+}
+
+static void queuePop(SimQueue* q, void* item) {
+    memcpy(item, &q->buf[(size_t)q->head * q->itemSize], q->itemSize);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+}
+
+// Blocking send / receive: retry after every wake-up until the deadline
+static TickType_t ticksLeft(SimRtos* k, TickType_t ticks, uint64_t startNs) {
+    if (ticks == portMAX_DELAY) return ticks;
+    uint64_t end = startNs + (uint64_t)ticks * TICK_NS;
+    uint64_t now = k->nowNs();
+    return (now >= end) ? 0 : (TickType_t)((end - now + TICK_NS - 1) / TICK_NS);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks) {
+    SimRtos* k     = SimRtos::current();
+    uint64_t start = k->nowNs();
+    k->apiCall();
+
+    for (;;) {
+        if (q->count < q->length) {
+            queuePush(q, item);
+            if (SimTask* w = k->firstWaiter(q, WAIT_RECEIVE)) k->makeReady(w, false);
+            return pdPASS;
+        }
+        TickType_t left = ticksLeft(k, ticks, start);
+        if (left == 0 || !k->block(left, q, WAIT_SEND)) return errQUEUE_FULL;
+    }
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void* item, TickType_t ticks) {
+    return xQueueSend(q, item, ticks);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks) {
+    SimRtos* k     = SimRtos::current();
+    uint64_t start = k->nowNs();
+    k->apiCall();
+
+    for (;;) {
+        if (q->count > 0) {
+            queuePop(q, item);
+            if (SimTask* w = k->firstWaiter(q, WAIT_SEND)) k->makeReady(w, false);
+            return pdPASS;
+        }
+        TickType_t left = ticksLeft(k, ticks, start);
+        if (left == 0 || !k->block(left, q, WAIT_RECEIVE)) return errQUEUE_EMPTY;
+    }
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t* woken) {
+    SimRtos* k = SimRtos::current();
+    k->apiCall();
+    if (q->count >= q->length) return errQUEUE_FULL;
+
+    queuePush(q, item);
+    if (SimTask* w = k->firstWaiter(q, WAIT_RECEIVE)) {
+        if (woken && w->prio > k->running()->prio) *woken = pdTRUE;
+        k->makeReady(w, true);
+    }
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) { return q->count; }
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) { return q->length - q->count; }
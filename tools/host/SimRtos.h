@@ -0,0 +1,88 @@
+#pragma once
+#include "ButComSim.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+/* ============================================================
+   SimRtos - FreeRTOS subset on top of a SimNode
+   ------------------------------------------------------------
+   Enough of the FreeRTOS API (tasks, queues, task
+   notifications, delays) for ButComRtos and the benchmarks:
+
+   - Fixed priority, preemptive. A task that becomes ready with
+     a higher priority takes the CPU at the next Arduino call
+     of the running task (or when it blocks); equal priorities
+     share the CPU round-robin on the 1 ms tick.
+   - The node's setup()/loop() run as "loopTask" at priority 1,
+     like on the ESP32 Arduino core.
+   - One core: the core argument of xTaskCreatePinnedToCore()
+     is ignored (ESP32-C3).
+   - A context switch costs switchNs of virtual time, every
+     queue / notification call apiNs; while no task is ready the
+     node idles in idleStepNs steps, so ISRs and timeouts wake
+     tasks with at most that latency.
+
+   Create one SimRtos per node before Sim::run().
+   ============================================================ */
+
+struct SimTask;
+struct SimQueue;
+
+class SimRtos : public SimNodeScheduler {
+public:
+    explicit SimRtos(SimNode& node, uint32_t switchNs = 2000, uint32_t idleStepNs = 5000,
+                     uint32_t apiNs = 1000);
+    ~SimRtos();
+
+    SimRtos(const SimRtos&) = delete;
+    SimRtos& operator=(const SimRtos&) = delete;
+
+    // Statistics
+    uint64_t idleNs() const          { return _idleNs; }
+    uint64_t contextSwitches() const { return _switches; }
+    uint64_t runNs(TaskHandle_t task) const;          // CPU time incl. ISRs it was interrupted by
+    TaskHandle_t loopTask() const    { return _tasks[0]; }
+
+    void preemptionPoint() override;
+
+    // ---- Used by the FreeRTOS shim (current node only) ----
+    static SimRtos* current();
+
+    SimTask* createTask(TaskFunction_t fn, const char* name, void* arg, UBaseType_t prio);
+    void     deleteTask(SimTask* t);
+    SimTask* running() const         { return _current; }
+    uint64_t nowNs() const;
+
+    // Blocks the running task until it is made ready or the timeout
+    // (ticks, portMAX_DELAY = forever) expires. false on timeout.
+    bool     block(TickType_t ticks, const void* waitObj, uint8_t waitKind);
+    void     makeReady(SimTask* t, bool fromIsr);
+    SimTask* firstWaiter(const void* waitObj, uint8_t waitKind) const;
+    void     yield();                                 // taskYIELD()
+    void     requestSwitch()         { _switchPending = true; }
+    void     apiCall()               { _node.advance(_apiNs); }
+
+private:
+    static void taskEntry();
+
+    void     schedule(bool rotate);
+    void     switchTo(SimTask* next);
+    void     wakeTimeouts(uint64_t now);
+    SimTask* pickNext(bool rotate) const;
+    void     charge(uint64_t now);
+
+    SimNode&              _node;
+    uint32_t              _switchNs;
+    uint32_t              _idleStepNs;
+    uint32_t              _apiNs;
+    std::vector<SimTask*> _tasks;
+    SimTask*              _current;
+    bool                  _inKernel;
+    bool                  _switchPending;
+    uint64_t              _nextEventNs;               // earliest timeout or tick
+    uint64_t              _nextTickNs;
+    uint64_t              _runStartNs;
+    uint64_t              _idleNs;
+    uint64_t              _switches;
+};
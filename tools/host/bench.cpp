@@ -0,0 +1,349 @@
+/* ============================================================
+   bench - ButCom throughput / latency benchmark (host)
+   ------------------------------------------------------------
+   Two endpoints (ESP32-C3 sender, ATtiny85 receiver) on a
+   SimWire. For every combination of
+
+     speed quality   1..4
+     payload size    0, 1, 4, 8, 12, 16   (--all-sizes: 0..16)
+     ACK mode        off / on
+     bit error rate  0, 1e-4, 1e-3        (glitch injection;
+                                           --ber B, repeatable)
+     FEC             off                  (--fec: off / on)
+
+   the sender pushes --frames frames and reports
+
+     goodput_Bps     unique payload bytes delivered per second
+     fps             unique frames delivered per second
+     lat_p50/90/99   send() call → receiver callback (µs)
+     ack_rtt_p50/99  send() call → ACK seen by the sender (µs)
+     cpu_tx/rx       % of time inside send()/loop() that is not
+                     spent waiting for a start bit
+
+   The simulator is deterministic, so two runs of the same
+   tree give identical numbers and any diff is a regression
+   (or an improvement).
+
+   usage: bench [--csv|--json] [--frames N] [--all-sizes]
+                [--fec] [--quality Q] [--ber B]... [--out file]
+   ============================================================ */
+
+#include "ButComSim.h"
+#include "ButCom.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define DATA_PIN 2
+
+struct BenchCase {
+    uint8_t quality;
+    uint8_t payload;
+    bool    ack;
+    double  ber;
+    bool    fec;
+};
+
+struct BenchResult {
+    uint32_t sent;
+    uint32_t delivered;
+    uint32_t duplicates;
+    uint32_t corrupt;
+    uint32_t acked;
+    double   seconds;
+    double   goodputBps;
+    double   fps;
+    uint32_t latP50, latP90, latP99;
+    uint32_t rttP50, rttP99;
+    double   cpuTx, cpuRx;
+};
+
+/* ---------------- one run ---------------- */
+
+// State of the running case (ButCom callbacks are plain functions)
+struct BenchRun {
+    ButCom*  tx;
+    ButCom*  rx;
+    SimNode* txNode;
+    SimNode* rxNode;
+
+    uint8_t  payload;
+    bool     ack;
+    uint32_t frames;
+    uint32_t gapMs;                  // no-ACK mode: max wait for the auto-ACK
+
+    uint32_t sent;
+    uint8_t  msgId;                  // last sent (1, 2, 3, ...)
+    uint64_t sentAtNs[256];          // by msgId
+    bool     awaiting;               // waiting for the ACK of msgId
+    uint64_t awaitSinceNs;
+    bool     seen[256];              // delivered once (by msgId)
+
+    uint32_t delivered, duplicates, corrupt, acked;
+    std::vector<uint32_t> latUs, rttUs;
+
+    uint64_t lastFallNs;             // last falling edge on the wire
+    uint64_t busyTxNs, busyRxNs;
+};
+
+static BenchRun* run_;
+
+static uint8_t patternByte(uint8_t id, uint8_t i) { return (uint8_t)(id * 31 + i * 7 + 1); }
+
+static void onTx(uint8_t msgId, uint8_t type, const uint8_t*, uint8_t) {
+    BenchRun& r = *run_;
+    if (type != BUTCOM_MSG_ACK || !r.awaiting || msgId != r.msgId) return;
+
+    r.rttUs.push_back((uint32_t)((r.txNode->timeNs() - r.sentAtNs[msgId]) / 1000));
+    r.acked++;
+    r.awaiting = false;
+}
+
+static void onRx(uint8_t msgId, uint8_t type, const uint8_t* data, uint8_t len) {
+    BenchRun& r = *run_;
+    if (type != BUTCOM_MSG_DATA) return;
+
+    bool ok = (len == r.payload);
+    for (uint8_t i = 0; ok && i < len; i++)
+        ok = (data[i] == patternByte(msgId, i));
+    if (!ok) { r.corrupt++; return; }
+
+    if (r.seen[msgId]) { r.duplicates++; return; }
+    r.seen[msgId] = true;
+    r.delivered++;
+    r.latUs.push_back((uint32_t)((r.rxNode->timeNs() - r.sentAtNs[msgId]) / 1000));
+}
+
+// Time of a call that was not spent waiting for a start bit
+static uint64_t busyPart(uint64_t t0, uint64_t t1, bool ownTx) {
+    if (ownTx) return t1 - t0;
+    if (run_->lastFallNs > t0) return t1 - run_->lastFallNs;
+    return 0;
+}
+
+static uint32_t percentile(std::vector<uint32_t>& v, uint32_t p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = ((v.size() - 1) * p + 50) / 100;
+    return v[i];
+}
+
+static BenchResult runCase(const BenchCase& c, uint32_t frames, uint32_t seed) {
+    SimWire wire;
+    SimNode espNode("esp32", SimCosts::esp32c3());
+    SimNode tinyNode("attiny85", SimCosts::attiny85());
+    ButCom  tx(DATA_PIN, true,  0x20);
+    ButCom  rx(DATA_PIN, false, 0x10);
+
+    BenchRun r{};
+    r.tx      = &tx;
+    r.rx      = &rx;
+    r.txNode  = &espNode;
+    r.rxNode  = &tinyNode;
+    r.payload = c.payload;
+    r.ack     = c.ack;
+    r.frames  = frames;
+    run_ = &r;
+
+    // Frame + ACK time on the wire (13 bit times per byte incl. idle gap)
+    static const uint16_t bitUs[5] = { 0, 300, 500, 800, 1200 };
+    uint32_t bytes = (5 + c.payload) + 5;
+    if (c.fec) bytes = 2 * bytes;
+    r.gapMs = bytes * 13 * bitUs[c.quality] / 1000 + 20;
+
+    wire.setEdgeLogger([](uint64_t t, bool level) { if (!level) run_->lastFallNs = t; });
+    if (c.ber > 0) wire.setNoise(c.ber, 20000, seed);
+
+    espNode.attach(DATA_PIN, wire);
+    tinyNode.attach(DATA_PIN, wire);
+
+    uint8_t quality = c.quality;
+    bool    fec     = c.fec;
+    espNode.setSetup([&tx, quality, fec]() {
+        tx.setCallback(onTx);
+        tx.setSpeedQuality(quality);
+        tx.setFecMode(fec);
+        tx.setHelloInterval(0);
+        tx.begin(false);
+    });
+    tinyNode.setSetup([&rx, quality, fec]() {
+        rx.setCallback(onRx);
+        rx.setSpeedQuality(quality);
+        rx.setFecMode(fec);
+        rx.setHelloInterval(0);
+        rx.begin(false);
+    });
+
+    espNode.setLoop([]() {
+        BenchRun& r = *run_;
+        uint64_t  t0 = r.txNode->timeNs();
+        r.tx->loop();
+        r.busyTxNs += busyPart(t0, r.txNode->timeNs(), false);
+
+        // Next frame once the previous one is confirmed (or given up).
+        // The receiver ACKs every frame, so even without ACK request the
+        // sender has to leave room for that ACK.
+        if (r.sent >= r.frames) return;
+        if (r.ack && r.tx->txPending()) return;
+        if (r.awaiting && !r.ack &&
+            (r.txNode->timeNs() - r.awaitSinceNs) / 1000000 < r.gapMs) return;
+
+        // HELLO is off, so message IDs run 1, 2, 3, ... The receiver
+        // callback can run before send() returns, so stamp the ID first.
+        uint8_t p[BUTCOM_MAX_PAYLOAD];
+        uint8_t nextId = (uint8_t)(r.sent + 1);
+        for (uint8_t i = 0; i < r.payload; i++) p[i] = patternByte(nextId, i);
+
+        uint64_t t1 = r.txNode->timeNs();
+        r.sentAtNs[nextId] = t1;
+        r.msgId   = r.tx->send(p, r.payload, r.ack);
+        r.busyTxNs += busyPart(t1, r.txNode->timeNs(), true);
+
+        r.awaiting     = true;
+        r.awaitSinceNs = r.txNode->timeNs();
+        r.sent++;
+    });
+    tinyNode.setLoop([]() {
+        BenchRun& r = *run_;
+        uint64_t  t0 = r.rxNode->timeNs();
+        r.rx->loop();
+        r.busyRxNs += busyPart(t0, r.rxNode->timeNs(), false);
+    });
+
+    Sim sim;
+    sim.setSpinQuantum(1000);
+    sim.add(espNode);
+    sim.add(tinyNode);
+
+    // Done when every frame is out and the last one is settled
+    uint64_t timeoutNs = (uint64_t)frames * (r.gapMs + 1000) * 1000000ULL * 8;
+    sim.runUntil([]() {
+        BenchRun& r = *run_;
+        if (r.sent < r.frames) return false;
+        if (r.ack) return !r.tx->txPending();
+        return !r.awaiting ||
+               (r.txNode->timeNs() - r.awaitSinceNs) / 1000000 >= r.gapMs;
+    }, timeoutNs, 1000000ULL);
+
+    // The receiver sends its ACK before the callback runs; let the last
+    // frame reach the callback, but keep it out of the measured time
+    uint64_t endNs = sim.now();
+    sim.run((uint64_t)r.gapMs * 1000000ULL);
+
+    BenchResult res;
+    res.sent       = r.sent;
+    res.delivered  = r.delivered;
+    res.duplicates = r.duplicates;
+    res.corrupt    = r.corrupt;
+    res.acked      = r.acked;
+    res.seconds    = endNs / 1e9;
+    res.goodputBps = (double)r.delivered * c.payload / res.seconds;
+    res.fps        = r.delivered / res.seconds;
+    res.latP50     = percentile(r.latUs, 50);
+    res.latP90     = percentile(r.latUs, 90);
+    res.latP99     = percentile(r.latUs, 99);
+    res.rttP50     = percentile(r.rttUs, 50);
+    res.rttP99     = percentile(r.rttUs, 99);
+    res.cpuTx      = 100.0 * r.busyTxNs / (double)sim.now();
+    res.cpuRx      = 100.0 * r.busyRxNs / (double)sim.now();
+
+    run_ = nullptr;
+    return res;
+}
+
+/* ---------------- output ---------------- */
+
+static void printCsvHeader(FILE* f) {
+    fprintf(f, "quality,payload,ack,ber,fec,sent,delivered,duplicates,corrupt,acked,"
+               "seconds,goodput_Bps,fps,lat_p50_us,lat_p90_us,lat_p99_us,"
+               "ack_rtt_p50_us,ack_rtt_p99_us,cpu_tx_pct,cpu_rx_pct\n");
+}
+
+static void printCsv(FILE* f, const BenchCase& c, const BenchResult& r) {
+    fprintf(f, "%u,%u,%d,%g,%d,%u,%u,%u,%u,%u,%.3f,%.1f,%.2f,%u,%u,%u,%u,%u,%.1f,%.1f\n",
+            c.quality, c.payload, c.ack, c.ber, c.fec,
+            r.sent, r.delivered, r.duplicates, r.corrupt, r.acked,
+            r.seconds, r.goodputBps, r.fps, r.latP50, r.latP90, r.latP99,
+            r.rttP50, r.rttP99, r.cpuTx, r.cpuRx);
+}
+
+static void printJson(FILE* f, const BenchCase& c, const BenchResult& r, bool first) {
+    fprintf(f, "%s  {\"quality\": %u, \"payload\": %u, \"ack\": %s, \"ber\": %g, \"fec\": %s, "
+               "\"sent\": %u, \"delivered\": %u, \"duplicates\": %u, \"corrupt\": %u, \"acked\": %u, "
+               "\"seconds\": %.3f, \"goodput_Bps\": %.1f, \"fps\": %.2f, "
+               "\"lat_us\": {\"p50\": %u, \"p90\": %u, \"p99\": %u}, "
+               "\"ack_rtt_us\": {\"p50\": %u, \"p99\": %u}, "
+               "\"cpu_tx_pct\": %.1f, \"cpu_rx_pct\": %.1f}",
+            first ? "" : ",\n",
+            c.quality, c.payload, c.ack ? "true" : "false", c.ber, c.fec ? "true" : "false",
+            r.sent, r.delivered, r.duplicates, r.corrupt, r.acked,
+            r.seconds, r.goodputBps, r.fps, r.latP50, r.latP90, r.latP99,
+            r.rttP50, r.rttP99, r.cpuTx, r.cpuRx);
+}
+
+/* ---------------- main ---------------- */
+
+int main(int argc, char** argv) {
+    bool        json     = false;
+    bool        allSizes = false;
+    bool        withFec  = false;
+    uint32_t    frames   = 20;
+    int         onlyQ    = 0;
+    const char* outPath  = nullptr;
+    std::vector<double> bers;
+
+    for (int i = 1; i < argc; i++) {
+        if      (!strcmp(argv[i], "--json"))                json = true;
+        else if (!strcmp(argv[i], "--csv"))                 json = false;
+        else if (!strcmp(argv[i], "--all-sizes"))           allSizes = true;
+        else if (!strcmp(argv[i], "--fec"))                 withFec = true;
+        else if (!strcmp(argv[i], "--frames")  && i + 1 < argc) frames = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--quality") && i + 1 < argc) onlyQ  = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--out")     && i + 1 < argc) outPath = argv[++i];
+        else if (!strcmp(argv[i], "--ber")     && i + 1 < argc) bers.push_back(atof(argv[++i]));
+        else {
+            fprintf(stderr, "usage: %s [--csv|--json] [--frames N] [--all-sizes] "
+                            "[--fec] [--quality Q] [--ber B]... [--out file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (frames < 1)   frames = 1;
+    if (frames > 250) frames = 250;     // msgId space for the duplicate bookkeeping
+
+    FILE* out = outPath ? fopen(outPath, "w") : stdout;
+    if (!out) { perror(outPath); return 1; }
+
+    static const uint8_t sizes[] = { 0, 1, 4, 8, 12, 16 };
+    if (bers.empty()) bers = { 0, 1e-4, 1e-3 };
+
+    std::vector<uint8_t> payloads;
+    if (allSizes) { for (uint8_t p = 0; p <= BUTCOM_MAX_PAYLOAD; p++) payloads.push_back(p); }
+    else          { for (uint8_t p : sizes) if (p <= BUTCOM_MAX_PAYLOAD) payloads.push_back(p); }
+
+    if (json) fprintf(out, "[\n");
+    else      printCsvHeader(out);
+
+    bool     first = true;
+    uint32_t seed  = 1;
+    for (int fec = 0; fec <= (withFec ? 1 : 0); fec++)
+    for (uint8_t q = 1; q <= 4; q++) {
+        if (onlyQ && q != onlyQ) continue;
+        for (uint8_t p : payloads)
+        for (int ack = 0; ack <= 1; ack++)
+        for (double ber : bers) {
+            BenchCase c = { q, p, ack != 0, ber, fec != 0 };
+            BenchResult r = runCase(c, frames, seed++);
+            if (json) printJson(out, c, r, first);
+            else      printCsv(out, c, r);
+            first = false;
+            fflush(out);
+        }
+    }
+
+    if (json) fprintf(out, "\n]\n");
+    if (outPath) fclose(out);
+    return 0;
+}
@@ -0,0 +1,391 @@
+/* ============================================================
+   bench_rtos - ButComRtos multi-producer benchmark (host)
+   ------------------------------------------------------------
+   ESP32-C3 under SimRtos: ButComRtos service task (priority 5,
+   interrupt receiver) and N producer tasks (priority 3) that
+   all call rtos.send() with 8-byte frames, ACK requested. The
+   ATtiny85 receives on the polling receiver. Status frames
+   from the ATtiny go to a consumer task (priority 4) through
+   rtos.receive().
+
+   For every combination of
+
+     producers       1, 2, 4, 8
+     load            paced (N frames / N x 100 ms, ~70 % of the
+                     link at quality 1) or saturating (send in
+                     a loop, blocking on the full TX queue)
+
+   plus one RX row (no producers, a status frame every 100 ms)
+   it reports
+
+     fps             frames delivered per second
+     lat_p50/99/max  send() call -> ATtiny callback (µs), queue
+                     wait included
+     block_p99       time a producer spent inside send() (µs),
+                     preemption by the service task included
+     order_errors    frames of one producer delivered out of
+                     order or lost (0 unless --status)
+     cpu_svc/prod    % of the ESP32 CPU in the service task and
+                     the producers, cpu_idle; an ISR is charged
+                     to whatever it interrupted
+     switches_ps     context switches per second
+     rx_lat_p50/99   ATtiny send() -> consumer receive() (µs)
+
+   --status adds a status frame every 500 ms to the TX rows.
+   The protocol has no arbitration: after an ACK both ends
+   may start a frame at once, and the colliding frames retry
+   in lockstep, so expect losses there.
+
+   usage: bench_rtos [--csv] [--seconds S] [--quality Q]
+                     [--status] [--out file]
+   ============================================================ */
+
+#include "ButComSim.h"
+#include "SimRtos.h"
+#include "ButCom.h"
+#include "ButComRtos.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define DATA_PIN      2
+#define FRAME_LEN     8
+#define MAX_PRODUCERS 8
+
+struct RtosCase {
+    uint8_t  producers;
+    bool     saturate;
+    uint16_t statusMs;              // ATtiny status frames, 0 = off
+};
+
+struct RtosResult {
+    uint32_t enqueued;
+    uint32_t delivered;
+    uint32_t orderErrors;
+    uint32_t duplicates;
+    double   fps;
+    uint32_t latP50, latP99, latMax;
+    uint32_t blockP99;
+    double   cpuSvc, cpuProd, cpuIdle;
+    double   switchesPs;
+    uint32_t statusSent, statusReceived;
+    uint32_t rxLatP50, rxLatP99;
+};
+
+/* ---------------- one run ---------------- */
+
+struct Producer {
+    uint8_t               id;
+    TaskHandle_t          task;
+    std::vector<uint64_t> enqNs;     // by sequence number
+    int32_t               lastSeq;   // last delivered
+};
+
+// State of the running case (tasks and callbacks are plain functions)
+struct RtosRun {
+    ButCom*     esp;
+    ButCom*     tiny;
+    ButComRtos* rtos;
+    SimNode*    espNode;
+    SimNode*    tinyNode;
+
+    uint8_t     producers;
+    bool        saturate;
+    bool        stop;
+    uint16_t    statusMs;
+    Producer    prod[MAX_PRODUCERS];
+
+    uint32_t    delivered, deliveredInWindow, orderErrors, duplicates;
+    uint64_t    windowEndNs;
+    std::vector<uint32_t> latUs, blockUs;
+
+    uint16_t    statusSeq;
+    uint32_t    lastStatusMs;
+    std::vector<uint64_t> statusSentNs;
+    uint32_t    statusReceived;
+    std::vector<uint32_t> rxLatUs;
+};
+
+static RtosRun* run_;
+
+static uint8_t patternByte(uint8_t p, uint16_t seq, uint8_t i) {
+    return (uint8_t)(p * 31 + seq * 7 + i * 3 + 1);
+}
+
+static void producerTask(void* arg) {
+    RtosRun&  r = *run_;
+    Producer& p = *static_cast<Producer*>(arg);
+
+    // setup() runs at priority 1: let it create every producer first.
+    // Paced producers start spread over one period.
+    TickType_t period = pdMS_TO_TICKS(100) * r.producers;
+    vTaskDelay(r.saturate ? 1 : period * p.id / r.producers + 1);
+
+    TickType_t last = xTaskGetTickCount();
+    while (!r.stop) {
+        uint16_t seq = (uint16_t)p.enqNs.size();
+        uint8_t  buf[FRAME_LEN];
+        buf[0] = p.id;
+        buf[1] = (uint8_t)seq;
+        buf[2] = (uint8_t)(seq >> 8);
+        for (uint8_t i = 3; i < FRAME_LEN; i++) buf[i] = patternByte(p.id, seq, i);
+
+        uint64_t t0 = r.espNode->timeNs();
+        p.enqNs.push_back(t0);
+        r.rtos->send(buf, FRAME_LEN, true, portMAX_DELAY);
+        r.blockUs.push_back((uint32_t)((r.espNode->timeNs() - t0) / 1000));
+
+        if (!r.saturate) {
+            // vTaskDelayUntil() by hand: the shim has no xTaskDelayUntil
+            last += period;
+            TickType_t now = xTaskGetTickCount();
+            if ((int32_t)(last - now) > 0) vTaskDelay(last - now);
+            else                           last = now;
+        }
+    }
+    vTaskDelete(nullptr);
+}
+
+static void consumerTask(void*) {
+    RtosRun& r = *run_;
+    ButComRtosFrame f;
+
+    for (;;) {
+        if (!r.rtos->receive(f, portMAX_DELAY)) continue;
+        if (f.type != BUTCOM_MSG_DATA || f.length != 2) continue;
+
+        uint16_t seq = (uint16_t)(f.payload[0] | (f.payload[1] << 8));
+        if (seq >= r.statusSentNs.size()) continue;
+        r.statusReceived++;
+        r.rxLatUs.push_back((uint32_t)((r.espNode->timeNs() - r.statusSentNs[seq]) / 1000));
+    }
+}
+
+static void onEspMessage(uint8_t msgId, uint8_t type, const uint8_t* data, uint8_t len) {
+    run_->rtos->handleMessage(msgId, type, data, len);
+}
+
+static void onEspEdge() { run_->rtos->wakeFromIsr(); }
+
+static void onTinyMessage(uint8_t, uint8_t type, const uint8_t* data, uint8_t len) {
+    RtosRun& r = *run_;
+    if (type != BUTCOM_MSG_DATA || len != FRAME_LEN || data[0] >= r.producers) return;
+
+    Producer& p   = r.prod[data[0]];
+    uint16_t  seq = (uint16_t)(data[1] | (data[2] << 8));
+    for (uint8_t i = 3; i < FRAME_LEN; i++)
+        if (data[i] != patternByte(p.id, seq, i)) return;
+    if (seq >= p.enqNs.size()) return;
+
+    // Lost ACK: the retry arrives a second time
+    if ((int32_t)seq <= p.lastSeq) { r.duplicates++; return; }
+    if ((int32_t)seq != p.lastSeq + 1) r.orderErrors++;
+    p.lastSeq = seq;
+
+    uint64_t now = r.tinyNode->timeNs();
+    r.delivered++;
+    if (now <= r.windowEndNs) r.deliveredInWindow++;
+    r.latUs.push_back((uint32_t)((now - p.enqNs[seq]) / 1000));
+}
+
+static uint32_t percentile(std::vector<uint32_t>& v, uint32_t p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = ((v.size() - 1) * p + 50) / 100;
+    return v[i];
+}
+
+static RtosResult runCase(const RtosCase& c, uint8_t quality, uint32_t seconds) {
+    SimWire    wire;
+    SimNode    espNode("esp32", SimCosts::esp32c3());
+    SimNode    tinyNode("attiny85", SimCosts::attiny85());
+    SimRtos    kernel(espNode);
+    ButCom     esp(DATA_PIN, true,  0x20);
+    ButCom     tiny(DATA_PIN, false, 0x10);
+    ButComRtos rtos(esp);
+
+    RtosRun r{};
+    r.esp         = &esp;
+    r.tiny        = &tiny;
+    r.rtos        = &rtos;
+    r.espNode     = &espNode;
+    r.tinyNode    = &tinyNode;
+    r.producers   = c.producers;
+    r.saturate    = c.saturate;
+    r.statusMs    = c.statusMs;
+    r.windowEndNs = (uint64_t)seconds * 1000000000ULL;
+    for (uint8_t i = 0; i < MAX_PRODUCERS; i++) {
+        r.prod[i].id      = i;
+        r.prod[i].lastSeq = -1;
+    }
+    run_ = &r;
+
+    espNode.attach(DATA_PIN, wire);
+    tinyNode.attach(DATA_PIN, wire);
+
+    espNode.setSetup([quality]() {
+        RtosRun& r = *run_;
+        r.esp->setCallback(onEspMessage);
+        r.esp->setSpeedQuality(quality);
+        r.esp->setHelloInterval(0);
+        r.esp->begin(false);
+        r.esp->setAsyncRx(true, onEspEdge);
+        r.rtos->begin();
+
+        static const char* names[MAX_PRODUCERS] = {
+            "prod0", "prod1", "prod2", "prod3", "prod4", "prod5", "prod6", "prod7"
+        };
+        for (uint8_t i = 0; i < r.producers; i++)
+            xTaskCreate(producerTask, names[i], 2048, &r.prod[i], 3, &r.prod[i].task);
+        if (r.statusMs) xTaskCreate(consumerTask, "consumer", 2048, nullptr, 4, nullptr);
+    });
+    espNode.setLoop([]() { vTaskDelay(portMAX_DELAY); });
+
+    tinyNode.setSetup([quality]() {
+        RtosRun& r = *run_;
+        r.tiny->setCallback(onTinyMessage);
+        r.tiny->setSpeedQuality(quality);
+        r.tiny->setHelloInterval(0);
+        r.tiny->begin(false);
+    });
+    tinyNode.setLoop([]() {
+        RtosRun& r = *run_;
+        r.tiny->loop();
+
+        uint32_t now = millis();
+        if (!r.statusMs || r.stop || r.tiny->txPending() || now - r.lastStatusMs < r.statusMs) return;
+        r.lastStatusMs = now;
+
+        uint8_t p[2] = { (uint8_t)r.statusSeq, (uint8_t)(r.statusSeq >> 8) };
+        r.statusSentNs.push_back(r.tinyNode->timeNs());
+        r.statusSeq++;
+        r.tiny->send(p, sizeof(p), true);
+    });
+
+    Sim sim;
+    sim.setSpinQuantum(1000);
+    sim.add(espNode);
+    sim.add(tinyNode);
+    sim.run(r.windowEndNs);
+
+    uint64_t svcNs  = kernel.runNs(rtos.task());
+    uint64_t prodNs = 0;
+    for (uint8_t i = 0; i < c.producers; i++) prodNs += kernel.runNs(r.prod[i].task);
+    uint64_t idleNs   = kernel.idleNs();
+    uint64_t switches = kernel.contextSwitches();
+
+    // Stop the producers and let the queued frames drain
+    r.stop = true;
+    uint32_t enqueued = 0;
+    for (uint8_t i = 0; i < c.producers; i++) enqueued += (uint32_t)r.prod[i].enqNs.size();
+    sim.runUntil([enqueued]() { return run_->delivered >= enqueued; },
+                 60ULL * 1000000000ULL, 1000000ULL);
+
+    // Frames sent but never delivered count as order errors too
+    for (uint8_t i = 0; i < c.producers; i++)
+        r.orderErrors += (uint32_t)(r.prod[i].enqNs.size() - 1 - r.prod[i].lastSeq);
+
+    double window = r.windowEndNs / 1e9;
+
+    RtosResult res;
+    res.enqueued       = enqueued;
+    res.delivered      = r.delivered;
+    res.orderErrors    = r.orderErrors;
+    res.duplicates     = r.duplicates;
+    res.fps            = r.deliveredInWindow / window;
+    res.latP50         = percentile(r.latUs, 50);
+    res.latP99         = percentile(r.latUs, 99);
+    res.latMax         = r.latUs.empty() ? 0 : r.latUs.back();
+    res.blockP99       = percentile(r.blockUs, 99);
+    res.cpuSvc         = 100.0 * svcNs  / (double)r.windowEndNs;
+    res.cpuProd        = 100.0 * prodNs / (double)r.windowEndNs;
+    res.cpuIdle        = 100.0 * idleNs / (double)r.windowEndNs;
+    res.switchesPs     = switches / window;
+    res.statusSent     = (uint32_t)r.statusSentNs.size();
+    res.statusReceived = r.statusReceived;
+    res.rxLatP50       = percentile(r.rxLatUs, 50);
+    res.rxLatP99       = percentile(r.rxLatUs, 99);
+
+    run_ = nullptr;
+    return res;
+}
+
+/* ---------------- output ---------------- */
+
+static void printHeader(FILE* f, bool csv) {
+    if (csv) {
+        fprintf(f, "producers,load,enqueued,delivered,order_errors,duplicates,fps,"
+                   "lat_p50_us,lat_p99_us,lat_max_us,block_p99_us,"
+                   "cpu_svc_pct,cpu_prod_pct,cpu_idle_pct,switches_ps,"
+                   "status_sent,status_received,rx_lat_p50_us,rx_lat_p99_us\n");
+        return;
+    }
+    fprintf(f, "prod load      enq  deliv err dup    fps   lat_p50   lat_p99   lat_max"
+               "  block_p99  svc%%  prod%%  idle%%  sw/s  status  rx_p50  rx_p99\n");
+}
+
+static void printRow(FILE* f, bool csv, const RtosCase& c, const RtosResult& r) {
+    const char* load = !c.producers ? "rx" : c.saturate ? "saturate" : "paced";
+    if (csv) {
+        fprintf(f, "%u,%s,%u,%u,%u,%u,%.2f,%u,%u,%u,%u,%.1f,%.2f,%.1f,%.0f,%u,%u,%u,%u\n",
+                c.producers, load, r.enqueued, r.delivered, r.orderErrors, r.duplicates,
+                r.fps, r.latP50, r.latP99, r.latMax, r.blockP99,
+                r.cpuSvc, r.cpuProd, r.cpuIdle, r.switchesPs,
+                r.statusSent, r.statusReceived, r.rxLatP50, r.rxLatP99);
+        return;
+    }
+    fprintf(f, "%4u %-8s %5u %6u %3u %3u %6.2f %9u %9u %9u %10u %5.1f %6.2f %6.1f %5.0f %3u/%-3u %7u %7u\n",
+            c.producers, load, r.enqueued, r.delivered, r.orderErrors, r.duplicates,
+            r.fps, r.latP50, r.latP99, r.latMax, r.blockP99,
+            r.cpuSvc, r.cpuProd, r.cpuIdle, r.switchesPs,
+            r.statusReceived, r.statusSent, r.rxLatP50, r.rxLatP99);
+}
+
+/* ---------------- main ---------------- */
+
+int main(int argc, char** argv) {
+    bool        csv     = false;
+    bool        status  = false;
+    uint32_t    seconds = 20;
+    int         quality = 1;
+    const char* outPath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if      (!strcmp(argv[i], "--csv"))                     csv = true;
+        else if (!strcmp(argv[i], "--status"))                  status = true;
+        else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--quality") && i + 1 < argc) quality = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--out")     && i + 1 < argc) outPath = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--csv] [--seconds S] [--quality Q] "
+                            "[--status] [--out file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (seconds < 1) seconds = 1;
+    if (quality < 1 || quality > 4) quality = 1;
+
+    FILE* out = outPath ? fopen(outPath, "w") : stdout;
+    if (!out) { perror(outPath); return 1; }
+
+    static const uint8_t producers[] = { 1, 2, 4, 8 };
+
+    printHeader(out, csv);
+    for (int saturate = 0; saturate <= 1; saturate++)
+    for (uint8_t n : producers) {
+        RtosCase   c = { n, saturate != 0, (uint16_t)(status ? 500 : 0) };
+        RtosResult r = runCase(c, (uint8_t)quality, seconds);
+        printRow(out, csv, c, r);
+        fflush(out);
+    }
+
+    RtosCase   rx = { 0, false, 100 };
+    RtosResult r  = runCase(rx, (uint8_t)quality, seconds);
+    printRow(out, csv, rx, r);
+
+    if (outPath) fclose(out);
+    return 0;
+}
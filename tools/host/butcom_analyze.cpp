@@ -0,0 +1,859 @@
+/* ============================================================
+   butcom_analyze - Decode ButCom traffic from logic captures
+   ------------------------------------------------------------
+   Reads sigrok / PulseView exports:
+     - CSV     (sigrok-cli -O csv, PulseView "Export as CSV"),
+               with or without a time column
+     - binary  (sigrok-cli -O binary): raw samples, unitsize
+               bytes each; needs --rate
+
+   The file is memory-mapped and read once, front to back, so
+   multi-gigabyte captures stream at disk/page-cache speed.
+
+   Bytes are decoded with the rules of ButComPhy::receiveByte():
+   falling edge, glitch check after halfBit/2, samples at
+   edge + 1.5 bit + i * bit. Frames are reassembled as in
+   ButCom::handleFrameByte() (PROTOCOL.md), but instead of
+   silently dropping bad frames every error is reported.
+
+   usage: butcom_analyze [options] capture.{csv,bin}
+   ============================================================ */
+
+#include "ButCom.h"
+#include "ButComFec.h"
+
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* ============================================================
+   Capture sources: level changes (edges) in time order
+   ============================================================ */
+
+// LEN is one byte, so a frame carries at most 252 payload bytes. The
+// analyzer decodes any instance size, not only BUTCOM_MAX_PAYLOAD.
+#define ANALYZE_MAX_PAYLOAD (255 - 3)
+
+struct Edge {
+    uint64_t tNs;
+    bool     level;
+};
+
+class EdgeSource {
+public:
+    virtual ~EdgeSource() {}
+    virtual bool next(Edge& e) = 0;     // next level change, false at end
+
+    bool     initialLevel = true;
+    uint64_t endNs = 0;                 // valid once next() returned false
+};
+
+// Raw samples (sigrok "binary" output): unitsize bytes per sample,
+// channel N is bit N%8 of byte N/8.
+class BinarySource : public EdgeSource {
+public:
+    BinarySource(const uint8_t* data, size_t size, uint8_t unitSize,
+                 uint8_t channel, double rateHz)
+        : _p(data + channel / 8), _unit(unitSize),
+          _mask((uint8_t)(1 << (channel % 8))),
+          _n(size / unitSize), _i(0), _nsPerSample(1e9 / rateHz)
+    {
+        initialLevel = _n ? (_p[0] & _mask) != 0 : true;
+        _level = initialLevel;
+    }
+
+    bool next(Edge& e) override {
+        size_t i = _i;
+
+        if (_unit == 1) {
+            // 8 samples per step while the channel bit does not change
+            uint64_t lanes = 0x0101010101010101ULL * _mask;
+            uint64_t want  = _level ? lanes : 0;
+            while (i + 8 <= _n) {
+                uint64_t w;
+                memcpy(&w, _p + i, 8);
+                if ((w & lanes) != want) break;
+                i += 8;
+            }
+        }
+        while (i < _n && ((_p[i * _unit] & _mask) != 0) == _level) i++;
+
+        if (i >= _n) {
+            _i    = _n;
+            endNs = (uint64_t)(_n * _nsPerSample);
+            return false;
+        }
+
+        _level  = !_level;
+        _i      = i + 1;
+        e.tNs   = (uint64_t)(i * _nsPerSample);
+        e.level = _level;
+        return true;
+    }
+
+private:
+    const uint8_t* _p;
+    uint8_t        _unit;
+    uint8_t        _mask;
+    size_t         _n;
+    size_t         _i;
+    double         _nsPerSample;
+    bool           _level;
+};
+
+// sigrok CSV: ';' comment lines (one holds the samplerate), a header
+// line with the column names, then one line per sample. A first column
+// named "Time ..." carries the timestamp; otherwise the line number
+// and the samplerate give the time.
+class CsvSource : public EdgeSource {
+public:
+    CsvSource(const char* data, size_t size)
+        : _p(data), _end(data + size), _timeCol(-1), _chanCol(-1),
+          _rateHz(0), _timeScale(1e9), _sample(0), _lastNs(0), _level(true) {}
+
+    // Parses comments and header; channel is a column name ("D0") or a
+    // logic channel number. Returns an error text or nullptr.
+    const char* open(const char* channel, double rateOverride) {
+        std::vector<std::string> cols;
+
+        while (_p < _end) {
+            const char* eol = lineEnd(_p);
+            if (*_p == ';') {
+                const char* s = strstr_n(_p, eol, "Samplerate:");
+                if (s) _rateHz = parseRate(s + 11, eol);
+            } else if (eol > _p) {
+                if (isdigit((unsigned char)*_p) || *_p == '-' || *_p == '.') break;   // data, no header
+                splitColumns(_p, eol, cols);
+                _p = eol + (eol < _end);
+                break;
+            }
+            _p = eol + (eol < _end);
+        }
+        if (rateOverride > 0) _rateHz = rateOverride;
+
+        // Column layout
+        int logicIdx = 0;
+        int wanted   = -1;
+        if (channel && isdigit((unsigned char)channel[0])) wanted = atoi(channel);
+
+        for (size_t c = 0; c < cols.size(); c++) {
+            const std::string& n = cols[c];
+            if (c == 0 && (n.compare(0, 4, "Time") == 0 || n.compare(0, 4, "time") == 0)) {
+                _timeCol   = 0;
+                _timeScale = timeUnitScale(n);
+                continue;
+            }
+            bool match = channel ? (wanted >= 0 ? logicIdx == wanted : n == channel)
+                                 : _chanCol < 0;
+            if (match && _chanCol < 0) _chanCol = (int)c;
+            logicIdx++;
+        }
+        if (cols.empty()) _chanCol = (wanted >= 0) ? wanted : 0;   // headerless: plain columns
+
+        if (_chanCol < 0)              return "channel not found in CSV header";
+        if (_timeCol < 0 && _rateHz <= 0) return "no time column and no samplerate, use --rate";
+
+        // Level of the first sample
+        uint64_t t;
+        bool level;
+        const char* save = _p;
+        if (readLine(t, level)) initialLevel = level;
+        _p = save;
+        _sample = 0;
+        _level  = initialLevel;
+        return nullptr;
+    }
+
+    double rateHz() const { return _rateHz; }
+
+    bool next(Edge& e) override {
+        uint64_t t;
+        bool level;
+        while (readLine(t, level)) {
+            _lastNs = t;
+            if (level != _level) {
+                _level  = level;
+                e.tNs   = t;
+                e.level = level;
+                return true;
+            }
+        }
+        endNs = _lastNs;
+        return false;
+    }
+
+private:
+    const char* lineEnd(const char* p) const {
+        const char* e = (const char*)memchr(p, '\n', _end - p);
+        return e ? e : _end;
+    }
+
+    static const char* strstr_n(const char* p, const char* end, const char* needle) {
+        size_t n = strlen(needle);
+        for (; p + n <= end; p++)
+            if (!memcmp(p, needle, n)) return p;
+        return nullptr;
+    }
+
+    static double parseRate(const char* p, const char* end) {
+        std::string s(p, end);
+        char* unit;
+        double v = strtod(s.c_str(), &unit);
+        while (*unit == ' ') unit++;
+        if (*unit == 'k') v *= 1e3;
+        if (*unit == 'M') v *= 1e6;
+        if (*unit == 'G') v *= 1e9;
+        return v;
+    }
+
+    static double timeUnitScale(const std::string& name) {
+        if (name.find("[ns]") != std::string::npos) return 1;
+        if (name.find("[us]") != std::string::npos ||
+            name.find("[\xC2\xB5s]") != std::string::npos) return 1e3;
+        if (name.find("[ms]") != std::string::npos) return 1e6;
+        return 1e9;
+    }
+
+    static void splitColumns(const char* p, const char* end, std::vector<std::string>& out) {
+        while (p <= end) {
+            const char* c = (const char*)memchr(p, ',', end - p);
+            if (!c) c = end;
+            std::string s(p, c);
+            while (!s.empty() && (s.back() == '\r' || s.back() == ' ')) s.pop_back();
+            while (!s.empty() && s[0] == ' ') s.erase(0, 1);
+            out.push_back(s);
+            p = c + 1;
+        }
+    }
+
+    // One data line → timestamp and channel level
+    bool readLine(uint64_t& tNs, bool& level) {
+        while (_p < _end) {
+            const char* eol = lineEnd(_p);
+            const char* p   = _p;
+            _p = eol + (eol < _end);
+            if (eol == p || *p == ';' || *p == '\r') continue;
+
+            const char* field = p;
+            for (int c = 0; c < _chanCol && field < eol; c++) {
+                const char* comma = (const char*)memchr(field, ',', eol - field);
+                field = comma ? comma + 1 : eol;
+            }
+            if (field >= eol) continue;
+            while (*field == ' ') field++;
+            level = (*field == '1');
+
+            if (_timeCol == 0) tNs = (uint64_t)(strtod(p, nullptr) * _timeScale);
+            else               tNs = (uint64_t)(_sample * (1e9 / _rateHz));
+            _sample++;
+            return true;
+        }
+        return false;
+    }
+
+    const char* _p;
+    const char* _end;
+    int         _timeCol;
+    int         _chanCol;
+    double      _rateHz;
+    double      _timeScale;
+    uint64_t    _sample;
+    uint64_t    _lastNs;
+    bool        _level;
+};
+
+// Buffers the first edges so the bit time can be estimated before
+// decoding starts, then replays them.
+class PrefetchSource : public EdgeSource {
+public:
+    PrefetchSource(EdgeSource& src, size_t count) : _src(src), _pos(0), _eof(false) {
+        initialLevel = src.initialLevel;
+        Edge e;
+        while (_edges.size() < count) {
+            if (!_src.next(e)) { _eof = true; endNs = _src.endNs; break; }
+            _edges.push_back(e);
+        }
+    }
+
+    const std::vector<Edge>& edges() const { return _edges; }
+
+    bool next(Edge& e) override {
+        if (_pos < _edges.size()) { e = _edges[_pos++]; return true; }
+        if (_eof) return false;
+        if (_src.next(e)) return true;
+        _eof  = true;
+        endNs = _src.endNs;
+        return false;
+    }
+
+private:
+    EdgeSource&       _src;
+    std::vector<Edge> _edges;
+    size_t            _pos;
+    bool              _eof;
+};
+
+/* ============================================================
+   Byte decoder - ButComPhy::receiveByte() on an edge stream
+   ============================================================ */
+
+struct RxByte {
+    uint64_t startNs;       // falling edge of the start bit
+    uint64_t endNs;         // end of the stop bit
+    uint8_t  value;
+};
+
+class ByteDecoder {
+public:
+    ByteDecoder(EdgeSource& src, uint32_t bitUs)
+        : _src(src), _level(src.initialLevel), _haveNext(false),
+          _t(0), _falseStarts(0)
+    {
+        _bitNs      = (uint64_t)bitUs * 1000;
+        _halfBitNs  = (uint64_t)(bitUs / 2) * 1000;
+        _glitchNs   = (uint64_t)(bitUs / 2 / 2) * 1000;
+        fetch();
+    }
+
+    bool read(RxByte& out) {
+        while (true) {
+            // Wait until line is HIGH, then for the falling edge
+            if (!levelAt(_t) && !nextChange(_t)) return false;
+            if (!nextChange(_t)) return false;
+            uint64_t edge = _t;
+
+            // Glitch filter
+            uint64_t check = edge + _glitchNs;
+            if (!covered(check)) return false;
+            if (levelAt(check)) {
+                _falseStarts++;
+                _t = check;
+                continue;
+            }
+
+            uint64_t sample = edge + _bitNs + _halfBitNs;
+            uint8_t  value  = 0;
+            for (uint8_t i = 0; i < 8; i++) {
+                if (!covered(sample)) return false;
+                if (levelAt(sample)) value |= (uint8_t)(1 << i);
+                sample += _bitNs;
+            }
+            _t = sample - _bitNs;
+
+            out.startNs = edge;
+            out.endNs   = edge + 10 * _bitNs;
+            out.value   = value;
+            return true;
+        }
+    }
+
+    uint64_t falseStarts() const { return _falseStarts; }
+    uint64_t endNs() const       { return _src.endNs; }
+
+private:
+    void fetch() {
+        _haveNext = _src.next(_next);
+    }
+
+    bool levelAt(uint64_t t) {
+        while (_haveNext && _next.tNs <= t) {
+            _level = _next.level;
+            fetch();
+        }
+        return _level;
+    }
+
+    // Advance _t to the next level change; false at end of capture
+    bool nextChange(uint64_t& t) {
+        levelAt(t);
+        if (!_haveNext) return false;
+        t = _next.tNs;
+        levelAt(t);
+        return true;
+    }
+
+    bool covered(uint64_t t) {
+        return _haveNext || t <= _src.endNs;
+    }
+
+    EdgeSource& _src;
+    bool        _level;
+    Edge        _next;
+    bool        _haveNext;
+    uint64_t    _t;
+    uint64_t    _bitNs;
+    uint64_t    _halfBitNs;
+    uint64_t    _glitchNs;
+    uint64_t    _falseStarts;
+};
+
+/* ============================================================
+   Frame reassembly and link statistics
+   ============================================================ */
+
+struct Frame {
+    uint64_t startNs;
+    uint64_t endNs;
+    uint8_t  len;
+    uint8_t  type;
+    uint8_t  msgId;
+    uint8_t  payload[ANALYZE_MAX_PAYLOAD];
+    uint8_t  payLen;
+    bool     crcOk;
+    bool     typeOk;
+};
+
+struct Stat {
+    uint64_t n = 0;
+    double   sum = 0, min = 0, max = 0;
+
+    void add(double v) {
+        if (!n || v < min) min = v;
+        if (!n || v > max) max = v;
+        sum += v;
+        n++;
+    }
+    void print(const char* name, const char* unit) const {
+        if (!n) { printf("  %-22s -\n", name); return; }
+        printf("  %-22s min %.2f  avg %.2f  max %.2f %s  (n=%llu)\n",
+               name, min, sum / n, max, unit, (unsigned long long)n);
+    }
+};
+
+struct Options {
+    const char* path       = nullptr;
+    const char* format     = nullptr;     // "csv" / "bin", default from extension
+    const char* channel    = nullptr;
+    double      rateHz     = 0;
+    uint8_t     unitSize   = 1;
+    uint32_t    bitUs      = 0;           // 0 = auto
+    bool        fec        = false;
+    bool        quiet      = false;
+    bool        csv        = false;
+    uint32_t    retryWindowMs = 1000;
+};
+
+class FrameAnalyzer {
+public:
+    FrameAnalyzer(const Options& o, uint32_t bitUs)
+        : _o(o), _state(WAIT_START), _haveLow(false), _prevEndNs(0),
+          _haveFrame(false), _lastByteNs(0)
+    {
+        // Same inter-byte limit as ButCom::setSpeedQuality()
+        uint64_t ms = (39ULL * bitUs) / 1000 + 1;
+        _byteTimeoutNs = (o.fec ? 2 : 1) * ms * 1000000ULL;
+        memset(_typeCount, 0, sizeof(_typeCount));
+    }
+
+    void onByte(const RxByte& b) {
+        bytes++;
+
+        if (_state != WAIT_START && b.startNs - _lastByteNs > _byteTimeoutNs) {
+            error(_cur.startNs, "truncated", "no byte for %.1f ms after %u of %u body bytes",
+                  (b.startNs - _lastByteNs) / 1e6, _index, _cur.len);
+            truncated++;
+            _state = WAIT_START;
+        }
+        _lastByteNs = b.startNs;
+
+        if (!_o.fec || _state == WAIT_START) {
+            frameByte(b, b.value);
+            return;
+        }
+
+        uint8_t nibble = butcom_fec_decode(b.value);
+        if (nibble == BUTCOM_FEC_INVALID) {
+            error(_cur.startNs, "fec", "uncorrectable code byte 0x%02X", b.value);
+            fecErrors++;
+            _state   = WAIT_START;
+            _haveLow = false;
+            return;
+        }
+        if (nibble & BUTCOM_FEC_CORRECTED) fecCorrections++;
+        nibble &= 0x0F;
+        if (!_haveLow) { _low = nibble; _haveLow = true; return; }
+        _haveLow = false;
+        frameByte(b, (uint8_t)(_low | (nibble << 4)));
+    }
+
+    void finish(uint64_t endNs) {
+        if (_state != WAIT_START) {
+            error(_cur.startNs, "cut off", "capture ends inside a frame");
+            cutOff = true;
+        }
+        for (const Pending& p : _pending) if (!p.acked) unacked++;
+        _captureNs = endNs;
+    }
+
+    void report(double seconds, uint64_t falseStarts) const {
+        printf("\nsummary\n");
+        printf("  capture                %.3f s, %llu bytes decoded, %llu false starts (glitches)\n",
+               _captureNs / 1e9, (unsigned long long)bytes, (unsigned long long)falseStarts);
+        printf("  frames                 %llu ok", (unsigned long long)frames);
+        for (int t = 0; t < 256; t++)
+            if (_typeCount[t]) printf(", %s %llu", typeName((uint8_t)t), (unsigned long long)_typeCount[t]);
+        printf("\n");
+        printf("  errors                 CRC %llu, bad LEN %llu, bad TYPE %llu, truncated %llu",
+               (unsigned long long)crcErrors, (unsigned long long)badLen,
+               (unsigned long long)badType, (unsigned long long)truncated);
+        if (cutOff) printf(" (+1 frame cut off at the end)");
+        if (_o.fec) printf(", FEC uncorrectable %llu, corrected nibbles %llu",
+                           (unsigned long long)fecErrors, (unsigned long long)fecCorrections);
+        printf("\n");
+        printf("  stray bytes            %llu (outside frames)\n", (unsigned long long)stray);
+        printf("  retries                %llu\n", (unsigned long long)retries);
+        printf("  frames without ACK     %llu\n", (unsigned long long)unacked);
+        _ackLatency.print("ACK latency", "ms");
+        _frameTime.print("frame duration", "ms");
+        _idleGap.print("idle gap", "ms");
+        if (_captureNs)
+            printf("  bus busy               %.1f %%\n", 100.0 * _busyNs / _captureNs);
+        printf("  decoded in             %.2f s\n", seconds);
+    }
+
+    uint64_t bytes = 0, frames = 0, crcErrors = 0, badLen = 0, badType = 0;
+    uint64_t truncated = 0, fecErrors = 0, fecCorrections = 0, stray = 0;
+    uint64_t retries = 0, unacked = 0;
+    bool     cutOff = false;
+
+private:
+    enum State { WAIT_START, WAIT_LENGTH, READ_BODY };
+
+    struct Pending {
+        uint64_t endNs;
+        uint8_t  type, msgId, payLen;
+        uint8_t  payload[ANALYZE_MAX_PAYLOAD];
+        bool     acked;
+    };
+
+    void frameByte(const RxByte& b, uint8_t v) {
+        switch (_state) {
+            case WAIT_START:
+                if (v == 0xA5) {
+                    _cur.startNs = b.startNs;
+                    _haveLow     = false;
+                    _state       = WAIT_LENGTH;
+                } else {
+                    stray++;
+                }
+                break;
+
+            case WAIT_LENGTH:
+                _cur.len = v;
+                if (v < 3) {
+                    error(_cur.startNs, "bad LEN", "LEN=%u", v);
+                    badLen++;
+                    _state = WAIT_START;
+                } else {
+                    _index = 0;
+                    _state = READ_BODY;
+                }
+                break;
+
+            case READ_BODY:
+                _body[_index++] = v;
+                if (_index >= _cur.len) {
+                    _cur.endNs = b.endNs;
+                    frameDone();
+                    _state = WAIT_START;
+                }
+                break;
+        }
+    }
+
+    void frameDone() {
+        Frame& f = _cur;
+        f.type   = _body[0];
+        f.msgId  = _body[1];
+        f.payLen = f.len - 3;
+        memcpy(f.payload, &_body[2], f.payLen);
+
+        uint8_t crc = 0;
+        crc = ButCom::crc8_update(crc, f.len);
+        for (uint8_t i = 0; i + 1 < f.len; i++) crc = ButCom::crc8_update(crc, _body[i]);
+        f.crcOk  = (crc == _body[f.len - 1]);
+        f.typeOk = ButCom::frameTypeValid(f.type, f.len);
+
+        if (!f.crcOk)       crcErrors++;
+        else if (!f.typeOk) badType++;
+        else {
+            frames++;
+            _typeCount[f.type]++;
+        }
+
+        double durMs = (f.endNs - f.startNs) / 1e6;
+        double gapMs = _haveFrame ? ((int64_t)(f.startNs - _prevEndNs)) / 1e6 : -1;
+        _frameTime.add(durMs);
+        if (_haveFrame) _idleGap.add(gapMs);
+        _busyNs   += f.endNs - f.startNs;
+        _prevEndNs = f.endNs;
+        _haveFrame = true;
+
+        // ACK matching and retry detection only on intact frames
+        int    retry    = 0;
+        double ackMs    = -1;
+        if (f.crcOk && f.typeOk) {
+            uint64_t window = (uint64_t)_o.retryWindowMs * 1000000ULL;
+            while (!_pending.empty() && f.startNs - _pending.front().endNs > window) {
+                if (!_pending.front().acked) unacked++;
+                _pending.erase(_pending.begin());
+            }
+
+            if (f.type == BUTCOM_MSG_ACK) {
+                for (auto p = _pending.rbegin(); p != _pending.rend(); ++p) {
+                    if (p->msgId == f.msgId && !p->acked) {
+                        p->acked = true;
+                        ackMs = ((int64_t)(f.startNs - p->endNs)) / 1e6;
+                        _ackLatency.add(ackMs);
+                        break;
+                    }
+                }
+            } else if (!(f.type & BUTCOM_TYPE_NO_ACK)) {
+                // ButCom only resends a frame whose ACK did not arrive; an
+                // identical frame after an ACK is new traffic (e.g. an echo)
+                for (const Pending& p : _pending) {
+                    if (p.acked) continue;
+                    if (p.type == f.type && p.msgId == f.msgId && p.payLen == f.payLen &&
+                        !memcmp(p.payload, f.payload, f.payLen))
+                        retry++;
+                }
+                if (retry) retries++;
+                Pending p;
+                p.endNs  = f.endNs;
+                p.type   = f.type;
+                p.msgId  = f.msgId;
+                p.payLen = f.payLen;
+                memcpy(p.payload, f.payload, f.payLen);
+                p.acked  = false;
+                _pending.push_back(p);
+            }
+        }
+
+        if (_o.quiet) return;
+
+        if (_o.csv) {
+            printf("%.6f,%s,%u,%u,", f.startNs / 1e9, typeName(f.type), f.msgId, f.payLen);
+            for (uint8_t i = 0; i < f.payLen; i++) printf("%02X", f.payload[i]);
+            printf(",%s,%.3f,%.3f,%d,%.3f\n", f.crcOk ? (f.typeOk ? "ok" : "type") : "crc",
+                   durMs, gapMs, retry, ackMs);
+            return;
+        }
+
+        char hex[3 * ANALYZE_MAX_PAYLOAD + 1] = "";
+        for (uint8_t i = 0; i < f.payLen; i++) sprintf(hex + 3 * i, "%02X ", f.payload[i]);
+
+        printf("%12.6f  %-8s id=%3u len=%2u  %-48s %7.2f ms", f.startNs / 1e9,
+               typeName(f.type), f.msgId, f.payLen, hex, durMs);
+        if (gapMs >= 0) printf("  gap %8.2f ms", gapMs);
+        if (!f.crcOk)        printf("  CRC ERROR");
+        else if (!f.typeOk)  printf("  BAD TYPE");
+        if (retry)           printf("  retry %d", retry);
+        if (ackMs >= 0)      printf("  ack +%.2f ms", ackMs);
+        printf("\n");
+    }
+
+    void error(uint64_t tNs, const char* kind, const char* fmt, ...)
+        __attribute__((format(printf, 4, 5)))
+    {
+        if (_o.quiet) return;
+        char msg[128];
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(msg, sizeof(msg), fmt, ap);
+        va_end(ap);
+        if (_o.csv) printf("%.6f,%s,,,,%s,,,,\n", tNs / 1e9, kind, msg);
+        else        printf("%12.6f  %-8s %s\n", tNs / 1e9, kind, msg);
+    }
+
+    // A NO_ACK frame (streamed, confirmed by its layer) gets a "/NA" suffix
+    static const char* typeName(uint8_t t) {
+        static char buf[24];
+        if (t & BUTCOM_TYPE_NO_ACK) {
+            char name[24];
+            snprintf(name, sizeof(name), "%.16s/NA", typeName(t & ~BUTCOM_TYPE_NO_ACK));
+            memcpy(buf, name, sizeof(buf));
+            return buf;
+        }
+        switch (t) {
+            case BUTCOM_MSG_HELLO:  return "HELLO";
+            case BUTCOM_MSG_DATA:   return "DATA";
+            case BUTCOM_MSG_ACK:    return "ACK";
+            case BUTCOM_MSG_PUBSUB: return "PUBSUB";
+            case BUTCOM_MSG_STATE:  return "STATE";
+            case BUTCOM_MSG_BULK:   return "BULK";
+            case BUTCOM_MSG_TIME:   return "TIME";
+            case BUTCOM_MSG_TUNE:   return "TUNE";
+        }
+        snprintf(buf, sizeof(buf), t >= BUTCOM_MSG_USER ? "USER%u" : "TYPE%u", t);
+        return buf;
+    }
+
+    const Options& _o;
+    State    _state;
+    Frame    _cur;
+    uint8_t  _body[2 + ANALYZE_MAX_PAYLOAD + 1];
+    uint8_t  _index;
+    bool     _haveLow;
+    uint8_t  _low;
+
+    uint64_t _prevEndNs;
+    bool     _haveFrame;
+    uint64_t _lastByteNs;
+    uint64_t _byteTimeoutNs;
+    uint64_t _busyNs = 0;
+    uint64_t _captureNs = 0;
+    uint64_t _typeCount[256];
+
+    std::vector<Pending> _pending;      // non-ACK frames inside the retry window
+    Stat     _ackLatency, _frameTime, _idleGap;
+};
+
+/* ============================================================
+   Bit time estimate from the first pulses
+   ============================================================ */
+
+// Most pulses inside a frame are one bit long. Take a low percentile
+// of the pulse widths (above glitch length, below the 50 µs of the
+// fastest tuned link) and snap it to the speed qualities when close.
+static uint32_t estimateBitUs(const std::vector<Edge>& edges) {
+    std::vector<uint64_t> widths;
+    for (size_t i = 1; i < edges.size(); i++) {
+        uint64_t w = edges[i].tNs - edges[i - 1].tNs;
+        if (w >= 30000 && w <= 3000000) widths.push_back(w);    // 30 µs .. 3 ms
+    }
+    if (widths.size() < 16) return 0;
+
+    std::sort(widths.begin(), widths.end());
+    double us = widths[widths.size() / 10] / 1000.0;
+
+    static const uint32_t q[] = { 300, 500, 800, 1200 };
+    for (uint32_t b : q)
+        if (fabs(us - b) < 0.15 * b) return b;
+    return (uint32_t)(us + 0.5);
+}
+
+/* ============================================================
+   main
+   ============================================================ */
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "usage: %s [options] capture\n"
+        "  --format csv|bin     default: from the file extension (.csv, else binary)\n"
+        "  --channel NAME|N     CSV column name (D0) or logic channel number (default: first)\n"
+        "  --rate HZ            samplerate (binary; CSV without samplerate comment)\n"
+        "  --unitsize N         bytes per sample in binary captures (default 1)\n"
+        "  --quality 1..4       bit time of the link (default: estimated from the capture)\n"
+        "  --bit-us US          explicit bit time\n"
+        "  --fec                link runs in FEC mode\n"
+        "  --retry-window MS    frames repeated within this time count as retries (1000)\n"
+        "  --csv                one CSV line per frame instead of the table\n"
+        "  --quiet              summary only\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    Options o;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        bool more = i + 1 < argc;
+        if      (!strcmp(a, "--format")  && more) o.format   = argv[++i];
+        else if (!strcmp(a, "--channel") && more) o.channel  = argv[++i];
+        else if (!strcmp(a, "--rate")    && more) o.rateHz   = atof(argv[++i]);
+        else if (!strcmp(a, "--unitsize") && more) o.unitSize = (uint8_t)atoi(argv[++i]);
+        else if (!strcmp(a, "--quality") && more) {
+            static const uint32_t q[] = { 300, 500, 800, 1200 };
+            int n = atoi(argv[++i]);
+            o.bitUs = q[(n < 1 ? 1 : n > 4 ? 4 : n) - 1];
+        }
+        else if (!strcmp(a, "--bit-us")  && more) o.bitUs = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(a, "--retry-window") && more) o.retryWindowMs = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(a, "--fec"))   o.fec   = true;
+        else if (!strcmp(a, "--csv"))   o.csv   = true;
+        else if (!strcmp(a, "--quiet")) o.quiet = true;
+        else if (a[0] != '-' && !o.path) o.path = a;
+        else { usage(argv[0]); return 2; }
+    }
+    if (!o.path) { usage(argv[0]); return 2; }
+
+    // ---- Map the capture ----
+    int fd = open(o.path, O_RDONLY);
+    if (fd < 0) { fprintf(stderr, "%s: %s\n", o.path, strerror(errno)); return 1; }
+    struct stat st;
+    fstat(fd, &st);
+    size_t size = (size_t)st.st_size;
+    if (!size) { fprintf(stderr, "%s: empty file\n", o.path); return 1; }
+
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) { fprintf(stderr, "mmap: %s\n", strerror(errno)); return 1; }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    bool isCsv = o.format ? !strcmp(o.format, "csv")
+                          : (strlen(o.path) > 4 && !strcasecmp(o.path + strlen(o.path) - 4, ".csv"));
+
+    // ---- Edge source ----
+    BinarySource* bin = nullptr;
+    CsvSource*    csv = nullptr;
+    EdgeSource*   src;
+
+    if (isCsv) {
+        csv = new CsvSource((const char*)map, size);
+        const char* err = csv->open(o.channel, o.rateHz);
+        if (err) { fprintf(stderr, "%s: %s\n", o.path, err); return 1; }
+        src = csv;
+    } else {
+        if (o.rateHz <= 0) { fprintf(stderr, "binary capture needs --rate\n"); return 1; }
+        int ch = 0;
+        if (o.channel) ch = atoi(o.channel[0] == 'D' ? o.channel + 1 : o.channel);
+        if (!o.unitSize || ch >= 8 * o.unitSize) { fprintf(stderr, "channel out of range\n"); return 1; }
+        bin = new BinarySource((const uint8_t*)map, size, o.unitSize, (uint8_t)ch, o.rateHz);
+        src = bin;
+    }
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    PrefetchSource pre(*src, 4096);
+    uint32_t bitUs = o.bitUs;
+    if (!bitUs) {
+        bitUs = estimateBitUs(pre.edges());
+        if (!bitUs) { fprintf(stderr, "too few pulses to estimate the bit time, use --quality\n"); return 1; }
+    }
+
+    if (!o.quiet) {
+        if (o.csv) printf("time_s,type,msg_id,len,payload,status,duration_ms,gap_ms,retry,ack_ms\n");
+        else       printf("bit time %u us%s%s\n\n", bitUs, o.bitUs ? "" : " (estimated)", o.fec ? ", FEC" : "");
+    }
+
+    // ---- Decode ----
+    ByteDecoder   dec(pre, bitUs);
+    FrameAnalyzer fa(o, bitUs);
+    RxByte        b;
+    while (dec.read(b)) fa.onByte(b);
+    fa.finish(dec.endNs());
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    if (!o.csv || o.quiet) {
+        fa.report(wall, dec.falseStarts());
+        printf("  throughput             %.0f MB/s\n", size / 1e6 / (wall > 0 ? wall : 1e-9));
+    }
+
+    delete bin;
+    delete csv;
+    munmap(map, size);
+    close(fd);
+
+    // Non-zero when the link had errors, for scripted checks
+    return (fa.crcErrors || fa.badLen || fa.badType || fa.truncated || fa.fecErrors) ? 3 : 0;
+}
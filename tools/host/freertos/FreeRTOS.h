@@ -0,0 +1,34 @@
+#pragma once
+
+/* ============================================================
+   FreeRTOS API shim for host builds
+   ------------------------------------------------------------
+   Types and constants as on the ESP32 (ESP-IDF) port; the
+   calls are implemented by SimRtos (../SimRtos.cpp). Tick
+   rate 1 kHz like the Arduino-ESP32 core.
+   ============================================================ */
+
+#include <stdint.h>
+
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE         0
+#define pdTRUE          1
+#define pdPASS          1
+#define pdFAIL          0
+#define errQUEUE_FULL   0
+#define errQUEUE_EMPTY  0
+
+#define portMAX_DELAY          ((TickType_t)0xFFFFFFFFUL)
+#define portTICK_PERIOD_MS     1
+#define configTICK_RATE_HZ     1000
+#define configMAX_PRIORITIES   25
+#define pdMS_TO_TICKS(ms)      ((TickType_t)(ms))
+#define tskNO_AFFINITY         0x7FFFFFFF
+
+// The FromISR calls already request the switch; the argument is optional
+// like on ESP-IDF
+void vSimRtosYieldFromIsr();
+#define portYIELD_FROM_ISR(...) vSimRtosYieldFromIsr()
@@ -0,0 +1,14 @@
+#pragma once
+#include "FreeRTOS.h"
+
+struct SimQueue;
+typedef SimQueue* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void          vQueueDelete(QueueHandle_t q);
+BaseType_t    xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks);
+BaseType_t    xQueueSendToBack(QueueHandle_t q, const void* item, TickType_t ticks);
+BaseType_t    xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks);
+BaseType_t    xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t* higherPriorityTaskWoken);
+UBaseType_t   uxQueueMessagesWaiting(QueueHandle_t q);
+UBaseType_t   uxQueueSpacesAvailable(QueueHandle_t q);
@@ -0,0 +1,34 @@
+/* ============================================================
+   Arduino API stub for the fuzz harness
+   ------------------------------------------------------------
+   No scheduler and no wire: the line always reads HIGH (idle),
+   pin writes go nowhere, and every call advances one global
+   clock. Much faster than ButComSim, which the RX path does
+   not need - the bytes are injected directly.
+
+   fuzz_cost() reports the virtual time used, so the harness
+   can measure CPU per input byte.
+   ============================================================ */
+
+#include "Arduino.h"
+
+static uint64_t clockNs;
+
+uint64_t fuzz_cost()        { return clockNs; }
+void     fuzz_reset_clock() { clockNs = 0; }
+
+void pinMode(uint8_t, uint8_t)      { clockNs += 2000; }
+void digitalWrite(uint8_t, uint8_t) { clockNs += 150; }
+int  digitalRead(uint8_t)           { clockNs += 150; return HIGH; }
+
+uint32_t micros() { clockNs += 120; return (uint32_t)(clockNs / 1000); }
+uint32_t millis() { clockNs += 150; return (uint32_t)(clockNs / 1000000); }
+
+void delayMicroseconds(unsigned int us) { clockNs += (uint64_t)us * 1000; }
+void delay(uint32_t ms)                 { clockNs += (uint64_t)ms * 1000000; }
+void yield()                            { clockNs += 500; }
+
+void attachInterrupt(uint8_t, void (*)(void), int) {}
+void detachInterrupt(uint8_t) {}
+void noInterrupts() {}
+void interrupts() {}
@@ -0,0 +1,587 @@
+/* ============================================================
+   fuzz_rx - Fuzz harness for the ButCom receive path
+   ------------------------------------------------------------
+   Input:  [options, rx bytes...]
+             options bit 0  FEC mode on
+             options bit 1  a bulk transfer is running (the
+                            sender side parses STATUS too)
+             options bit 2  ButComSized<4> instead of ButCom
+                            (per-instance LEN limit)
+             options bit 3  callback keeps payloads whose first
+                            byte is odd (keepRxPayload()), one
+                            at a time, on a 2-slot pool
+   Every rx byte goes through ButCom::injectRxByte(), i.e. the
+   FEC stage, the frame state machine and processFrame(). Frames
+   that pass the CRC are handed to all add-on layers.
+
+   Checks (besides ASan/UBSan):
+   - callback length <= maxPayload(), payload readable
+   - a kept payload is not overwritten while the application
+     owns it; no pool slot leaks
+   - no more callbacks than complete frames fit in the input
+   - CPU per input byte stays below a hard budget (hang)
+
+   Builds:
+   - libFuzzer (clang):   make fuzz_rx_libfuzzer CXX=clang++
+   - AFL:                 make fuzz_rx CXX=afl-g++, run with @@
+   - standalone (gcc):    make fuzz_rx
+       fuzz_rx FILE|DIR...           replay (regression check)
+       fuzz_rx --random N [--seed S] [--corpus DIR] [--save DIR]
+                                     mutate + generate, keep
+                                     crashing inputs as files,
+                                     report the most expensive
+                                     inputs per byte
+       fuzz_rx --write-seeds DIR     hand-made seed inputs
+   ============================================================ */
+
+#include "ButCom.h"
+#include "ButComBulk.h"
+#include "ButComFec.h"
+#include "ButComPubSub.h"
+#include "ButComStateSync.h"
+#include "ButComTimeSync.h"
+#include "ButComLinkTune.h"
+#include "ButComAsync.h"
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<sanitizer/common_interface_defs.h>)
+#include <sanitizer/common_interface_defs.h>
+#define FUZZ_HAVE_SANITIZER_API 1
+#endif
+#endif
+
+uint64_t fuzz_cost();
+void     fuzz_reset_clock();
+
+#define FUZZ_OPT_FEC   0x01
+#define FUZZ_OPT_BULK  0x02
+#define FUZZ_OPT_SMALL 0x04
+#define FUZZ_OPT_KEEP  0x08
+
+// Virtual CPU time allowed per input byte. A frame answered by an ACK
+// plus a layer reply costs ~150 ms of bit-banged TX on a >= 5 byte frame.
+#define FUZZ_BUDGET_NS_PER_BYTE 100000000ULL
+#define FUZZ_BUDGET_NS_BASE     1000000000ULL
+
+/* ============================================================
+   One input
+   ============================================================ */
+
+static ButComCore*         bus_;
+static ButComPubSub*       topics_;
+static ButComStateSync*    state_;
+static ButComBulkReceiver* bulkRx_;
+static ButComBulkSender*   bulkTx_;
+static ButComTimeSync*     clock_;
+static ButComLinkTune*     tune_;
+#if BUTCOM_CORO
+static ButComAsync*        async_;     // inbox only, no coroutines
+#endif
+static uint32_t            callbacks_;
+static uint64_t            injectNs_;          // virtual CPU of the rx bytes only
+static uint32_t            useful_;            // frames a layer / the app would use
+static volatile uint8_t    sink_;
+static bool                keepOdd_;
+static const uint8_t*      kept_;              // payload owned by the "application"
+static uint8_t             keptCopy_[256];
+static uint8_t             keptLen_;
+
+static void checkKept() {
+    if (kept_ && memcmp(kept_, keptCopy_, keptLen_) != 0) {
+        fprintf(stderr, "fuzz_rx: kept payload overwritten while owned by the application\n");
+        abort();
+    }
+}
+
+static void releaseKept() {
+    checkKept();
+    bus_->releasePayload(kept_);
+    kept_ = nullptr;
+}
+
+static void onMessage(uint8_t msgId, uint8_t type, const uint8_t* data, uint8_t len) {
+    if (len > bus_->maxPayload()) {
+        fprintf(stderr, "fuzz_rx: callback length %u > maxPayload %u\n", len, bus_->maxPayload());
+        abort();
+    }
+    if (len && !data) {
+        fprintf(stderr, "fuzz_rx: callback length %u with null payload\n", len);
+        abort();
+    }
+    uint8_t x = 0;
+    for (uint8_t i = 0; i < len; i++) x ^= data[i];     // ASan: must be readable
+    sink_ = x;
+    callbacks_++;
+
+    checkKept();
+    if (keepOdd_ && len && (data[0] & 1) && bus_->keepRxPayload()) {
+        if (kept_) releaseKept();
+        kept_    = data;
+        keptLen_ = len;
+        memcpy(keptCopy_, data, len);
+    }
+
+    if (type == BUTCOM_MSG_DATA || type == BUTCOM_MSG_HELLO ||
+        type == BUTCOM_MSG_ACK  || type >= BUTCOM_MSG_USER) useful_++;
+
+#if BUTCOM_CORO
+    async_->handleMessage(msgId, type, data, len);
+#endif
+    if (topics_->handleMessage(msgId, type, data, len)) { useful_++; return; }
+    if (state_->handleMessage(msgId, type, data, len))  { useful_++; return; }
+    if (clock_->handleMessage(msgId, type, data, len))  { useful_++; return; }
+    if (tune_->handleMessage(msgId, type, data, len))   { useful_++; return; }
+    if (bulkTx_->busy()) bulkTx_->handleMessage(msgId, type, data, len);
+    if (bulkRx_->handleMessage(msgId, type, data, len)) useful_++;
+}
+
+static uint8_t  image_[64];
+static uint32_t bulkImageSize_ = sizeof(image_);
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size < 1) return 0;
+
+    uint8_t options = data[0];
+    data++;
+    size--;
+
+    fuzz_reset_clock();
+
+    uint8_t localRegs[8]  = { 0 };
+    uint8_t remoteRegs[8] = { 0 };
+
+    ButCom             big(2, false, 0x10);
+    ButComSized<4>     small(2, false, 0x10);
+    ButComCore&        bus = (options & FUZZ_OPT_SMALL) ? (ButComCore&)small : big;
+    ButComPubSub       topics(bus);
+    ButComStateSync    state(bus, localRegs, 8, remoteRegs, 8);
+    ButComBulkReceiver bulkRx(bus);
+    ButComBulkSender   bulkTx(bus);
+    ButComTimeSync     clock(bus);
+    ButComLinkTune     tune(bus);
+#if BUTCOM_CORO
+    ButComAsync        async(bus);
+    async_ = &async;
+#endif
+
+    bus_ = &bus;  topics_ = &topics;  state_ = &state;
+    bulkRx_ = &bulkRx;  bulkTx_ = &bulkTx;  clock_ = &clock;  tune_ = &tune;
+    callbacks_ = 0;
+    useful_    = 0;
+    keepOdd_   = options & FUZZ_OPT_KEEP;
+    kept_      = nullptr;
+
+    bus.setCallback(onMessage);
+    bus.setHelloInterval(0);
+    bus.setFecMode(options & FUZZ_OPT_FEC);
+    bus.begin(false);
+    topics.subscribe(1);
+    topics.loop();
+    if (options & FUZZ_OPT_BULK) bulkTx.start(image_, bulkImageSize_);
+
+    uint64_t setupNs = fuzz_cost();
+    for (size_t i = 0; i < size; i++)
+        bus.injectRxByte(data[i]);
+    uint64_t cost = fuzz_cost() - setupNs;
+    injectNs_ = cost;
+
+    // Slots left: at most the kept payload, the pending TX frame and a
+    // frame still being received
+    uint8_t maxInUse = (kept_ ? 1 : 0) + (bus.txPending() ? 1 : 0) + 1;
+    if (bus.pool().inUse() > maxInUse) {
+        fprintf(stderr, "fuzz_rx: %u pool slots in use after the input (max %u)\n",
+                bus.pool().inUse(), maxInUse);
+        abort();
+    }
+    if (kept_) releaseKept();
+
+    // Smallest frame: START LEN TYPE MSGID CRC (twice as long with FEC)
+    size_t minFrame = (options & FUZZ_OPT_FEC) ? 9 : 5;
+    if (callbacks_ > size / minFrame) {
+        fprintf(stderr, "fuzz_rx: %u callbacks from %zu bytes\n", callbacks_, size);
+        abort();
+    }
+    if (cost > FUZZ_BUDGET_NS_BASE + FUZZ_BUDGET_NS_PER_BYTE * size) {
+        fprintf(stderr, "fuzz_rx: %llu ns virtual CPU for %zu bytes (hang?)\n",
+                (unsigned long long)cost, size);
+        abort();
+    }
+
+    bus_ = nullptr;
+    return 0;
+}
+
+/* ============================================================
+   Standalone driver
+   ============================================================ */
+#ifndef BUTCOM_LIBFUZZER
+
+static std::vector<uint8_t> current_;
+static std::string          saveDir_ = ".";
+
+static void saveCurrent(const char* tag) {
+    char name[512];
+    uint32_t h = 2166136261u;                           // FNV-1a of the input
+    for (uint8_t b : current_) h = (h ^ b) * 16777619u;
+    snprintf(name, sizeof(name), "%s/%s-%08x.bin", saveDir_.c_str(), tag, h);
+
+    FILE* f = fopen(name, "wb");
+    if (f) {
+        fwrite(current_.data(), 1, current_.size(), f);
+        fclose(f);
+        fprintf(stderr, "fuzz_rx: input saved to %s\n", name);
+    }
+}
+
+static void onDeath()          { saveCurrent("crash"); }
+static void onSignal(int sig)  {
+    saveCurrent(sig == SIGALRM ? "timeout" : "crash");
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    out.clear();
+    uint8_t buf[4096];
+    size_t  n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+static void listInputs(const char* path, std::vector<std::string>& files) {
+    struct stat st;
+    if (stat(path, &st) != 0) return;
+    if (!S_ISDIR(st.st_mode)) { files.push_back(path); return; }
+
+    DIR* d = opendir(path);
+    if (!d) return;
+    while (struct dirent* e = readdir(d)) {
+        if (e->d_name[0] == '.') continue;
+        files.push_back(std::string(path) + "/" + e->d_name);
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+}
+
+static uint64_t runOne(const std::vector<uint8_t>& in) {
+    current_ = in;
+    alarm(5);
+    LLVMFuzzerTestOneInput(in.data(), in.size());
+    alarm(0);
+    return injectNs_;
+}
+
+/* ---------------- input generation ---------------- */
+
+static uint64_t rng_ = 88172645463325252ULL;
+
+static uint32_t rnd() {
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 7;
+    rng_ ^= rng_ << 17;
+    return (uint32_t)(rng_ >> 16);
+}
+
+static void putByte(std::vector<uint8_t>& v, uint8_t b, bool fec) {
+    if (fec) {
+        v.push_back(butcom_fec_encode(b));
+        v.push_back(butcom_fec_encode(b >> 4));
+    } else {
+        v.push_back(b);
+    }
+}
+
+// Well-formed frame (valid CRC) as it appears on the wire
+static void putFrame(std::vector<uint8_t>& v, uint8_t type, uint8_t msgId,
+                     const uint8_t* payload, uint8_t len, bool fec)
+{
+    uint8_t bodyLen = 3 + len;
+    uint8_t crc = 0;
+    crc = ButCom::crc8_update(crc, bodyLen);
+    crc = ButCom::crc8_update(crc, type);
+    crc = ButCom::crc8_update(crc, msgId);
+    for (uint8_t i = 0; i < len; i++) crc = ButCom::crc8_update(crc, payload[i]);
+
+    v.push_back(0xA5);
+    putByte(v, bodyLen, fec);
+    putByte(v, type, fec);
+    putByte(v, msgId, fec);
+    for (uint8_t i = 0; i < len; i++) putByte(v, payload[i], fec);
+    putByte(v, crc, fec);
+}
+
+static uint8_t randomType() {
+    static const uint8_t common[] = {
+        BUTCOM_MSG_HELLO, BUTCOM_MSG_DATA, BUTCOM_MSG_ACK, BUTCOM_MSG_PUBSUB,
+        BUTCOM_MSG_STATE, BUTCOM_MSG_BULK, BUTCOM_MSG_TIME, BUTCOM_MSG_TUNE, BUTCOM_MSG_USER
+    };
+    return (rnd() & 3) ? common[rnd() % sizeof(common)] : (uint8_t)rnd();
+}
+
+static std::vector<uint8_t> generate(uint32_t maxLen) {
+    std::vector<uint8_t> v;
+    uint8_t options = (uint8_t)(rnd() & 15);
+    bool    fec     = options & FUZZ_OPT_FEC;
+    v.push_back(options);
+
+    while (v.size() < maxLen) {
+        switch (rnd() % 5) {
+            case 0: {                                   // garbage
+                uint32_t n = 1 + rnd() % 8;
+                while (n--) v.push_back((uint8_t)rnd());
+                break;
+            }
+            case 1: {                                   // START + bogus LEN
+                v.push_back(0xA5);
+                putByte(v, (uint8_t)rnd(), fec);
+                break;
+            }
+            default: {                                  // valid frame, random content
+                uint8_t p[BUTCOM_MAX_PAYLOAD];
+                uint8_t len = (uint8_t)(rnd() % (BUTCOM_MAX_PAYLOAD + 1));
+                for (uint8_t i = 0; i < len; i++)
+                    p[i] = (i == 0 && (rnd() & 1)) ? (uint8_t)(1 + rnd() % 6) : (uint8_t)rnd();
+                putFrame(v, randomType(), (uint8_t)rnd(), p, len, fec);
+                break;
+            }
+        }
+    }
+    return v;
+}
+
+static void mutate(std::vector<uint8_t>& v, uint32_t maxLen) {
+    uint32_t n = 1 + rnd() % 4;
+    while (n--) {
+        if (v.size() < 2) { v.push_back((uint8_t)rnd()); continue; }
+        size_t at = 1 + rnd() % (v.size() - 1);
+        switch (rnd() % 4) {
+            case 0: v[at] ^= (uint8_t)(1 << (rnd() & 7));             break;
+            case 1: v[at]  = (uint8_t)rnd();                          break;
+            case 2: v.erase(v.begin() + at);                          break;
+            case 3: if (v.size() < maxLen) v.insert(v.begin() + at, (uint8_t)rnd()); break;
+        }
+    }
+}
+
+/* ---------------- seeds ---------------- */
+
+static void writeFile(const std::string& path, const std::vector<uint8_t>& v) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) { perror(path.c_str()); return; }
+    fwrite(v.data(), 1, v.size(), f);
+    fclose(f);
+}
+
+static void writeSeeds(const char* dir) {
+    std::string path;
+    for (const char* c = dir; ; c++) {            // mkdir -p
+        if (*c == '/' || !*c) mkdir(path.c_str(), 0755);
+        if (!*c) break;
+        path += *c;
+    }
+    std::string d(dir);
+    uint8_t p[BUTCOM_MAX_PAYLOAD];
+    memset(p, 0x5A, sizeof(p));
+
+    for (int fec = 0; fec <= 1; fec++) {
+        std::string sfx = fec ? "-fec" : "";
+        std::vector<uint8_t> v;
+
+        v = { (uint8_t)fec };  uint8_t id = 0x10;
+        putFrame(v, BUTCOM_MSG_HELLO, 1, &id, 1, fec);
+        writeFile(d + "/hello" + sfx + ".bin", v);
+
+        v = { (uint8_t)fec };
+        uint8_t request[5] = { 0x10, BUTCOM_HELLO_REQUEST, BUTCOM_MAX_PAYLOAD, 0x34, 0x12 };
+        putFrame(v, BUTCOM_MSG_HELLO, 1, request, 5, fec);
+        writeFile(d + "/hello-request" + sfx + ".bin", v);
+
+        // Peer reboot: DATA, a HELLO with a new boot nonce, DATA with the same msgId
+        v = { (uint8_t)fec };
+        uint8_t hello[5] = { 0x10, 0, BUTCOM_MAX_PAYLOAD, 0x34, 0x12 };
+        putFrame(v, BUTCOM_MSG_HELLO, 1, hello, 5, fec);
+        putFrame(v, BUTCOM_MSG_DATA, 2, p, 4, fec);
+        hello[3] = 0x35;
+        putFrame(v, BUTCOM_MSG_HELLO, 1, hello, 5, fec);
+        putFrame(v, BUTCOM_MSG_DATA, 2, p, 4, fec);
+        writeFile(d + "/hello-reboot" + sfx + ".bin", v);
+
+        v = { (uint8_t)fec };
+        putFrame(v, BUTCOM_MSG_DATA, 2, p, BUTCOM_MAX_PAYLOAD, fec);
+        putFrame(v, BUTCOM_MSG_DATA, 2, p, BUTCOM_MAX_PAYLOAD, fec);   // duplicate
+        writeFile(d + "/data-max" + sfx + ".bin", v);
+
+        v = { (uint8_t)fec };
+        putFrame(v, BUTCOM_MSG_ACK, 3, nullptr, 0, fec);
+        writeFile(d + "/ack" + sfx + ".bin", v);
+
+        // START followed by every LEN, truncated
+        v = { (uint8_t)fec };
+        for (int len = 0; len < 256; len += 17) { v.push_back(0xA5); putByte(v, (uint8_t)len, fec); }
+        writeFile(d + "/len-sweep" + sfx + ".bin", v);
+    }
+
+    // One valid frame per add-on opcode
+    struct { uint8_t type; uint8_t len; uint8_t bytes[12]; const char* name; } layer[] = {
+        { BUTCOM_MSG_PUBSUB, 5,  { 1, 0xFF, 0xFF, 0xFF, 0xFF },              "pubsub-subscribe" },
+        { BUTCOM_MSG_PUBSUB, 4,  { 2, 1, 0xAB, 0xCD },                       "pubsub-publish" },
+        { BUTCOM_MSG_STATE,  6,  { 1, 1, 0, 7, 3, 9 },                       "state-delta" },
+        { BUTCOM_MSG_STATE,  5,  { 2, 9, 0, 8, 0x55 },                       "state-digest" },
+        { BUTCOM_MSG_STATE,  1,  { 3 },                                      "state-resync" },
+        { BUTCOM_MSG_BULK | BUTCOM_TYPE_NO_ACK, 10, { 1, 16, 0, 0, 0, 1, 2, 3, 4, 9 }, "bulk-start" },
+        { BUTCOM_MSG_BULK | BUTCOM_TYPE_NO_ACK, 4,  { 4, 2, 0, 0 },          "bulk-status" },
+        { BUTCOM_MSG_BULK | BUTCOM_TYPE_NO_ACK, 1,  { 3 },                   "bulk-finish" },
+        { BUTCOM_MSG_TIME,   2,  { 1, 7 },                                   "time-request" },
+        { BUTCOM_MSG_TIME,   11, { 2, 7, 1, 2, 3, 4, 6, 5, 6, 7, 8 },        "time-response" },
+        { BUTCOM_MSG_TUNE,   6,  { 1, 0, 44, 1, 8, 6 },                      "tune-propose" },
+        { BUTCOM_MSG_TUNE,   2,  { 4, 0 },                                   "tune-query" },
+        { BUTCOM_MSG_TUNE,   6,  { 6, 200, 0, 1, 0, 0x20 },                  "tune-commit" },
+        { BUTCOM_MSG_TUNE,   5,  { 7, 1, 0, 0, 0x20 },                       "tune-resume" },
+    };
+    for (auto& l : layer) {
+        std::vector<uint8_t> v = { FUZZ_OPT_BULK };
+        putFrame(v, l.type, 9, l.bytes, l.len, false);
+        writeFile(d + "/" + l.name + ".bin", v);
+    }
+
+    // Tune responder: PROPOSE, then TEST frames at the test bit time
+    std::vector<uint8_t> v = { 0 };
+    uint8_t propose[6] = { 1, 0, 44, 1, 2, 6 };
+    putFrame(v, BUTCOM_MSG_TUNE, 10, propose, 6, false);
+    for (uint8_t seq = 0; seq < 2; seq++) {
+        uint8_t test[6] = { 2, 0, seq, 0x55, 0xAA, 0x0F };
+        putFrame(v, BUTCOM_MSG_TUNE, (uint8_t)(11 + seq), test, 6, false);
+    }
+    writeFile(d + "/tune-test.bin", v);
+
+    // Tune responder: COMMIT, then CONFIRM at the committed bit time
+    v = { 0 };
+    uint8_t commit[6] = { 6, 200, 0, 1, 0, 0x20 };
+    putFrame(v, BUTCOM_MSG_TUNE, 10, commit, 6, false);
+    uint8_t confirm[3] = { 8, 1, 0 };
+    putFrame(v, BUTCOM_MSG_TUNE, 11, confirm, 3, false);
+    writeFile(d + "/tune-confirm.bin", v);
+
+    // ButComSized<4>: HELLOs through the scratch buffer, a DATA frame
+    // of the same length that must not get in that way
+    v = { FUZZ_OPT_SMALL };
+    uint8_t hello[5] = { 0x20, BUTCOM_HELLO_REQUEST, BUTCOM_MAX_PAYLOAD, 0x34, 0x12 };
+    putFrame(v, BUTCOM_MSG_HELLO, 1, hello, 5, false);
+    putFrame(v, BUTCOM_MSG_DATA, 2, p, 5, false);
+    hello[3] = 0x35;
+    putFrame(v, BUTCOM_MSG_HELLO, 1, hello, 5, false);
+    writeFile(d + "/small-hello.bin", v);
+}
+
+/* ---------------- main ---------------- */
+
+struct Hot { double nsPerByte; std::vector<uint8_t> input; };
+
+static void pruneHot(std::vector<Hot>& hot) {
+    std::sort(hot.begin(), hot.end(), [](const Hot& a, const Hot& b) {
+        return a.nsPerByte > b.nsPerByte || (a.nsPerByte == b.nsPerByte && a.input < b.input);
+    });
+    hot.erase(std::unique(hot.begin(), hot.end(), [](const Hot& a, const Hot& b) {
+        return a.input == b.input;
+    }), hot.end());
+    if (hot.size() > 8) hot.resize(8);
+}
+
+int main(int argc, char** argv) {
+#ifdef FUZZ_HAVE_SANITIZER_API
+    __sanitizer_set_death_callback(onDeath);
+#else
+    (void)onDeath;
+#endif
+    signal(SIGSEGV, onSignal);
+    signal(SIGABRT, onSignal);
+    signal(SIGALRM, onSignal);
+
+    uint32_t    randomRuns = 0;
+    uint32_t    maxLen     = 256;
+    const char* corpusDir  = nullptr;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        if      (!strcmp(argv[i], "--random") && i + 1 < argc)  randomRuns = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)    rng_ = 88172645463325252ULL ^ (uint64_t)atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--corpus") && i + 1 < argc)  corpusDir = argv[++i];
+        else if (!strcmp(argv[i], "--save") && i + 1 < argc)    saveDir_ = argv[++i];
+        else if (!strcmp(argv[i], "--max-len") && i + 1 < argc) maxLen = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--write-seeds") && i + 1 < argc) { writeSeeds(argv[++i]); return 0; }
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s FILE|DIR... | --random N [--seed S] [--corpus DIR] "
+                            "[--save DIR] [--max-len L] | --write-seeds DIR\n", argv[0]);
+            return 2;
+        }
+        else listInputs(argv[i], files);
+    }
+
+    // ---- Replay ----
+    for (const std::string& f : files) {
+        std::vector<uint8_t> in;
+        if (!readFile(f.c_str(), in)) { perror(f.c_str()); return 1; }
+        uint64_t ns = runOne(in);
+        printf("%-48s %5zu bytes  %8.1f us/byte\n", f.c_str(), in.size(),
+               in.size() > 1 ? ns / 1000.0 / (in.size() - 1) : 0.0);
+    }
+    if (!randomRuns) return 0;
+
+    // ---- Random / mutation ----
+    std::vector<std::vector<uint8_t>> corpus;
+    if (corpusDir) {
+        std::vector<std::string> seeds;
+        listInputs(corpusDir, seeds);
+        for (const std::string& s : seeds) {
+            std::vector<uint8_t> in;
+            if (readFile(s.c_str(), in) && !in.empty()) corpus.push_back(in);
+        }
+    }
+
+    std::vector<Hot> hot;
+    for (uint32_t run = 0; run < randomRuns; run++) {
+        std::vector<uint8_t> in;
+        if (!corpus.empty() && (rnd() & 1)) {
+            in = corpus[rnd() % corpus.size()];
+            mutate(in, maxLen);
+        } else {
+            in = generate(1 + rnd() % maxLen);
+        }
+        if (in.size() < 2) continue;
+
+        uint64_t ns = runOne(in);
+
+        // Valid frames legitimately cost an ACK (and a reply); what matters
+        // for fast-reject is CPU burnt on input that yields nothing
+        if (useful_ == 0) {
+            hot.push_back({ ns / (double)(in.size() - 1), in });
+            if (hot.size() > 64) pruneHot(hot);
+        }
+    }
+
+    pruneHot(hot);
+    printf("%u inputs, no failures. Most CPU per byte on input without a usable frame:\n", randomRuns);
+    for (size_t i = 0; i < hot.size() && i < 8; i++) {
+        printf("  %8.1f us/byte  opt=%u  ", hot[i].nsPerByte / 1000.0, hot[i].input[0]);
+        for (size_t j = 1; j < hot[i].input.size() && j < 24; j++) printf("%02X ", hot[i].input[j]);
+        printf("%s\n", hot[i].input.size() > 24 ? "..." : "");
+    }
+    return 0;
+}
+
+#endif // BUTCOM_LIBFUZZER
@@ -0,0 +1,1139 @@
+/* ============================================================
+   sim_demo - Two ButCom nodes on one virtual wire
+   ------------------------------------------------------------
+   Scenarios:
+     ping      ESP32 sends an ACKed DATA frame every 100 ms,
+               ATtiny85 echoes it back
+     bulk      8 KB image over ButComBulkSender/Receiver;
+               bulk-64 sends it between ButComSized<64>
+               instances at 70 us (57-byte blocks), bulk-writefail
+               has the receiver's write hook fail halfway
+     timesync  ATtiny85 clock runs +150 ppm fast with a boot
+               offset; ESP32 estimates offset and drift
+     jitter    ping traffic with timing diagnostics on both
+               sides, ATtiny85 RC oscillator 1 % fast; prints
+               edge jitter / margin histograms and the safe
+               bit time per direction
+     sleep     ping every 250 ms, ATtiny85 on the interrupt receiver:
+               it idles until the edge interrupt or the deadline
+               returned by loop() and reports its awake time
+     button    a button on the ATtiny85 (presses of 5..300 ms) is
+               captured in its pin-change ISR and queued with
+               sendFromIsr(); button-poll reads it in loop()
+               instead. Prints capture and delivery latency.
+     coro      ESP32 runs two ButComAsync coroutines: RPC calls
+               to the ATtiny85 echo (co_await io.call()) and a
+               sleep-based heartbeat
+     tune      HELLO at quality 2, then ButComLinkTune sweeps the
+               bit time down (ATtiny85 RC oscillator 1 % fast);
+               ping traffic at the agreed bit time afterwards;
+               tune-lost-ack hides the COMMIT ACK from the
+               ESP32, so both sides must end up at 500 us
+     resume    both nodes boot with a stored 70 us profile
+               (ButComLinkTune::resume()) and ping right away;
+               resume-stale gives the ATtiny85 an older epoch, so
+               both fall back to 500 us and negotiate again
+     discover  ATtiny85 runs, ESP32 boots 2 s later with
+               begin(true): its HELLO asks for the peer's one,
+               prints the time until both know each other;
+               discover-both powers both up at once
+     reboot    ping every 250 ms; the ATtiny85 resets (150 ms boot)
+               once it knows the ESP32 and its first echo was
+               ACKed, so its next first echo reuses that msgId. The boot nonce in
+               HELLO makes the ESP32 forget it; reboot-same-nonce
+               keeps one nonce and shows the echoes the duplicate
+               filter then drops
+     small     the ATtiny85 runs a ButComSized<1> instance (a
+               1-byte button link): it still receives the 5-byte
+               HELLO, learns the ESP32's id and sees its reboot,
+               and the ESP32 sees the ATtiny85's
+     backpressure  ESP32 samples a sensor every 20 ms (faster
+               than ACKed frames clear at quality 1, BER 1e-4):
+               trySend() says FULL while the last frame waits for
+               its ACK, so samples are batched into the next one;
+               backpressure-naive calls send() per sample
+     pubsub    ESP32 caches 8 topics, the ATtiny85 subscribes to
+               all of them at once (BER 1e-3): the cached values
+               come one ACKed frame at a time. Then the ATtiny85
+               reboots without subscribing; its new boot nonce
+               clears the ESP32's view of its subscriptions
+     budget    ESP32 runs a 2 ms control loop on the interrupt
+               receiver and gives bus.loop(500) 500 us per period
+               (a larger slice every 100 ms if TX work waits);
+               prints how long the loop() calls took. budget-off
+               calls loop() without a budget
+   Prints results plus the simulated/real time ratio.
+
+   With a capture file the wire is also written as a 1 MHz logic
+   capture for butcom_analyze: sigrok CSV for *.csv, otherwise
+   raw samples (sigrok binary, D0 = bit 0).
+
+   usage: sim_demo [ping|bulk|bulk-64|bulk-writefail|timesync|jitter|sleep|button|button-poll|coro|tune|tune-lost-ack|resume|resume-stale|discover|discover-both|reboot|reboot-same-nonce|small|backpressure|backpressure-naive|pubsub|budget|budget-off]
+                   [spinQuantumNs] [capture]
+   ============================================================ */
+
+#include "ButComSim.h"
+#include "ButCom.h"
+#include "ButComBulk.h"
+#include "ButComTimeSync.h"
+#include "ButComAsync.h"
+#include "ButComLinkTune.h"
+#include "ButComPubSub.h"
+
+#include <chrono>
+#include <new>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DATA_PIN 2
+
+static SimWire wire;
+static SimNode esp("esp32", SimCosts::esp32c3());
+static SimNode tiny("attiny85", SimCosts::attiny85());
+
+static ButCom busA(DATA_PIN, true,  0x20);   // ESP32 side
+static ButCom busB(DATA_PIN, false, 0x10);   // ATtiny85 side
+
+/* ---------------- ping ---------------- */
+
+static uint32_t pingSent, pingEchoed, pingReceived;
+
+static void pingOnA(uint8_t, uint8_t type, const uint8_t*, uint8_t) {
+    if (type == BUTCOM_MSG_DATA) pingEchoed++;
+}
+
+static void pingOnB(uint8_t, uint8_t type, const uint8_t* data, uint8_t len) {
+    if (type != BUTCOM_MSG_DATA) return;
+    pingReceived++;
+    busB.send(data, len, true);
+}
+
+/* ---------------- bulk ---------------- */
+
+static uint8_t  image[8192];
+static uint8_t  flash[8192];
+static bool     bulkDone, bulkOk;
+static ButComBulkSender   bulkTx(busA);
+static ButComBulkReceiver bulkRx(busB);
+
+static bool writeFlash(uint32_t off, const uint8_t* d, uint8_t n) {
+    memcpy(&flash[off], d, n);
+    return true;
+}
+
+// bulk-writefail: the flash "wears out" halfway through the image
+static bool writeFlashHalf(uint32_t off, const uint8_t* d, uint8_t n) {
+    return off < sizeof(flash) / 2 && writeFlash(off, d, n);
+}
+
+// bulk-64: larger frames on both sides, as a gateway link would use
+static ButComSized<64>    bigA(DATA_PIN, true,  0x20);
+static ButComSized<64>    bigB(DATA_PIN, false, 0x10);
+static ButComBulkSender   bigTx(bigA);
+static ButComBulkReceiver bigRx(bigB);
+
+static void imageDone(bool ok) { bulkDone = true; bulkOk = ok; }
+
+static void bulkOnA(uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) { bulkTx.handleMessage(id, type, d, n); }
+static void bulkOnB(uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) { bulkRx.handleMessage(id, type, d, n); }
+
+/* ---------------- small ---------------- */
+
+// Frame slots of 1 + 3 bytes, smaller than a HELLO
+static ButComSized<1> smallB(DATA_PIN, false, 0x10);
+
+/* ---------------- timesync ---------------- */
+
+static ButComTimeSync clockA(busA);
+static ButComTimeSync clockB(busB);
+
+static void timeOnA(uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) { clockA.handleMessage(id, type, d, n); }
+static void timeOnB(uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) { clockB.handleMessage(id, type, d, n); }
+
+/* ---------------- jitter ---------------- */
+
+static void printTiming(const char* link, const ButCom& bus) {
+    const ButComTimingStats& s = bus.timingStats();
+    uint16_t safe = s.safeBitUs();
+
+    printf("%s: bit %uus, %u bytes, %u edges, %u framing errors\n",
+           link, s.bitUs, s.bytes, s.edges, s.framingErrors);
+    printf("  edge deviation %+d .. %+dus, drift over a byte %+dus, min margin %dus of %uus\n",
+           s.devMinUs, s.devMaxUs, s.driftUs(), s.marginMinUs, s.bitUs / 2);
+
+    printf("  jitter  ");
+    for (int i = 0; i < BUTCOM_DIAG_BINS; i++) printf(" %5u", s.jitter[i]);
+    printf("   (bins of %uus from -%uus)\n", s.bitUs / BUTCOM_DIAG_BINS, s.bitUs / 2);
+    printf("  margin  ");
+    for (int i = 0; i < BUTCOM_DIAG_BINS; i++) printf(" %5u", s.margin[i]);
+    printf("   (bins of %uus from 0)\n", s.bitUs / (2 * BUTCOM_DIAG_BINS));
+
+    printf("  safe bit time %uus -> quality %u\n", safe, bus.recommendedQuality());
+}
+
+/* ---------------- sleep ---------------- */
+
+static volatile bool tinyWake;
+static uint64_t      tinyAsleepNs;
+static uint32_t      tinyWakeups;
+
+static void wakeTiny() { tinyWake = true; }   // called from the edge ISR
+
+// Stands in for an idle sleep mode: ISR time is charged to the
+// interrupted delay and counts as awake
+static void sleepTiny(uint32_t ms) {
+    uint32_t start = millis();
+    while (!tinyWake && (ms == BUTCOM_NO_DEADLINE || millis() - start < ms)) {
+        uint64_t t0 = tiny.timeNs();
+        delayMicroseconds(5);
+        uint64_t d = tiny.timeNs() - t0;
+        tinyAsleepNs += (d < 5000) ? d : 5000;
+    }
+    tinyWakeups++;
+}
+
+/* ---------------- button ---------------- */
+
+#define BUTTON_PIN 3
+
+static SimNode button("button", SimCosts::attiny85());
+
+static std::vector<uint64_t> buttonEdgeNs;       // by edge number
+static uint32_t buttonCaptured;
+static uint64_t captureSumNs, captureMaxNs;
+static uint32_t buttonDelivered;
+static uint64_t deliverySumNs, deliveryMaxNs;
+
+// Payload: level, number of the edge it reports
+static void captureButton(uint8_t level, uint8_t p[3]) {
+    uint16_t edge = (uint16_t)(buttonEdgeNs.size() - 1);
+    uint64_t lat  = tiny.timeNs() - buttonEdgeNs[edge];
+    buttonCaptured++;
+    captureSumNs += lat;
+    if (lat > captureMaxNs) captureMaxNs = lat;
+
+    p[0] = level;
+    p[1] = (uint8_t)edge;
+    p[2] = (uint8_t)(edge >> 8);
+}
+
+static void buttonIsr() {
+    uint8_t p[3];
+    captureButton((uint8_t)digitalRead(BUTTON_PIN), p);
+    busB.sendFromIsr(p, sizeof(p), true);
+}
+
+static void buttonOnA(uint8_t, uint8_t type, const uint8_t* d, uint8_t n) {
+    if (type != BUTCOM_MSG_DATA || n != 3) return;
+    uint64_t lat = esp.timeNs() - buttonEdgeNs[d[1] | (d[2] << 8)];
+    buttonDelivered++;
+    deliverySumNs += lat;
+    if (lat > deliveryMaxNs) deliveryMaxNs = lat;
+}
+
+/* ---------------- coro ---------------- */
+
+static ButComAsync io(busA);
+static uint32_t    callsOk, callsFailed, callsBad, heartbeats;
+static uint64_t    callRttSumNs;
+
+static void coroOnA(uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) { io.handleMessage(id, type, d, n); }
+
+static ButComTask rpcClient(uint8_t count) {
+    ButComMessage reply;
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t  req[4] = { 0xC0, i, (uint8_t)(i * 3), (uint8_t)~i };
+        uint64_t t0     = esp.timeNs();
+
+        if (!co_await io.call(BUTCOM_MSG_DATA, req, sizeof(req), reply, 300)) {
+            callsFailed++;
+        } else if (reply.length != sizeof(req) || memcmp(reply.payload, req, sizeof(req))) {
+            callsBad++;
+        } else {
+            callsOk++;
+            callRttSumNs += esp.timeNs() - t0;
+        }
+        co_await io.sleep(100);
+    }
+}
+
+static ButComTask heartbeat() {
+    for (;;) {
+        co_await io.sleep(1000);
+        heartbeats++;
+    }
+}
+
+/* ---------------- tune ---------------- */
+
+static ButComLinkTune tuneA(busA);
+static ButComLinkTune tuneB(busB);
+static uint16_t       tunedA, tunedB;
+static uint64_t       tunedNs;
+
+static uint32_t       fallbacksA, fallbacksB;
+static bool           loseCommitAck;     // tune-lost-ack
+
+static void tuneDoneA(bool ok, uint16_t us) { tunedA = ok ? us : 0; tunedNs = esp.timeNs(); fallbacksA += !ok; }
+static void tuneDoneB(bool ok, uint16_t us) { tunedB = ok ? us : 0; fallbacksB += !ok; }
+
+// "EEPROM" of each node; format in PROTOCOL.md (TUNE)
+static uint8_t storeA[BUTCOM_PROFILE_SIZE], storeB[BUTCOM_PROFILE_SIZE];
+
+static bool readA(uint8_t* d, uint8_t n)        { memcpy(d, storeA, n); return true; }
+static bool readB(uint8_t* d, uint8_t n)        { memcpy(d, storeB, n); return true; }
+static bool writeA(const uint8_t* d, uint8_t n) { memcpy(storeA, d, n); return true; }
+static bool writeB(const uint8_t* d, uint8_t n) { memcpy(storeB, d, n); return true; }
+
+static void storeProfile(uint8_t* d, uint8_t peerId, uint16_t bitUs, uint16_t baseUs, uint16_t epoch) {
+    uint8_t p[BUTCOM_PROFILE_SIZE] = { 1, peerId, (uint8_t)bitUs, (uint8_t)(bitUs >> 8),
+                                       (uint8_t)baseUs, (uint8_t)(baseUs >> 8), 0,
+                                       (uint8_t)epoch, (uint8_t)(epoch >> 8), 0 };
+    for (int i = 0; i < BUTCOM_PROFILE_SIZE - 1; i++)
+        p[BUTCOM_PROFILE_SIZE - 1] = ButCom::crc8_update(p[BUTCOM_PROFILE_SIZE - 1], p[i]);
+    memcpy(d, p, sizeof(p));
+}
+
+static uint16_t storedEpoch(const uint8_t* d) { return (uint16_t)(d[7] | (d[8] << 8)); }
+
+static void tuneOnA(uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) {
+    if (loseCommitAck && type == BUTCOM_MSG_ACK && tuneA.state() == ButComLinkTune::COMMITTING) {
+        loseCommitAck = false;
+        return;
+    }
+    if (!tuneA.handleMessage(id, type, d, n)) pingOnA(id, type, d, n);
+}
+static void tuneOnB(uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) {
+    if (!tuneB.handleMessage(id, type, d, n)) pingOnB(id, type, d, n);
+}
+
+/* ---------------- capture ---------------- */
+
+static std::vector<std::pair<uint64_t, bool>> captureEdges;
+
+static bool writeCapture(const char* path, uint64_t endNs) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+
+    size_t n   = strlen(path);
+    bool   csv = n > 4 && !strcmp(path + n - 4, ".csv");
+    if (csv) fprintf(f, "; CSV, generated by sim_demo\n; Channels (1/1): D0\n; Samplerate: 1 MHz\nD0\n");
+
+    // 1 sample per µs, level = last edge at or before the sample
+    bool   level = true;
+    size_t e     = 0;
+    for (uint64_t us = 0; us * 1000 < endNs; us++) {
+        while (e < captureEdges.size() && captureEdges[e].first <= us * 1000)
+            level = captureEdges[e++].second;
+        if (csv) fputs(level ? "1\n" : "0\n", f);
+        else     fputc(level ? 1 : 0, f);
+    }
+    return fclose(f) == 0;
+}
+
+/* -------------------------------------- */
+
+static void setupNodes(ButComCallback onA, ButComCallback onB) {
+    esp.attach(DATA_PIN, wire);
+    tiny.attach(DATA_PIN, wire);
+
+    esp.setSetup([onA]() {
+        busA.setCallback(onA);
+        busA.setSpeedQuality(1);
+        busA.setHelloInterval(0);
+        busA.begin(false);
+    });
+    tiny.setSetup([onB]() {
+        busB.setCallback(onB);
+        busB.setSpeedQuality(1);
+        busB.setHelloInterval(0);
+        busB.begin(false);
+    });
+}
+
+int main(int argc, char** argv) {
+    const char* scenario = (argc > 1) ? argv[1] : "ping";
+    double      simSeconds = 0;
+    Sim         sim;
+
+    // Optional 2nd argument: idle fast-forward quantum in ns (0 = exact)
+    if (argc > 2) sim.setSpinQuantum((uint32_t)atoi(argv[2]));
+
+    // Optional 3rd argument: logic capture of the wire
+    const char* capture = (argc > 3) ? argv[3] : nullptr;
+    if (capture)
+        wire.setEdgeLogger([](uint64_t tNs, bool level) { captureEdges.push_back({ tNs, level }); });
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    if (!strcmp(scenario, "ping")) {
+        setupNodes(pingOnA, pingOnB);
+        esp.setLoop([]() {
+            static uint32_t last = 0;
+            busA.loop();
+            if (millis() - last >= 100) {
+                last = millis();
+                uint8_t p[4] = { 1, 2, 3, (uint8_t)pingSent };
+                busA.send(p, 4, true);
+                pingSent++;
+            }
+        });
+        tiny.setLoop([]() { busB.loop(); });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(10ULL * 1000000000ULL);
+        simSeconds = 10;
+
+        printf("ping: sent=%u received=%u echoed=%u contentions=%u pool peak esp=%u/%u tiny=%u/%u\n",
+               pingSent, pingReceived, pingEchoed, wire.contentions(),
+               busA.pool().peak(), busA.pool().slots(), busB.pool().peak(), busB.pool().slots());
+    }
+    else if (!strcmp(scenario, "bulk")) {
+        for (uint32_t i = 0; i < sizeof(image); i++)
+            image[i] = (uint8_t)(i * 7 + (i >> 8));
+
+        setupNodes(bulkOnA, bulkOnB);
+        bulkRx.setWriteHandler(writeFlash);
+        bulkRx.setDoneHandler(imageDone);
+
+        esp.setLoop([]() {
+            static bool started = false;
+            if (!started) started = bulkTx.start(image, sizeof(image));
+            busA.loop();
+            bulkTx.loop();
+        });
+        tiny.setLoop([]() { busB.loop(); });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.runUntil([]() { return bulkTx.state() == ButComBulkSender::DONE ||
+                                   bulkTx.state() == ButComBulkSender::FAILED; },
+                     600ULL * 1000000000ULL, 10000000ULL);
+        simSeconds = sim.now() / 1e9;
+
+        printf("bulk: state=%d done=%d ok=%d match=%d time=%.1fs rate=%.0fB/s\n",
+               (int)bulkTx.state(), bulkDone, bulkOk,
+               memcmp(image, flash, sizeof(image)) == 0,
+               simSeconds, sizeof(image) / simSeconds);
+    }
+    else if (!strcmp(scenario, "bulk-writefail")) {
+        setupNodes(bulkOnA, bulkOnB);
+        bulkRx.setWriteHandler(writeFlashHalf);
+        bulkRx.setDoneHandler(imageDone);
+
+        esp.setLoop([]() {
+            static bool started = false;
+            if (!started) started = bulkTx.start(image, sizeof(image));
+            busA.loop();
+            bulkTx.loop();
+        });
+        tiny.setLoop([]() { busB.loop(); });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.runUntil([]() { return bulkTx.state() == ButComBulkSender::DONE ||
+                                   bulkTx.state() == ButComBulkSender::FAILED; },
+                     600ULL * 1000000000ULL, 10000000ULL);
+        simSeconds = sim.now() / 1e9;
+
+        printf("bulk-writefail: state=%d (6 = FAILED) done=%d ok=%d after %.1fs, %u of %u bytes acked\n",
+               (int)bulkTx.state(), bulkDone, bulkOk, simSeconds,
+               bulkTx.bytesAcked(), bulkTx.size());
+    }
+    else if (!strcmp(scenario, "bulk-64")) {
+        for (uint32_t i = 0; i < sizeof(image); i++)
+            image[i] = (uint8_t)(i * 7 + (i >> 8));
+
+        esp.attach(DATA_PIN, wire);
+        tiny.attach(DATA_PIN, wire);
+        tiny.setClockError(10000);
+        esp.setSetup([]() {
+            bigA.setCallback([](uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) {
+                bigTx.handleMessage(id, type, d, n);
+            });
+            bigA.setBitTimeUs(70);
+            bigA.setHelloInterval(0);
+            bigA.begin(false);
+        });
+        tiny.setSetup([]() {
+            bigB.setCallback([](uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) {
+                bigRx.handleMessage(id, type, d, n);
+            });
+            bigRx.setWriteHandler(writeFlash);
+            bigRx.setDoneHandler(imageDone);
+            bigB.setBitTimeUs(70);
+            bigB.setHelloInterval(0);
+            bigB.begin(false);
+        });
+        esp.setLoop([]() {
+            static bool started = false;
+            if (!started) started = bigTx.start(image, sizeof(image));
+            bigA.loop();
+            bigTx.loop();
+        });
+        tiny.setLoop([]() { bigB.loop(); });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.runUntil([]() { return bigTx.state() == ButComBulkSender::DONE ||
+                                   bigTx.state() == ButComBulkSender::FAILED; },
+                     600ULL * 1000000000ULL, 10000000ULL);
+        simSeconds = sim.now() / 1e9;
+
+        printf("bulk-64: state=%d done=%d ok=%d match=%d block=%uB time=%.1fs rate=%.0fB/s\n",
+               (int)bigTx.state(), bulkDone, bulkOk,
+               memcmp(image, flash, sizeof(image)) == 0, bigTx.blockSize(),
+               simSeconds, sizeof(image) / simSeconds);
+    }
+    else if (!strcmp(scenario, "timesync")) {
+        tiny.setClockError(150, 123456789);
+        setupNodes(timeOnA, timeOnB);
+        clockA.setInterval(2000);
+        clockB.setInterval(0);
+
+        esp.setLoop([]() { busA.loop(); clockA.loop(); });
+        tiny.setLoop([]() { busB.loop(); });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(60ULL * 1000000000ULL);
+        simSeconds = 60;
+
+        int32_t trueOffset = (int32_t)(tiny.localMicros() - esp.localMicros());
+        int32_t estOffset  = (int32_t)(clockA.toPeerMicros(esp.localMicros()) - esp.localMicros());
+        printf("timesync: samples=%u offset est=%d true=%d err=%dus drift=%dppb (true 150000) rtt=%uus\n",
+               clockA.samples(), estOffset, trueOffset, estOffset - trueOffset,
+               clockA.driftPpb(), clockA.roundTripUs());
+    }
+    else if (!strcmp(scenario, "jitter")) {
+        tiny.setClockError(10000);
+        setupNodes(pingOnA, pingOnB);
+        busA.setTimingDiagnostics(true);
+        busB.setTimingDiagnostics(true);
+
+        esp.setLoop([]() {
+            static uint32_t last = 0;
+            busA.loop();
+            if (millis() - last >= 100) {
+                last = millis();
+                uint8_t p[4] = { 0x55, 0x0F, 0x00, (uint8_t)pingSent };
+                busA.send(p, 4, true);
+                pingSent++;
+            }
+        });
+        tiny.setLoop([]() { busB.loop(); });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(10ULL * 1000000000ULL);
+        simSeconds = 10;
+
+        printf("ping: sent=%u received=%u echoed=%u\n", pingSent, pingReceived, pingEchoed);
+        printTiming("esp32 <- attiny85", busA);
+        printTiming("attiny85 <- esp32", busB);
+    }
+    else if (!strcmp(scenario, "sleep")) {
+        setupNodes(pingOnA, pingOnB);
+        tiny.setSetup([]() {
+            busB.setCallback(pingOnB);
+            busB.setSpeedQuality(1);
+            busB.setHelloInterval(0);
+            busB.begin(false);
+            busB.setAsyncRx(true, wakeTiny);
+        });
+
+        esp.setLoop([]() {
+            static uint32_t last = 0;
+            busA.loop();
+            if (millis() - last >= 250) {
+                last = millis();
+                uint8_t p[4] = { 1, 2, 3, (uint8_t)pingSent };
+                busA.send(p, 4, true);
+                pingSent++;
+            }
+        });
+        tiny.setLoop([]() {
+            tinyWake = false;             // before loop(): a byte queued meanwhile cancels the sleep
+            sleepTiny(busB.loop());
+        });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(10ULL * 1000000000ULL);
+        simSeconds = 10;
+
+        printf("ping: sent=%u received=%u echoed=%u contentions=%u overruns=%u\n",
+               pingSent, pingReceived, pingEchoed, wire.contentions(), busB.rxOverruns());
+        printf("attiny85: async=%d awake %.1f%% (polling receiver: 100%%), %u wake-ups\n",
+               busB.asyncRx(), 100.0 * (1.0 - tinyAsleepNs / (simSeconds * 1e9)), tinyWakeups);
+    }
+    else if (!strcmp(scenario, "button") || !strcmp(scenario, "button-poll")) {
+        static bool isr = !strcmp(scenario, "button");
+        setupNodes(buttonOnA, nullptr);
+        tiny.setInput(BUTTON_PIN, true);
+        tiny.setSetup([]() {
+            busB.setSpeedQuality(1);
+            busB.setHelloInterval(0);
+            busB.begin(false);
+            pinMode(BUTTON_PIN, INPUT_PULLUP);
+            if (isr) attachInterrupt(BUTTON_PIN, buttonIsr, CHANGE);
+        });
+
+        esp.setLoop([]() { busA.loop(); });
+        tiny.setLoop([]() {
+            static uint8_t last = HIGH;
+            busB.loop();
+            if (isr) return;
+
+            uint8_t level = (uint8_t)digitalRead(BUTTON_PIN);
+            if (level == last) return;
+            last = level;
+            uint8_t p[3];
+            captureButton(level, p);
+            busB.send(p, sizeof(p), true);
+        });
+
+        // Presses and releases 5..300 ms apart
+        button.setLoop([]() {
+            static uint32_t rng   = 12345;
+            static bool     level = true;
+            rng = rng * 1103515245u + 12345u;
+            delay(5 + (rng >> 16) % 296);
+
+            level = !level;
+            buttonEdgeNs.push_back(button.timeNs());
+            tiny.setInput(BUTTON_PIN, level);
+        });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.add(button);
+        sim.run(10ULL * 1000000000ULL);
+        simSeconds = 10;
+
+        uint32_t edges = (uint32_t)buttonEdgeNs.size();
+        printf("button (%s): edges=%u captured=%u delivered=%u queue drops=%u contentions=%u\n",
+               isr ? "sendFromIsr" : "polled in loop", edges, buttonCaptured, buttonDelivered,
+               busB.isrTxDropped(), wire.contentions());
+        printf("  capture latency avg %.1fus max %.1fus, delivery avg %.1fms max %.1fms\n",
+               buttonCaptured ? captureSumNs / 1e3 / buttonCaptured : 0.0, captureMaxNs / 1e3,
+               buttonDelivered ? deliverySumNs / 1e6 / buttonDelivered : 0.0, deliveryMaxNs / 1e6);
+    }
+    else if (!strcmp(scenario, "coro")) {
+        static bool started;
+        setupNodes(coroOnA, pingOnB);
+
+        esp.setLoop([]() {
+            if (!started) started = rpcClient(50).started() && heartbeat().started();
+            busA.loop();
+            io.loop();
+        });
+        tiny.setLoop([]() { busB.loop(); });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(10ULL * 1000000000ULL);
+        simSeconds = 10;
+
+        printf("coro: started=%d calls ok=%u failed=%u bad=%u avg rtt=%.1fms heartbeats=%u\n",
+               started, callsOk, callsFailed, callsBad,
+               callsOk ? callRttSumNs / 1e6 / callsOk : 0.0, heartbeats);
+        printf("  frames free %u/%u, peak frame %zu/%u bytes, inbox drops %u\n",
+               ButComTask::framesFree(), BUTCOM_CORO_FRAMES, ButComTask::peakFrameSize(),
+               BUTCOM_CORO_FRAME_SIZE, io.inboxDropped());
+    }
+    else if (!strcmp(scenario, "tune") || !strcmp(scenario, "tune-lost-ack")) {
+        loseCommitAck = !strcmp(scenario, "tune-lost-ack");
+        tiny.setClockError(10000);
+        setupNodes(tuneOnA, tuneOnB);
+        esp.setSetup([]() {
+            busA.setCallback(tuneOnA);
+            busA.setHelloInterval(0);
+            busA.begin(false);            // the ATtiny's HELLO starts the tune
+            tuneA.setDoneHandler(tuneDoneA);
+        });
+        tiny.setSetup([]() {
+            busB.setCallback(tuneOnB);
+            busB.setHelloInterval(0);
+            busB.begin(true);
+            tuneB.setDoneHandler(tuneDoneB);
+        });
+
+        esp.setLoop([]() {
+            static bool     started = false;
+            static uint32_t last    = 0;
+            busA.loop();
+            tuneA.loop();
+            if (!started) started = tuneA.start();
+            if (tuneA.busy() || !started || millis() - last < 250) return;
+
+            last = millis();
+            uint8_t p[4] = { 1, 2, 3, (uint8_t)pingSent };
+            busA.send(p, 4, true);
+            pingSent++;
+        });
+        tiny.setLoop([]() { busB.loop(); tuneB.loop(); });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(20ULL * 1000000000ULL);
+        simSeconds = 20;
+
+        printf("%s: state=%d agreed esp=%uus attiny=%uus after %.2fs (base %uus), "
+               "fallbacks esp=%u attiny=%u, bit time esp=%uus attiny=%uus\n",
+               scenario, (int)tuneA.state(), tunedA, tunedB, tunedNs / 1e9, 500,
+               fallbacksA, fallbacksB, busA.bitTimeUs(), busB.bitTimeUs());
+        for (uint8_t i = 0; i < tuneA.steps(); i++) {
+            const ButComTuneStep& s = tuneA.step(i);
+            printf("  %4uus  sent %u  received %u  echoed %u\n", s.bitUs, s.sent, s.received, s.echoed);
+        }
+        printf("ping at %uus: sent=%u received=%u echoed=%u contentions=%u\n",
+               busA.bitTimeUs(), pingSent, pingReceived, pingEchoed, wire.contentions());
+    }
+    else if (!strcmp(scenario, "resume") || !strcmp(scenario, "resume-stale")) {
+        bool stale = !strcmp(scenario, "resume-stale");
+        storeProfile(storeA, 0x10, 70, 500, 3);
+        storeProfile(storeB, 0x20, 70, 500, stale ? 2 : 3);
+
+        tiny.setClockError(10000);
+        setupNodes(tuneOnA, tuneOnB);
+        esp.setSetup([]() {
+            busA.setCallback(tuneOnA);
+            busA.setHelloInterval(0);
+            tuneA.setDoneHandler(tuneDoneA);
+            tuneA.setProfileStore(readA, writeA);
+            tuneA.resume();
+            busA.begin(false);
+        });
+        tiny.setSetup([]() {
+            busB.setCallback(tuneOnB);
+            busB.setHelloInterval(0);
+            tuneB.setDoneHandler(tuneDoneB);
+            tuneB.setProfileStore(readB, writeB);
+            tuneB.resume();
+            busB.begin(true);
+        });
+
+        esp.setLoop([]() {
+            static uint32_t last = 0;
+            busA.loop();
+            tuneA.loop();
+            if (busA.hasRemoteId() && tuneA.state() == ButComLinkTune::IDLE) tuneA.start();
+            if (tuneA.state() != ButComLinkTune::DONE || millis() - last < 250) return;
+
+            last = millis();
+            uint8_t p[4] = { 1, 2, 3, (uint8_t)pingSent };
+            busA.send(p, 4, true);
+            pingSent++;
+        });
+        tiny.setLoop([]() { busB.loop(); tuneB.loop(); });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(20ULL * 1000000000ULL);
+        simSeconds = 20;
+
+        printf("%s: state=%d link up at %uus after %.3fs, fallbacks esp=%u attiny=%u, "
+               "stored epoch esp=%u attiny=%u\n",
+               scenario, (int)tuneA.state(), tunedA, tunedNs / 1e9, fallbacksA, fallbacksB,
+               storedEpoch(storeA), storedEpoch(storeB));
+        for (uint8_t i = 0; i < tuneA.steps(); i++) {
+            const ButComTuneStep& s = tuneA.step(i);
+            printf("  %4uus  sent %u  received %u  echoed %u\n", s.bitUs, s.sent, s.received, s.echoed);
+        }
+        printf("ping at %uus: sent=%u received=%u echoed=%u contentions=%u\n",
+               busA.bitTimeUs(), pingSent, pingReceived, pingEchoed, wire.contentions());
+    }
+    else if (!strcmp(scenario, "discover") || !strcmp(scenario, "discover-both")) {
+        static uint64_t bootNs, knownA, knownB;
+        bootNs = !strcmp(scenario, "discover") ? 2000000000ULL : 0;
+
+        tiny.setClockError(10000);
+        setupNodes(pingOnA, pingOnB);
+        esp.setSetup([]() {
+            busA.setCallback(pingOnA);
+            delay((uint32_t)(bootNs / 1000000));
+            busA.begin(true);
+        });
+        tiny.setSetup([]() {
+            busB.setCallback(pingOnB);
+            busB.begin(true);
+        });
+        esp.setLoop([]() {
+            busA.loop();
+            if (!knownA && busA.hasRemoteId()) knownA = esp.timeNs();
+        });
+        tiny.setLoop([]() {
+            busB.loop();
+            if (!knownB && busB.hasRemoteId()) knownB = tiny.timeNs();
+        });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(bootNs + 3ULL * 1000000000ULL);
+        simSeconds = (bootNs + 3ULL * 1000000000ULL) / 1e9;
+
+        printf("%s: ESP32 boots at %.3fs, knows 0x%02X after %.1f ms, ATtiny85 knows 0x%02X after %.1f ms\n",
+               scenario, bootNs / 1e9,
+               busA.remoteId(), knownA ? (knownA - bootNs) / 1e6 : -1.0,
+               busB.remoteId(), knownB ? (knownB - bootNs) / 1e6 : -1.0);
+        printf("remote maxPayload esp=%u attiny=%u, bit %uus, contentions=%u\n",
+               busA.remoteMaxPayload(), busB.remoteMaxPayload(), busA.bitTimeUs(), wire.contentions());
+    }
+    else if (!strcmp(scenario, "reboot") || !strcmp(scenario, "reboot-same-nonce")) {
+        static bool     sameNonce;
+        static uint32_t reboots, detected, dropped, echoesSinceBoot;
+        sameNonce = !strcmp(scenario, "reboot-same-nonce");
+
+        static void (*bootB)() = []() {
+            busB.setCallback([](uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) {
+                if (type == BUTCOM_MSG_DATA) echoesSinceBoot++;
+                pingOnB(id, type, d, n);
+            });
+            busB.setSpeedQuality(1);
+            busB.setHelloInterval(0);
+            if (sameNonce) busB.setBootNonce(0x1234);
+            echoesSinceBoot = 0;
+            busB.begin(true);
+        };
+
+        setupNodes(pingOnA, nullptr);
+        esp.setSetup([]() {
+            busA.setCallback(pingOnA);
+            busA.setSpeedQuality(1);
+            busA.setHelloInterval(0);
+            busA.setPeerRebootHandler([](uint8_t, bool d) { detected++; if (d) dropped++; });
+            busA.begin(false);
+        });
+        tiny.setSetup([]() { bootB(); });
+
+        esp.setLoop([]() {
+            static uint32_t last = 0;
+            busA.loop();
+            if (millis() - last >= 250) {
+                last = millis();
+                uint8_t p[4] = { 1, 2, 3, (uint8_t)pingSent };
+                busA.send(p, 4, true);
+                pingSent++;
+            }
+        });
+        tiny.setLoop([]() {
+            busB.loop();
+            if (echoesSinceBoot < 1 || busB.txPending() || !busB.hasRemoteId()) return;
+
+            // Reset: the MCU forgets everything, msgIds start over
+            reboots++;
+            busB.~ButCom();
+            new (&busB) ButCom(DATA_PIN, false, 0x10);
+            delay(150);
+            bootB();
+        });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(10ULL * 1000000000ULL);
+        simSeconds = 10;
+
+        printf("%s: ATtiny85 reboots=%u, detected by ESP32=%u (pending dropped %u)\n",
+               scenario, reboots, detected, dropped);
+        printf("ping: sent=%u received=%u echoed=%u contentions=%u\n",
+               pingSent, pingReceived, pingEchoed, wire.contentions());
+    }
+    else if (!strcmp(scenario, "small")) {
+        static uint64_t knownB;
+        static uint32_t detectedA, detectedB, rebootsA, rebootsB;
+
+        static void (*bootA)() = []() {
+            busA.setCallback(pingOnA);
+            busA.setSpeedQuality(1);
+            busA.setHelloInterval(0);
+            busA.setPeerRebootHandler([](uint8_t, bool) { detectedA++; });
+            busA.begin(true);
+        };
+        static void (*bootB)() = []() {
+            smallB.setCallback([](uint8_t, uint8_t type, const uint8_t* d, uint8_t n) {
+                if (type != BUTCOM_MSG_DATA) return;
+                pingReceived++;
+                smallB.send(d, n, true);
+            });
+            smallB.setSpeedQuality(1);
+            smallB.setHelloInterval(0);
+            smallB.setPeerRebootHandler([](uint8_t, bool) { detectedB++; });
+            smallB.begin(true);
+        };
+
+        esp.attach(DATA_PIN, wire);
+        tiny.attach(DATA_PIN, wire);
+        tiny.setClockError(10000);
+        esp.setSetup([]() { bootA(); });
+        tiny.setSetup([]() { bootB(); });
+
+        esp.setLoop([]() {
+            static uint32_t last = 0;
+            busA.loop();
+            if (busA.hasRemoteId() && millis() - last >= 250) {
+                last = millis();
+                uint8_t p = (uint8_t)pingSent;
+                if (busA.send(&p, 1, true)) pingSent++;
+            }
+            if (!rebootsA && millis() >= 4000 && !busA.txPending()) {
+                rebootsA++;
+                busA.~ButCom();
+                new (&busA) ButCom(DATA_PIN, true, 0x20);
+                delay(150);
+                bootA();
+            }
+        });
+        tiny.setLoop([]() {
+            smallB.loop();
+            if (!knownB && smallB.hasRemoteId()) knownB = tiny.timeNs();
+            if (!rebootsB && millis() >= 7000 && !smallB.txPending()) {
+                rebootsB++;
+                smallB.~ButComSized<1>();
+                new (&smallB) ButComSized<1>(DATA_PIN, false, 0x10);
+                delay(150);
+                bootB();
+            }
+        });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(10ULL * 1000000000ULL);
+        simSeconds = 10;
+
+        printf("small: ATtiny85 (maxPayload %u) knows 0x%02X after %.1f ms, peer maxPayload %u; "
+               "ESP32 knows 0x%02X, peer maxPayload %u\n",
+               smallB.maxPayload(), smallB.remoteId(), knownB ? knownB / 1e6 : -1.0,
+               smallB.remoteMaxPayload(), busA.remoteId(), busA.remoteMaxPayload());
+        printf("reboots: ESP32 %u, detected by ATtiny85 %u; ATtiny85 %u, detected by ESP32 %u\n",
+               rebootsA, detectedB, rebootsB, detectedA);
+        printf("ping: sent=%u received=%u echoed=%u contentions=%u\n",
+               pingSent, pingReceived, pingEchoed, wire.contentions());
+    }
+    else if (!strcmp(scenario, "backpressure") || !strcmp(scenario, "backpressure-naive")) {
+        static bool     naive;
+        static uint32_t produced, delivered, duplicates, dropped, frames, full;
+        static double   latencySum, latencyMax;
+        static uint8_t  seen[500];
+        naive = !strcmp(scenario, "backpressure-naive");
+
+        wire.setNoise(1e-4, 20000, 7);
+        setupNodes(pingOnA, [](uint8_t, uint8_t type, const uint8_t* d, uint8_t len) {
+            if (type != BUTCOM_MSG_DATA) return;
+            for (uint8_t i = 0; i + 1 < len; i += 2) {
+                uint16_t n = (uint16_t)(d[i] | (d[i + 1] << 8));
+                if (n >= 500) continue;
+                if (seen[n]++) { duplicates++; continue; }
+                double ms = tiny.timeNs() / 1e6 - n * 20.0;
+                latencySum += ms;
+                if (ms > latencyMax) latencyMax = ms;
+                delivered++;
+            }
+        });
+        esp.setLoop([]() {
+            static uint8_t batch[BUTCOM_MAX_PAYLOAD];
+            static uint8_t batchLen = 0;
+
+            busA.loop();
+
+            // Sample n is due at n * 20 ms, however long send() blocked
+            while (produced < 500 && millis() >= produced * 20) {
+                if (batchLen + 2 > (int)sizeof(batch)) {          // full batch: drop the oldest
+                    memmove(batch, batch + 2, batchLen - 2);
+                    batchLen -= 2;
+                    dropped++;
+                }
+                batch[batchLen++] = (uint8_t)produced;
+                batch[batchLen++] = (uint8_t)(produced >> 8);
+                produced++;
+
+                if (naive) {                                     // one frame per sample
+                    busA.send(batch, batchLen, true);
+                    frames++;
+                    batchLen = 0;
+                }
+            }
+            if (naive || !batchLen) return;
+
+            if (busA.trySend(batch, batchLen, true) == BUTCOM_SEND_QUEUED) {
+                frames++;
+                batchLen = 0;
+            } else {
+                full++;
+            }
+        });
+        tiny.setLoop([]() { busB.loop(); });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(15ULL * 1000000000ULL);
+        simSeconds = 15;
+
+        printf("%s: samples produced=%u delivered=%u duplicates=%u dropped at source=%u\n",
+               scenario, produced, delivered, duplicates, dropped);
+        printf("frames=%u FULL=%u, latency avg %.1f ms max %.1f ms, link %s, contentions=%u\n",
+               frames, full, delivered ? latencySum / delivered : 0.0, latencyMax,
+               busA.linkUp() ? "up" : "down", wire.contentions());
+    }
+    else if (!strcmp(scenario, "pubsub")) {
+        static ButComPubSub topicsA(busA);
+        static ButComPubSub topicsB(busB);
+        static uint32_t     receivedMask, maskBefore, maskAfter;
+        static bool         rebooted;
+
+        static void (*bootB)() = []() {
+            busB.setCallback([](uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) {
+                topicsB.handleMessage(id, type, d, n);
+            });
+            topicsB.setCallback([](uint8_t topic, const uint8_t*, uint8_t) {
+                receivedMask |= 1UL << topic;
+            });
+            busB.setSpeedQuality(1);
+            busB.setHelloInterval(0);
+            busB.begin(true);
+        };
+
+        wire.setNoise(1e-3, 20000, 7);
+        setupNodes(nullptr, nullptr);
+        esp.setSetup([]() {
+            busA.setCallback([](uint8_t id, uint8_t type, const uint8_t* d, uint8_t n) {
+                topicsA.handleMessage(id, type, d, n);
+            });
+            busA.setSpeedQuality(1);
+            busA.setHelloInterval(0);
+            busA.begin(false);
+            for (uint8_t t = 0; t < 8; t++) {
+                uint8_t v[4] = { t, 1, 2, 3 };
+                topicsA.publish(t, v, 4);           // nobody subscribed: cache only
+            }
+        });
+        tiny.setSetup([]() {
+            bootB();
+            for (uint8_t t = 0; t < 8; t++) topicsB.subscribe(t);
+        });
+
+        esp.setLoop([]() {
+            busA.loop();
+            topicsA.loop();
+            if (rebooted && busA.remoteBootNonce() != 0 && millis() > 4000 && !maskAfter) {
+                for (uint8_t t = 0; t < 8; t++)
+                    if (topicsA.peerSubscribed(t)) maskAfter |= 1UL << t;
+                maskAfter |= 0x100;                 // sampled
+            }
+        });
+        tiny.setLoop([]() {
+            busB.loop();
+            topicsB.loop();
+            if (rebooted || millis() < 3000) return;
+
+            // Reset, and this firmware does not subscribe after a boot
+            for (uint8_t t = 0; t < 8; t++)
+                if (topicsA.peerSubscribed(t)) maskBefore |= 1UL << t;
+            rebooted = true;
+            topicsB.~ButComPubSub();
+            busB.~ButCom();
+            new (&busB) ButCom(DATA_PIN, false, 0x10);
+            new (&topicsB) ButComPubSub(busB);
+            delay(150);
+            bootB();
+        });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(5ULL * 1000000000ULL);
+        simSeconds = 5;
+
+        printf("pubsub: late subscriber got %u/8 cached topics, contentions=%u\n",
+               (unsigned)__builtin_popcount(receivedMask), wire.contentions());
+        printf("ESP32 sees peer subscriptions 0x%02x before the reboot, 0x%02x after\n",
+               (unsigned)maskBefore, (unsigned)(maskAfter & 0xFF));
+    }
+    else if (!strcmp(scenario, "budget") || !strcmp(scenario, "budget-off")) {
+        static bool     budget;
+        static uint32_t calls, slices, received, hist[5];
+        static uint32_t maxUs;
+        static const uint32_t edgesMs[4] = { 1, 2, 10, 30 };
+        budget = !strcmp(scenario, "budget");
+
+        setupNodes(nullptr, nullptr);
+        esp.setSetup([]() {
+            busA.setCallback([](uint8_t, uint8_t type, const uint8_t*, uint8_t) {
+                if (type == BUTCOM_MSG_DATA) received++;
+            });
+            busA.setSpeedQuality(1);
+            busA.setHelloInterval(1000);
+            busA.begin(false);
+            busA.setAsyncRx(true, nullptr);
+        });
+        tiny.setSetup([]() {
+            busB.setSpeedQuality(1);
+            busB.setHelloInterval(0);
+            busB.begin(false);
+        });
+
+        esp.setLoop([]() {
+            static uint32_t nextUs = 0;
+
+            // Control period: 2 ms, the bus gets its slice after the control work
+            uint32_t t0 = micros();
+            if (budget) busA.loop(500);
+            else        busA.loop();
+            uint32_t us = micros() - t0;
+
+            calls++;
+            if (us > maxUs) maxUs = us;
+            uint8_t b = 0;
+            while (b < 4 && us >= edgesMs[b] * 1000) b++;
+            hist[b]++;
+
+            // Slack every 100 ms: a slice for a frame that did not fit
+            if (budget && calls % 50 == 0 && busA.deferredFrameUs()) {
+                busA.loop(busA.deferredFrameUs() + 2000);
+                slices++;
+            }
+
+            // Short steps: the simulator runs the edge ISR between calls
+            nextUs += 2000;
+            if ((int32_t)(nextUs - micros()) < 0) nextUs = micros();   // overrun: start over
+            while ((int32_t)(nextUs - micros()) > 0) delayMicroseconds(5);
+        });
+        tiny.setLoop([]() {
+            static uint32_t last = 0;
+            busB.loop();
+            if (millis() - last < 100) return;
+            last = millis();
+            uint8_t p[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+            if (busB.send(p, 8, true)) pingSent++;
+        });
+
+        sim.add(esp);
+        sim.add(tiny);
+        sim.run(10ULL * 1000000000ULL);
+        simSeconds = 10;
+
+        printf("%s: %u loop() calls, max %.2f ms; <1 ms %u, 1-2 ms %u, 2-10 ms %u, 10-30 ms %u, >=30 ms %u\n",
+               scenario, calls, maxUs / 1000.0, hist[0], hist[1], hist[2], hist[3], hist[4]);
+        printf("frames sent=%u received=%u, slack slices=%u, frameUs(0)=%.1f ms, contentions=%u\n",
+               pingSent, received, slices, busA.frameUs(0) / 1000.0, wire.contentions());
+    }
+    else {
+        fprintf(stderr, "usage: %s [ping|bulk|bulk-64|bulk-writefail|timesync|jitter|sleep|button|button-poll|coro|tune|resume|resume-stale|discover|discover-both|reboot|reboot-same-nonce|small|backpressure|backpressure-naive|pubsub|budget|budget-off] "
+                        "[spinQuantumNs] [capture]\n", argv[0]);
+        return 2;
+    }
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    printf("simulated %.1fs in %.2fs real time (%.0fx), calls esp=%llu tiny=%llu, %llu switches\n",
+           simSeconds, wall, simSeconds / wall,
+           (unsigned long long)esp.arduinoCalls(), (unsigned long long)tiny.arduinoCalls(),
+           (unsigned long long)sim.switches());
+
+    if (capture) {
+        if (!writeCapture(capture, sim.now())) { perror(capture); return 1; }
+        printf("capture: %s, %zu edges, 1 MHz\n", capture, captureEdges.size());
+    }
+    return 0;
+}